@@ -0,0 +1,70 @@
+# benchmarks are run from the build directory and never installed
+link_libraries(common_base)
+
+set(BENCH_GEN_DIR ${CMAKE_CURRENT_BINARY_DIR}/bench-gen)
+set(BENCH_IDL_DIR ${PACKAGE_SOURCE_ROOT}/example/idl)
+file(MAKE_DIRECTORY ${BENCH_GEN_DIR})
+
+# flat messages: example/idl/*.fdbflat -> bench-gen/*.flat.h
+set(flat_schema ${BENCH_IDL_DIR}/common.base.Telemetry.fdbflat)
+add_custom_command(OUTPUT ${BENCH_GEN_DIR}/common.base.Telemetry.flat.h
+    COMMAND ${CMAKE_COMMAND} -DSCHEMA=${flat_schema} -DOUTPUT=${BENCH_GEN_DIR}/common.base.Telemetry.flat.h
+            -P ${CMAKE_CURRENT_LIST_DIR}/fdbflat-gen.cmake
+    DEPENDS ${flat_schema} ${CMAKE_CURRENT_LIST_DIR}/fdbflat-gen.cmake
+)
+
+add_executable(fdbserializerbench
+    ${PACKAGE_SOURCE_ROOT}/example/simple_serializer_bench.cpp
+)
+
+add_executable(fdbpodarraybench
+    ${PACKAGE_SOURCE_ROOT}/example/pod_array_bench.cpp
+)
+
+add_executable(fdbflatbench
+    ${PACKAGE_SOURCE_ROOT}/example/flat_msg_bench.cpp
+    ${BENCH_GEN_DIR}/common.base.Telemetry.flat.h
+)
+target_include_directories(fdbflatbench PRIVATE ${BENCH_GEN_DIR})
+
+add_executable(fdbsubscribebench
+    ${PACKAGE_SOURCE_ROOT}/example/subscribe_index_bench.cpp
+)
+
+add_executable(fdbdispatchbench
+    ${PACKAGE_SOURCE_ROOT}/example/object_dispatch_bench.cpp
+)
+
+add_executable(fdbpendingbench
+    ${PACKAGE_SOURCE_ROOT}/example/pending_table_bench.cpp
+)
+
+add_executable(fdbtimerbench
+    ${PACKAGE_SOURCE_ROOT}/example/loop_timer_bench.cpp
+)
+
+# protobuf benchmarks are built only if protobuf is installed
+find_package(Protobuf)
+if (PROTOBUF_FOUND)
+    foreach(proto_name common.base.Example common.base.Telemetry)
+        set(proto_idl ${BENCH_IDL_DIR}/${proto_name}.proto)
+        add_custom_command(OUTPUT ${BENCH_GEN_DIR}/${proto_name}.pb.cc ${BENCH_GEN_DIR}/${proto_name}.pb.h
+            COMMAND ${PROTOBUF_PROTOC_EXECUTABLE} -I${BENCH_IDL_DIR} --cpp_out=${BENCH_GEN_DIR} ${proto_idl}
+            DEPENDS ${proto_idl}
+        )
+    endforeach()
+
+    add_executable(fdbprotobench
+        ${PACKAGE_SOURCE_ROOT}/example/protobuf_bench.cpp
+        ${BENCH_GEN_DIR}/common.base.Example.pb.cc
+    )
+    target_include_directories(fdbprotobench PRIVATE ${BENCH_GEN_DIR} ${PROTOBUF_INCLUDE_DIRS})
+    target_compile_definitions(fdbprotobench PRIVATE "FDB_IDL_EXAMPLE_H=<common.base.Example.pb.h>")
+    target_link_libraries(fdbprotobench ${PROTOBUF_LIBRARIES})
+
+    # fdbflatbench compares with protobuf as well
+    target_sources(fdbflatbench PRIVATE ${BENCH_GEN_DIR}/common.base.Telemetry.pb.cc)
+    target_include_directories(fdbflatbench PRIVATE ${PROTOBUF_INCLUDE_DIRS})
+    target_compile_definitions(fdbflatbench PRIVATE "FDB_BENCH_TELEMETRY_PB_H=<common.base.Telemetry.pb.h>")
+    target_link_libraries(fdbflatbench ${PROTOBUF_LIBRARIES})
+endif()
@@ -0,0 +1,72 @@
+# Generate header of FDB_FLAT_TABLE() declarations from flat message schema.
+# Usage: cmake -DSCHEMA=<x.fdbflat> -DOUTPUT=<x.flat.h> -P fdbflat-gen.cmake
+#
+# Schema syntax, one statement per line; '#' starts a comment:
+#     table CPosition
+#         int32_t x
+#         double speed
+#         string name
+#         bytes blob
+#         array<float> samples
+#     end
+# Fields take slots in order of appearance; append new fields only at the
+# end of a table to keep compatibility.
+
+cmake_policy(SET CMP0054 NEW)
+
+file(STRINGS ${SCHEMA} schema_lines)
+# keep dots of common.base.X: only the last extension is dropped
+get_filename_component(schema_name ${SCHEMA} NAME)
+string(REGEX REPLACE "\\.[^.]*$" "" schema_name ${schema_name})
+string(TOUPPER "__${schema_name}_FLAT_H__" guard)
+string(REGEX REPLACE "[^A-Z0-9_]" "_" guard ${guard})
+
+set(content "/* Generated from ${SCHEMA}; do not edit. */\n")
+set(content "${content}#ifndef ${guard}\n#define ${guard}\n\n")
+set(content "${content}#include <common_base/CFdbFlatMsgBuilder.h>\n")
+
+set(table "")
+foreach(line ${schema_lines})
+    string(REGEX REPLACE "#.*$" "" line "${line}")
+    string(STRIP "${line}" line)
+    if ("${line}" STREQUAL "")
+        continue()
+    endif()
+    string(REGEX REPLACE "[ \t]+" ";" tokens "${line}")
+    list(GET tokens 0 keyword)
+    list(LENGTH tokens token_count)
+    if ("${keyword}" STREQUAL "table")
+        if (NOT "${table}" STREQUAL "")
+            message(FATAL_ERROR "${SCHEMA}: table ${table} is not ended!")
+        endif()
+        list(GET tokens 1 table)
+        set(slot 0)
+        set(content "${content}\n#define ${table}_FIELDS(SCALAR, STRING, BYTES, ARRAY)")
+    elseif ("${keyword}" STREQUAL "end")
+        set(content "${content}\n\nFDB_FLAT_TABLE(${table}, ${slot}, ${table}_FIELDS)\n")
+        set(table "")
+    else()
+        if (("${table}" STREQUAL "") OR (NOT token_count EQUAL 2))
+            message(FATAL_ERROR "${SCHEMA}: invalid statement '${line}'!")
+        endif()
+        list(GET tokens 1 field)
+        if ("${keyword}" STREQUAL "string")
+            set(decl "STRING(${field}, ${slot})")
+        elseif ("${keyword}" STREQUAL "bytes")
+            set(decl "BYTES(${field}, ${slot})")
+        elseif ("${keyword}" MATCHES "^array<(.+)>$")
+            set(decl "ARRAY(${CMAKE_MATCH_1}, ${field}, ${slot})")
+        else()
+            set(decl "SCALAR(${keyword}, ${field}, ${slot})")
+        endif()
+        set(content "${content} \\\n    ${decl}")
+        math(EXPR slot "${slot} + 1")
+    endif()
+endforeach()
+
+if (NOT "${table}" STREQUAL "")
+    message(FATAL_ERROR "${SCHEMA}: table ${table} is not ended!")
+endif()
+
+set(content "${content}\n#endif\n")
+file(WRITE ${OUTPUT} "${content}")
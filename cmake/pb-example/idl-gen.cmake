@@ -25,3 +25,21 @@ foreach(idl ${PROTO_SOURCES})
     set_directory_properties(PROPERTIES ADDITIONAL_MAKE_CLEAN_FILES "${gen_header};${gen_source}")
 endforeach()
 
+
+# flat messages: example/idl/*.fdbflat -> idl-gen/*.flat.h (see common_base/CFdbFlatMsgBuilder.h)
+FILE(GLOB_RECURSE FLAT_SOURCES "${PACKAGE_SOURCE_ROOT}/example/idl/*.fdbflat")
+set(flat_gen_tool ${PACKAGE_SOURCE_ROOT}/cmake/fdbflat-gen.cmake)
+foreach(schema ${FLAT_SOURCES})
+    get_filename_component(base_name ${schema} NAME)
+    string(FIND ${base_name} "." SHORTEST_EXT_POS REVERSE)
+    string(SUBSTRING ${base_name} 0 ${SHORTEST_EXT_POS} base_name_we)
+
+    set(gen_header ${GEN_DIR}/${base_name_we}.flat.h)
+    add_custom_command(OUTPUT ${gen_header}
+        COMMAND ${CMAKE_COMMAND} -DSCHEMA=${schema} -DOUTPUT=${gen_header} -P ${flat_gen_tool}
+        DEPENDS ${schema} ${flat_gen_tool}
+    )
+    add_custom_target(${base_name_we}_flat ALL DEPENDS ${gen_header})
+    add_dependencies(${PROTO_TARGET} ${base_name_we}_flat)
+    set_directory_properties(PROPERTIES ADDITIONAL_MAKE_CLEAN_FILES "${gen_header}")
+endforeach()
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CFDBBENCH_H__
+#define __CFDBBENCH_H__
+
+#include <stdio.h>
+#include <common_base/CNanoTimer.h>
+
+/*
+ * Shared by the example benchmarks: a CNanoTimer which starts on
+ * construction and gives average time per iteration, and result lines
+ * printed in one column.
+ */
+class CFdbBenchTimer : public CNanoTimer
+{
+public:
+    CFdbBenchTimer()
+    {
+        start();
+    }
+
+    // average nanoseconds per iteration since start()
+    double nsPerIteration(int32_t iterations)
+    {
+        return (double)snapshotNanoseconds() / iterations;
+    }
+};
+
+static inline void fdbPrintBenchResult(const char *label, double ns)
+{
+    printf("%-30s%10.1f ns\n", label, ns);
+}
+
+// @base_ns: what @ns is compared with; printed as speedup
+static inline void fdbPrintBenchResult(const char *label, double ns, double base_ns)
+{
+    printf("%-30s%10.1f ns (%.2fx)\n", label, ns, base_ns / ns);
+}
+
+#endif
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark of flat messages against simple serializer and, if built with
+ * protobuf, against protobuf. The same telemetry record (a few scalars, a
+ * string and an array of float samples) is encoded into a new buffer, and
+ * decoded with all fields read and samples summed up.
+ *
+ * Flat message is decoded from both an aligned and a misaligned buffer
+ * since payload of a received message can start at any address.
+ *
+ * Usage: fdbflatbench [samples] [iterations]
+ */
+
+#include <common_base/fdbus.h>
+#include <common_base/CFdbSimpleMsgBuilder.h>
+#include <common.base.Telemetry.flat.h>
+#ifdef FDB_BENCH_TELEMETRY_PB_H
+#include FDB_BENCH_TELEMETRY_PB_H
+#include <common_base/CFdbProtoMsgBuilder.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "CFdbBench.h"
+
+class CTelemetry : public IFdbParcelable
+{
+public:
+    void serialize(CFdbSimpleSerializer &serializer) const
+    {
+        serializer << mId << mSpeed << mName << mSamples;
+    }
+    void deserialize(CFdbSimpleDeserializer &deserializer)
+    {
+        deserializer >> mId >> mSpeed >> mName >> mSamples;
+    }
+    int32_t mId;
+    double mSpeed;
+    std::string mName;
+    CFdbParcelableArray<float> mSamples;
+
+protected:
+    void toString(std::ostringstream &stream) const
+    {
+        stream << "mId:" << mId << ", mSpeed:" << mSpeed << ", mName:" << mName
+               << ", mSamples:"; mSamples.format(stream);
+    }
+};
+
+// @fill sets up a new builder; builders are used once, as CFdbMessage does
+template <typename B, typename F>
+static double encode(F fill, int32_t iterations, std::vector<uint8_t> &image)
+{
+    uint64_t checksum = 0;
+    CFdbBenchTimer timer;
+    for (int32_t i = 0; i < iterations; ++i)
+    {
+        B builder(fill());
+        int32_t size = builder.build();
+        auto buffer = new uint8_t[size];
+        builder.toBuffer(buffer, size);
+        checksum += buffer[size - 1];
+        delete[] buffer;
+    }
+    auto ns = timer.nsPerIteration(iterations);
+    B builder(fill());
+    image.resize(builder.build());
+    builder.toBuffer(&image[0], (int32_t)image.size());
+    return checksum ? ns : ns;
+}
+
+static void printResult(const char *name, double encode_ns, double decode_ns, double sum, size_t size)
+{
+    printf("%-22s encode %10.1f ns, decode %10.1f ns, %6d bytes (sum %g)\n",
+           name, encode_ns, decode_ns, (int32_t)size, sum);
+}
+
+static double decodeFlat(const uint8_t *payload, int32_t size, int32_t iterations, double &sum)
+{
+    CFdbBenchTimer timer;
+    for (int32_t i = 0; i < iterations; ++i)
+    {
+        CTelemetryReader reader;
+        if (!reader.parse(payload, size))
+        {
+            return -1;
+        }
+        sum = reader.id() + reader.speed() + reader.name().size();
+        auto samples = reader.samples();
+        auto native = samples.native();
+        if (native)
+        {
+            for (uint32_t j = 0; j < samples.size(); ++j)
+            {
+                sum += native[j];
+            }
+        }
+        else
+        {
+            for (uint32_t j = 0; j < samples.size(); ++j)
+            {
+                sum += samples[j];
+            }
+        }
+    }
+    return timer.nsPerIteration(iterations);
+}
+
+int main(int argc, char **argv)
+{
+    int32_t samples = (argc > 1) ? atoi(argv[1]) : 256;
+    int32_t iterations = (argc > 2) ? atoi(argv[2]) : 100000;
+
+    std::vector<float> values;
+    for (int32_t i = 0; i < samples; ++i)
+    {
+        values.push_back((float)i / 4);
+    }
+    std::string name = "vehicle telemetry";
+    printf("%d samples, %d iterations\n", samples, iterations);
+
+    // flat message
+    {
+        std::vector<uint8_t> image;
+        auto encode_ns = encode<CTelemetryBuilder>([&values, &name]()
+            {
+                CTelemetryBuilder builder;
+                builder.set_id(7);
+                builder.set_speed(88.5);
+                builder.set_name(name);
+                builder.set_samples(values.data(), (uint32_t)values.size());
+                return builder;
+            }, iterations, image);
+
+        double sum = 0;
+        auto decode_ns = decodeFlat(&image[0], (int32_t)image.size(), iterations, sum);
+        printResult("flat", encode_ns, decode_ns, sum, image.size());
+
+        // same payload one byte off alignment
+        std::vector<uint8_t> shifted(image.size() + 8);
+        auto misaligned = &shifted[0] + ((((uintptr_t)&shifted[0]) & 7) ? 8 - (((uintptr_t)&shifted[0]) & 7) : 0) + 1;
+        memcpy(misaligned, &image[0], image.size());
+        decode_ns = decodeFlat(misaligned, (int32_t)image.size(), iterations, sum);
+        printResult("flat (misaligned)", encode_ns, decode_ns, sum, image.size());
+    }
+
+    // simple serializer
+    {
+        CTelemetry record;
+        record.mId = 7;
+        record.mSpeed = 88.5;
+        record.mName = name;
+        record.mSamples.vpool() = values;
+        std::vector<uint8_t> image;
+        auto encode_ns = encode<CFdbParcelableBuilder>([&record]() -> const IFdbParcelable &
+            {
+                return record;
+            }, iterations, image);
+
+        double sum = 0;
+        CFdbBenchTimer timer;
+        for (int32_t i = 0; i < iterations; ++i)
+        {
+            CTelemetry decoded;
+            CFdbParcelableParser parser(decoded);
+            if (!parser.parse(&image[0], (int32_t)image.size()))
+            {
+                return 1;
+            }
+            sum = decoded.mId + decoded.mSpeed + decoded.mName.size();
+            for (auto it = decoded.mSamples.pool().begin(); it != decoded.mSamples.pool().end(); ++it)
+            {
+                sum += *it;
+            }
+        }
+        printResult("simple serializer", encode_ns, timer.nsPerIteration(iterations), sum, image.size());
+    }
+
+#ifdef FDB_BENCH_TELEMETRY_PB_H
+    // protobuf
+    {
+        NFdbTelemetry::Telemetry record;
+        record.set_id(7);
+        record.set_speed(88.5);
+        record.set_name(name);
+        for (auto it = values.begin(); it != values.end(); ++it)
+        {
+            record.add_samples(*it);
+        }
+        std::vector<uint8_t> image;
+        auto encode_ns = encode<CFdbProtoMsgBuilder>([&record]() -> const CFdbProtoMessage &
+            {
+                return record;
+            }, iterations, image);
+
+        double sum = 0;
+        CFdbBenchTimer timer;
+        for (int32_t i = 0; i < iterations; ++i)
+        {
+            NFdbTelemetry::Telemetry decoded;
+            CFdbProtoMsgParser parser(decoded);
+            if (!parser.parse(&image[0], (int32_t)image.size()))
+            {
+                return 1;
+            }
+            sum = decoded.id() + decoded.speed() + decoded.name().size();
+            for (int32_t j = 0; j < decoded.samples_size(); ++j)
+            {
+                sum += decoded.samples(j);
+            }
+        }
+        printResult("protobuf", encode_ns, timer.nsPerIteration(iterations), sum, image.size());
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark of loop timers: [timers] CBaseLoopTimer are attached to a
+ * worker running the fd loop and enabled with intervals of 60 to 120
+ * seconds, so that they stay pending. Time to attach and enable, to
+ * re-enable a random timer and to delete is measured per timer.
+ *
+ * With all of them pending, a 7 ms one-shot timer is enabled [probes]
+ * times next to a 5 ms repeating timer, and the delay from enabling to
+ * firing is measured.
+ *
+ * Usage: fdbtimerbench [timers] [probes]
+ */
+
+#include <common_base/fdbus.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include "CFdbBench.h"
+
+#define BENCH_PROBE_INTERVAL 7
+#define BENCH_REPEAT_INTERVAL 5
+
+static int32_t farInterval()
+{
+    return 60000 + rand() % 60000;
+}
+
+class CIdleTimer : public CBaseLoopTimer
+{
+public:
+    CIdleTimer(int32_t interval, bool repeat = false)
+        : CBaseLoopTimer(interval, repeat)
+        , mFired(0)
+    {}
+    uint32_t mFired;
+protected:
+    void run()
+    {
+        ++mFired;
+    }
+};
+
+class CProbeTimer : public CBaseLoopTimer
+{
+public:
+    CProbeTimer()
+        : CBaseLoopTimer(BENCH_PROBE_INTERVAL, false)
+        , mDelaySum(0)
+        , mDelayMin(0)
+        , mDelayMax(0)
+        , mFired(0)
+    {}
+    CNanoTimer mEnabled;
+    double mDelaySum;
+    double mDelayMin;
+    double mDelayMax;
+    int32_t mFired;
+protected:
+    void run()
+    {
+        auto delay = mEnabled.snapshotNanoseconds() / 1000000.0;
+        mDelaySum += delay;
+        if (!mFired || (delay < mDelayMin))
+        {
+            mDelayMin = delay;
+        }
+        if (delay > mDelayMax)
+        {
+            mDelayMax = delay;
+        }
+        ++mFired;
+    }
+};
+
+typedef std::vector<CIdleTimer *> TimerTable_t;
+
+class CSetupJob : public CBaseJob
+{
+public:
+    CSetupJob(TimerTable_t &timers, int32_t count)
+        : CBaseJob(JOB_FORCE_RUN)
+        , mTimers(timers)
+        , mCount(count)
+        , mAttachNs(0)
+        , mEnableNs(0)
+    {}
+    TimerTable_t &mTimers;
+    int32_t mCount;
+    double mAttachNs;
+    double mEnableNs;
+protected:
+    void run(CBaseWorker *worker, Ptr &ref)
+    {
+        CFdbBenchTimer timer;
+        for (int32_t i = 0; i < mCount; ++i)
+        {
+            auto idle = new CIdleTimer(farInterval());
+            idle->attach(worker, true);
+            mTimers.push_back(idle);
+        }
+        mAttachNs = timer.nsPerIteration(mCount);
+
+        timer.start();
+        for (int32_t i = 0; i < mCount; ++i)
+        {
+            mTimers[rand() % mCount]->enable(farInterval());
+        }
+        mEnableNs = timer.nsPerIteration(mCount);
+    }
+};
+
+class CProbeJob : public CBaseJob
+{
+public:
+    CProbeJob(CProbeTimer *probe)
+        : CBaseJob(JOB_FORCE_RUN)
+        , mProbe(probe)
+    {}
+protected:
+    void run(CBaseWorker *worker, Ptr &ref)
+    {
+        mProbe->mEnabled.start();
+        mProbe->enableOneShot(BENCH_PROBE_INTERVAL);
+    }
+private:
+    CProbeTimer *mProbe;
+};
+
+// timers are deleted by the worker they are attached to
+class CTeardownJob : public CBaseJob
+{
+public:
+    CTeardownJob(TimerTable_t &timers, CIdleTimer *repeat, CProbeTimer *probe)
+        : CBaseJob(JOB_FORCE_RUN)
+        , mTimers(timers)
+        , mRepeat(repeat)
+        , mProbe(probe)
+        , mDeleteNs(0)
+        , mFired(0)
+        , mRepeatFired(0)
+        , mProbeFired(0)
+        , mDelaySum(0)
+        , mDelayMin(0)
+        , mDelayMax(0)
+    {}
+    TimerTable_t &mTimers;
+    CIdleTimer *mRepeat;
+    CProbeTimer *mProbe;
+    double mDeleteNs;
+    uint32_t mFired;
+    uint32_t mRepeatFired;
+    int32_t mProbeFired;
+    double mDelaySum;
+    double mDelayMin;
+    double mDelayMax;
+protected:
+    void run(CBaseWorker *worker, Ptr &ref)
+    {
+        mRepeatFired = mRepeat->mFired;
+        mProbeFired = mProbe->mFired;
+        mDelaySum = mProbe->mDelaySum;
+        mDelayMin = mProbe->mDelayMin;
+        mDelayMax = mProbe->mDelayMax;
+        delete mRepeat;
+        delete mProbe;
+        if (mTimers.empty())
+        {
+            return;
+        }
+        CFdbBenchTimer timer;
+        for (auto it = mTimers.begin(); it != mTimers.end(); ++it)
+        {
+            mFired += (*it)->mFired;
+            delete *it;
+        }
+        mDeleteNs = timer.nsPerIteration((int32_t)mTimers.size());
+        mTimers.clear();
+    }
+};
+
+int main(int argc, char **argv)
+{
+    int32_t count = (argc > 1) ? atoi(argv[1]) : 100000;
+    int32_t probes = (argc > 2) ? atoi(argv[2]) : 100;
+    if (count <= 0)
+    {
+        count = 1;
+    }
+    srand(1);
+
+    CBaseWorker worker("timer bench");
+    worker.start(FDB_WORKER_ENABLE_FD_LOOP);
+    auto repeat = new CIdleTimer(BENCH_REPEAT_INTERVAL, true);
+    repeat->attach(&worker, true);
+
+    TimerTable_t timers;
+    auto setup = new CSetupJob(timers, count);
+    CBaseJob::Ptr setup_ref(setup);
+    worker.sendSync(setup_ref);
+
+    auto probe = new CProbeTimer();
+    probe->attach(&worker, false);
+    for (int32_t i = 0; i < probes; ++i)
+    {
+        worker.sendSync(new CProbeJob(probe));
+        usleep(BENCH_PROBE_INTERVAL * 1000 * 3);
+    }
+
+    auto teardown = new CTeardownJob(timers, repeat, probe);
+    CBaseJob::Ptr teardown_ref(teardown);
+    worker.sendSync(teardown_ref);
+
+    printf("%d timers, %d probes (%u idle timers fired)\n", count, probes, teardown->mFired);
+    fdbPrintBenchResult("attach + enable:", setup->mAttachNs);
+    fdbPrintBenchResult("re-enable:", setup->mEnableNs);
+    fdbPrintBenchResult("delete:", teardown->mDeleteNs);
+    if (teardown->mProbeFired)
+    {
+        printf("%-30s%10.2f ms (min %.2f, max %.2f, %d fired)\n", "7 ms one-shot fired after:",
+               teardown->mDelaySum / teardown->mProbeFired, teardown->mDelayMin, teardown->mDelayMax,
+               teardown->mProbeFired);
+    }
+    printf("%-30s%10u\n", "5 ms repeat fired:", teardown->mRepeatFired);
+    worker.exit();
+    worker.join();
+    return 0;
+}
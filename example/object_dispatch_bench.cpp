@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark of message dispatch against number of objects: a server
+ * and a client in the same process, connected over a unix socket, get
+ * [objects] objects on each side; the time of a synchronous invoke to the
+ * last object created is measured at each count. The server finds the
+ * object from id of each incoming request.
+ *
+ * Usage: fdbdispatchbench [iterations] [objects...]
+ *        objects defaults to 1 1000 4000
+ */
+
+#include <common_base/fdbus.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include "CFdbBench.h"
+
+#define BENCH_URL "ipc:///tmp/fdb-dispatch-bench"
+#define BENCH_METHOD 1
+
+class CServerObject : public CFdbBaseObject
+{
+public:
+    CServerObject()
+        : CFdbBaseObject("bench server object")
+    {}
+protected:
+    void onInvoke(CBaseJob::Ptr &msg_ref)
+    {
+        auto msg = castToMessage<CBaseMessage *>(msg_ref);
+        msg->reply(msg_ref);
+    }
+};
+
+class CClientObject : public CFdbBaseObject
+{
+public:
+    CClientObject()
+        : CFdbBaseObject("bench client object")
+    {}
+};
+
+int main(int argc, char **argv)
+{
+    int32_t iterations = (argc > 1) ? atoi(argv[1]) : 20000;
+    std::vector<int32_t> counts;
+    for (int32_t i = 2; i < argc; ++i)
+    {
+        counts.push_back(atoi(argv[i]));
+    }
+    if (counts.empty())
+    {
+        counts = {1, 1000, 4000};
+    }
+
+    FDB_CONTEXT->start();
+    auto server = new CBaseServer("dispatch bench server");
+    server->bind(BENCH_URL);
+    auto client = new CBaseClient("dispatch bench client");
+    client->connect(BENCH_URL);
+    for (int32_t i = 0; (i < 100) && !client->connected(); ++i)
+    {
+        usleep(10000);
+    }
+    if (!client->connected())
+    {
+        printf("unable to connect to %s!\n", BENCH_URL);
+        return 1;
+    }
+
+    printf("%d synchronous invokes per count\n", iterations);
+    int32_t objects = 0;
+    CClientObject *last = 0;
+    for (auto it = counts.begin(); it != counts.end(); ++it)
+    {
+        while (objects < *it)
+        {
+            ++objects;
+            auto server_object = new CServerObject();
+            server_object->bind(server, (FdbObjectId_t)objects);
+            last = new CClientObject();
+            last->connect(client, (FdbObjectId_t)objects);
+        }
+        if (!last)
+        {
+            continue;
+        }
+
+        // warm up; also check the last object is reached
+        CBaseJob::Ptr ref(new CBaseMessage(BENCH_METHOD));
+        if (!last->invoke(ref, 0, 0, 1000) || castToMessage<CBaseMessage *>(ref)->isError())
+        {
+            printf("object %d can not be invoked!\n", objects);
+            return 1;
+        }
+
+        CFdbBenchTimer timer;
+        for (int32_t i = 0; i < iterations; ++i)
+        {
+            CBaseJob::Ptr msg_ref(new CBaseMessage(BENCH_METHOD));
+            last->invoke(msg_ref);
+        }
+        auto name = std::to_string(objects) + " objects:";
+        fdbPrintBenchResult(name.c_str(), timer.nsPerIteration(iterations));
+    }
+    return 0;
+}
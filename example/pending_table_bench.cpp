@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark of pending request tables in a deep pipeline: CFdbPendingTable
+ * against the std::map it replaces. [depth] requests are kept in flight:
+ * each request allocates a serial number and is inserted, and the oldest
+ * one is retrieved and removed as its reply arrives, just as a session
+ * does for asynchronous invokes.
+ *
+ * Usage: fdbpendingbench [requests] [depth...]
+ *        depth defaults to 1 100 10000
+ */
+
+#include <common_base/fdbus.h>
+#include <common_base/CFdbPendingTable.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <vector>
+#include "CFdbBench.h"
+
+static double runPendingTable(int32_t requests, int32_t depth, const CBaseJob::Ptr &job,
+                              uint64_t &checksum)
+{
+    CFdbPendingTable<CBaseJob::Ptr> table;
+    CFdbBenchTimer timer;
+    for (int32_t i = 0; i < requests; ++i)
+    {
+        auto sn = table.allocateSn();
+        table.insert(sn, job);
+        if (table.size() >= (uint32_t)depth)
+        {
+            auto replied = sn - (FdbMsgSn_t)depth + 1;
+            auto entry = table.retrieve(replied);
+            checksum += entry ? (uint64_t)entry->use_count() : 0;
+            table.remove(replied);
+        }
+    }
+    return timer.nsPerIteration(requests);
+}
+
+static double runMap(int32_t requests, int32_t depth, const CBaseJob::Ptr &job,
+                     uint64_t &checksum)
+{
+    std::map<FdbMsgSn_t, CBaseJob::Ptr> table;
+    FdbMsgSn_t sn_allocator = 0;
+    CFdbBenchTimer timer;
+    for (int32_t i = 0; i < requests; ++i)
+    {
+        auto sn = sn_allocator++;
+        table[sn] = job;
+        if (table.size() >= (size_t)depth)
+        {
+            auto replied = sn - (FdbMsgSn_t)depth + 1;
+            auto it = table.find(replied);
+            checksum += (it != table.end()) ? (uint64_t)it->second.use_count() : 0;
+            table.erase(it);
+        }
+    }
+    return timer.nsPerIteration(requests);
+}
+
+int main(int argc, char **argv)
+{
+    int32_t requests = (argc > 1) ? atoi(argv[1]) : 2000000;
+    std::vector<int32_t> depths;
+    for (int32_t i = 2; i < argc; ++i)
+    {
+        depths.push_back(atoi(argv[i]));
+    }
+    if (depths.empty())
+    {
+        depths = {1, 100, 10000};
+    }
+
+    // entries are references to a request as in a session
+    CBaseJob::Ptr job(new CBaseMessage(1));
+    uint64_t checksum = 0;
+    printf("%d requests per depth\n", requests);
+    for (auto it = depths.begin(); it != depths.end(); ++it)
+    {
+        auto depth = (*it > 0) ? *it : 1;
+        auto map_ns = runMap(requests, depth, job, checksum);
+        auto table_ns = runPendingTable(requests, depth, job, checksum);
+        printf("depth %d:\n", depth);
+        fdbPrintBenchResult("  std::map:", map_ns);
+        fdbPrintBenchResult("  CFdbPendingTable:", table_ns, map_ns);
+    }
+    printf("(checksum %llu)\n", (unsigned long long)checksum);
+    return 0;
+}
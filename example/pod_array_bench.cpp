@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark of POD CFdbParcelableArray: bulk copy of all elements against
+ * serializing and deserializing them one by one. Both give the same wire
+ * image, which is checked before timing.
+ *
+ * Usage: fdbpodarraybench [elements] [iterations]
+ */
+
+#include <common_base/fdbus.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CFdbBench.h"
+
+// same wire format as CFdbParcelableArray<T>, element by element
+template<typename T>
+class CPerElementArray : public IFdbParcelable
+{
+public:
+    void serialize(CFdbSimpleSerializer &serializer) const
+    {
+        serializer << (fdb_struct_arr_len_t)mPool.size();
+        for (auto it = mPool.begin(); it != mPool.end(); ++it)
+        {
+            serializer << *it;
+        }
+    }
+    void deserialize(CFdbSimpleDeserializer &deserializer)
+    {
+        fdb_struct_arr_len_t size = 0;
+        deserializer >> size;
+        mPool.resize(size);
+        for (fdb_struct_arr_len_t i = 0; i < size; ++i)
+        {
+            if (deserializer.error())
+            {
+                return;
+            }
+            deserializer >> mPool[i];
+        }
+    }
+    std::vector<T> mPool;
+};
+
+template<typename T>
+static double timeSerialize(const IFdbParcelable &array, int32_t iterations, uint64_t &checksum)
+{
+    CFdbBenchTimer timer;
+    for (int32_t i = 0; i < iterations; ++i)
+    {
+        CFdbSimpleSerializer serializer;
+        serializer << array;
+        checksum += serializer.buffer()[serializer.bufferSize() - 1];
+    }
+    return timer.nsPerIteration(iterations);
+}
+
+template<typename T>
+static double timeDeserialize(IFdbParcelable &array, const uint8_t *buffer, int32_t size,
+                              int32_t iterations)
+{
+    CFdbBenchTimer timer;
+    for (int32_t i = 0; i < iterations; ++i)
+    {
+        CFdbSimpleDeserializer deserializer(buffer, size);
+        deserializer >> array;
+    }
+    return timer.nsPerIteration(iterations);
+}
+
+template<typename T>
+static bool benchmark(const char *name, int32_t elements, int32_t iterations)
+{
+    CFdbParcelableArray<T> bulk;
+    CPerElementArray<T> loop;
+    for (int32_t i = 0; i < elements; ++i)
+    {
+        T value = (T)(i * 3 + 1) / (T)2;
+        bulk.Add(value);
+        loop.mPool.push_back(value);
+    }
+
+    CFdbSimpleSerializer bulk_image;
+    bulk_image << bulk;
+    CFdbSimpleSerializer loop_image;
+    loop_image << loop;
+    if ((bulk_image.bufferSize() != loop_image.bufferSize()) ||
+        memcmp(bulk_image.buffer(), loop_image.buffer(), bulk_image.bufferSize()))
+    {
+        printf("%s: wire images differ!\n", name);
+        return false;
+    }
+
+    uint64_t checksum = 0;
+    auto loop_ser = timeSerialize<T>(loop, iterations, checksum);
+    auto bulk_ser = timeSerialize<T>(bulk, iterations, checksum);
+
+    CPerElementArray<T> loop_out;
+    CFdbParcelableArray<T> bulk_out;
+    auto loop_des = timeDeserialize<T>(loop_out, loop_image.buffer(), loop_image.bufferSize(),
+                                       iterations);
+    auto bulk_des = timeDeserialize<T>(bulk_out, bulk_image.buffer(), bulk_image.bufferSize(),
+                                       iterations);
+    if ((bulk_out.size() != (uint32_t)elements) || (bulk_out.pool() != loop_out.mPool))
+    {
+        printf("%s: decoded arrays differ!\n", name);
+        return false;
+    }
+
+    printf("%-8s serialize:   loop %10.1f ns, bulk %10.1f ns (%.1fx) (checksum %llu)\n",
+           name, loop_ser, bulk_ser, loop_ser / bulk_ser, (unsigned long long)checksum);
+    printf("%-8s deserialize: loop %10.1f ns, bulk %10.1f ns (%.1fx)\n",
+           name, loop_des, bulk_des, loop_des / bulk_des);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int32_t elements = (argc > 1) ? atoi(argv[1]) : 10000;
+    int32_t iterations = (argc > 2) ? atoi(argv[2]) : 2000;
+
+    printf("%d elements, %d iterations\n", elements, iterations);
+    bool ok = benchmark<int32_t>("int32_t", elements, iterations);
+    ok = benchmark<float>("float", elements, iterations) && ok;
+    ok = benchmark<double>("double", elements, iterations) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark of protobuf payloads:
+ * - CFdbProtoMsgBuilder, which serializes with sizes cached by build(),
+ *   against serializing through CodedOutputStream, which computes sizes
+ *   of all sub-messages once more;
+ * - CFdbProtoArenaMsgParser against CFdbProtoMsgParser, which allocates
+ *   every sub-message and string on the heap.
+ *
+ * Usage: fdbprotobench [objects] [iterations]
+ */
+
+#include <common_base/fdbus.h>
+#include FDB_IDL_EXAMPLE_H
+#include <common_base/CFdbProtoMsgBuilder.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "CFdbBench.h"
+
+int main(int argc, char **argv)
+{
+    int32_t objects = (argc > 1) ? atoi(argv[1]) : 100;
+    int32_t iterations = (argc > 2) ? atoi(argv[2]) : 20000;
+
+    NFdbExample::FdbMsgObjectInfoTbl table;
+    for (int32_t i = 0; i < objects; ++i)
+    {
+        auto info = table.add_info();
+        info->set_obj_id(i);
+        info->set_obj_name("object " + std::to_string(i) + " of benchmark table");
+    }
+
+    int32_t size = 0;
+    uint64_t checksum = 0;
+
+    // size computed, then computed once more by SerializeToCodedStream()
+    CFdbBenchTimer timer;
+    for (int32_t i = 0; i < iterations; ++i)
+    {
+        size = (int32_t)table.ByteSizeLong();
+        auto buffer = new uint8_t[size];
+        google::protobuf::io::ArrayOutputStream aos(buffer, size);
+        google::protobuf::io::CodedOutputStream coded_output(&aos);
+        table.SerializeToCodedStream(&coded_output);
+        checksum += buffer[size - 1];
+        delete[] buffer;
+    }
+    auto coded_ns = timer.nsPerIteration(iterations);
+
+    timer.start();
+    for (int32_t i = 0; i < iterations; ++i)
+    {
+        CFdbProtoMsgBuilder builder(table);
+        size = builder.build();
+        auto buffer = new uint8_t[size];
+        builder.toBuffer(buffer, size);
+        checksum += buffer[size - 1];
+        delete[] buffer;
+    }
+    auto cached_ns = timer.nsPerIteration(iterations);
+
+    std::string image;
+    table.SerializeToString(&image);
+    auto wire = (const uint8_t *)image.data();
+
+    timer.start();
+    for (int32_t i = 0; i < iterations; ++i)
+    {
+        NFdbExample::FdbMsgObjectInfoTbl decoded;
+        CFdbProtoMsgParser parser(decoded);
+        if (!parser.parse(wire, (int32_t)image.size()) || (decoded.info_size() != objects))
+        {
+            printf("payload can not be parsed!\n");
+            return 1;
+        }
+        checksum += decoded.info(objects - 1).obj_id();
+    }
+    auto heap_ns = timer.nsPerIteration(iterations);
+
+    timer.start();
+    for (int32_t i = 0; i < iterations; ++i)
+    {
+        CFdbProtoArenaMsgParser<NFdbExample::FdbMsgObjectInfoTbl, 8192> parser;
+        if (!parser.parse(wire, (int32_t)image.size()) || (parser.message()->info_size() != objects))
+        {
+            printf("payload can not be parsed by arena parser!\n");
+            return 1;
+        }
+        checksum += parser.message()->info(objects - 1).obj_id();
+    }
+    auto arena_ns = timer.nsPerIteration(iterations);
+
+    printf("%d objects, %d bytes per payload, %d iterations (checksum %llu)\n",
+           objects, size, iterations, (unsigned long long)checksum);
+    fdbPrintBenchResult("serialize via coded stream:", coded_ns);
+    fdbPrintBenchResult("serialize with cached sizes:", cached_ns, coded_ns);
+    fdbPrintBenchResult("parse on heap:", heap_ns);
+    fdbPrintBenchResult("parse on arena:", arena_ns, heap_ns);
+    return 0;
+}
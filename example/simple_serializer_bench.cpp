@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark of simple serializer on nested CFdbParcelableArray payloads:
+ * CFdbParcelableBuilder, which serializes into the serializer's own
+ * buffer and copies it to the message buffer, and CFdbParcelableParser
+ * decoding the same payload.
+ *
+ * Usage: fdbserializerbench [persons] [iterations]
+ */
+
+#include <common_base/fdbus.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "CFdbBench.h"
+#include "CFdbIfPerson.h"
+
+class CFamily : public IFdbParcelable
+{
+public:
+    void serialize(CFdbSimpleSerializer &serializer) const
+    {
+        serializer << mName << mMembers;
+    }
+    void deserialize(CFdbSimpleDeserializer &deserializer)
+    {
+        deserializer >> mName >> mMembers;
+    }
+    std::string mName;
+    CFdbParcelableArray<CPerson> mMembers;
+
+protected:
+    void toString(std::ostringstream &stream) const
+    {
+        stream << "mName:" << mName << ", mMembers:"; mMembers.format(stream);
+    }
+};
+
+static void fillFamily(CFamily &family, int32_t persons)
+{
+    family.mName = "benchmark family";
+    for (int32_t i = 0; i < persons; ++i)
+    {
+        auto person = family.mMembers.Add();
+        person->mName = "person " + std::to_string(i);
+        person->mAge = (uint8_t)(20 + i % 50);
+        person->mSalary = 1000 * i;
+        person->mAddress = "No. " + std::to_string(i) + " some street, some city";
+        for (int32_t j = 0; j < 4; ++j)
+        {
+            auto car = person->mCars.Add();
+            car->mBrand = "brand " + std::to_string(j);
+            car->mModel = "model " + std::to_string(i * 4 + j);
+            car->mPrice = 10000 + j;
+        }
+        for (int32_t j = 0; j < 2; ++j)
+        {
+            auto info = person->mPrivateInfo.Add();
+            memset(info->vbuffer(), j, info->size());
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int32_t persons = (argc > 1) ? atoi(argv[1]) : 100;
+    int32_t iterations = (argc > 2) ? atoi(argv[2]) : 20000;
+
+    CFamily family;
+    fillFamily(family, persons);
+
+    int32_t size = 0;
+    uint64_t checksum = 0;
+
+    // serialize into serializer's own buffer, then copy to message buffer
+    CFdbBenchTimer timer;
+    for (int32_t i = 0; i < iterations; ++i)
+    {
+        CFdbParcelableBuilder builder(family);
+        size = builder.build();
+        auto buffer = new uint8_t[size];
+        builder.toBuffer(buffer, size);
+        checksum += buffer[size - 1];
+        delete[] buffer;
+    }
+    auto copy_ns = timer.nsPerIteration(iterations);
+
+    // build the payload once and parse it back repeatedly
+    CFdbParcelableBuilder builder(family);
+    size = builder.build();
+    auto buffer = new uint8_t[size];
+    builder.toBuffer(buffer, size);
+
+    timer.start();
+    for (int32_t i = 0; i < iterations; ++i)
+    {
+        CFamily decoded;
+        CFdbParcelableParser parser(decoded);
+        if (!parser.parse(buffer, size) || (decoded.mMembers.size() != (uint32_t)persons))
+        {
+            printf("payload can not be parsed!\n");
+            delete[] buffer;
+            return 1;
+        }
+        checksum += decoded.mMembers.size();
+    }
+    auto parse_ns = timer.nsPerIteration(iterations);
+    delete[] buffer;
+
+    printf("%d persons, %d bytes per payload, %d iterations (checksum %llu)\n",
+           persons, size, iterations, (unsigned long long)checksum);
+    fdbPrintBenchResult("serialize + copy:", copy_ns);
+    fdbPrintBenchResult("parse:", parse_ns);
+    return 0;
+}
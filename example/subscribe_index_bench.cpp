@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark of broadcasting to many subscriptions: CFdbSubscribeIndex
+ * against the nested code -> session -> object -> topic maps it
+ * replaces, which visit every (session, object) of the code for each
+ * broadcast. Sessions are only used as keys and are never dereferenced.
+ *
+ * Each of [sessions] sessions has [objects] objects; each object
+ * subscribes one topic of its own, and every 100th object also
+ * subscribes wildcard "".
+ *
+ * Usage: fdbsubscribebench [sessions] [objects] [broadcasts]
+ */
+
+#include <common_base/fdbus.h>
+#include <common_base/CFdbSubscribeIndex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <vector>
+#include "CFdbBench.h"
+
+#define BENCH_EVENT 100
+
+struct CSubscribeItem
+{
+    CFdbSubscribeType mType;
+};
+typedef std::map<std::string, CSubscribeItem> SubItemTable_t;
+typedef std::map<FdbObjectId_t, SubItemTable_t> ObjectTable_t;
+typedef std::map<CFdbSession *, ObjectTable_t> SessionTable_t;
+typedef std::map<FdbMsgCode_t, SessionTable_t> SubscribeTable_t;
+
+static uint32_t broadcastNested(SubscribeTable_t &subscribe_table, FdbMsgCode_t event,
+                                const char *filter)
+{
+    uint32_t sent = 0;
+    auto it_sessions = subscribe_table.find(event);
+    if (it_sessions == subscribe_table.end())
+    {
+        return 0;
+    }
+    auto &sessions = it_sessions->second;
+    for (auto it_objects = sessions.begin(); it_objects != sessions.end(); ++it_objects)
+    {
+        auto &objects = it_objects->second;
+        for (auto it_subitems = objects.begin(); it_subitems != objects.end(); ++it_subitems)
+        {
+            auto &subitems = it_subitems->second;
+            auto it_subitem = subitems.find(filter);
+            if (it_subitem != subitems.end())
+            {
+                ++sent;
+            }
+            else if ((filter[0] != '\0') && (subitems.find("") != subitems.end()))
+            {
+                ++sent;
+            }
+        }
+    }
+    return sent;
+}
+
+static std::string topicOf(int32_t session, int32_t object)
+{
+    return "vehicle/" + std::to_string(session) + "/signal/" + std::to_string(object);
+}
+
+int main(int argc, char **argv)
+{
+    int32_t sessions = (argc > 1) ? atoi(argv[1]) : 100;
+    int32_t objects = (argc > 2) ? atoi(argv[2]) : 100;
+    int32_t broadcasts = (argc > 3) ? atoi(argv[3]) : 10000;
+    int32_t subscriptions = 0;
+
+    std::vector<std::string> topics;
+    for (int32_t s = 0; s < sessions; ++s)
+    {
+        for (int32_t o = 0; o < objects; ++o)
+        {
+            topics.push_back(topicOf(s, o));
+        }
+    }
+
+    // sessions are never dereferenced: fake but distinct addresses
+    std::vector<char> session_storage(sessions);
+    auto sessionOf = [&session_storage](int32_t s)
+        {
+            return (CFdbSession *)&session_storage[s];
+        };
+
+    SubscribeTable_t nested;
+    CFdbSubscribeIndex index;
+    CFdbBenchTimer timer;
+    for (int32_t s = 0; s < sessions; ++s)
+    {
+        for (int32_t o = 0; o < objects; ++o)
+        {
+            nested[BENCH_EVENT][sessionOf(s)][o][topics[s * objects + o]].mType = FDB_SUB_TYPE_NORMAL;
+            if (!(o % 100))
+            {
+                nested[BENCH_EVENT][sessionOf(s)][o][""].mType = FDB_SUB_TYPE_NORMAL;
+            }
+        }
+    }
+    auto nested_sub_ns = timer.nsPerIteration(1);
+
+    timer.start();
+    for (int32_t s = 0; s < sessions; ++s)
+    {
+        for (int32_t o = 0; o < objects; ++o)
+        {
+            index.subscribe(BENCH_EVENT, sessionOf(s), o, topics[s * objects + o].c_str(),
+                            FDB_SUB_TYPE_NORMAL);
+            ++subscriptions;
+            if (!(o % 100))
+            {
+                index.subscribe(BENCH_EVENT, sessionOf(s), o, "", FDB_SUB_TYPE_NORMAL);
+                ++subscriptions;
+            }
+        }
+    }
+    auto index_sub_ns = timer.nsPerIteration(1);
+
+    uint64_t nested_sent = 0;
+    timer.start();
+    for (int32_t i = 0; i < broadcasts; ++i)
+    {
+        nested_sent += broadcastNested(nested, BENCH_EVENT, topics[(i * 7919) % topics.size()].c_str());
+    }
+    auto nested_ns = timer.nsPerIteration(broadcasts);
+
+    uint64_t index_sent = 0;
+    timer.start();
+    for (int32_t i = 0; i < broadcasts; ++i)
+    {
+        index.forEachMatch(BENCH_EVENT, topics[(i * 7919) % topics.size()].c_str(),
+                           [&index_sent](CFdbSubscribeIndex::CTarget &target)
+                           {
+                               ++index_sent;
+                           });
+    }
+    auto index_ns = timer.nsPerIteration(broadcasts);
+
+    if (nested_sent != index_sent)
+    {
+        printf("messages sent differ: %llu vs %llu!\n",
+               (unsigned long long)nested_sent, (unsigned long long)index_sent);
+        return 1;
+    }
+
+    timer.start();
+    for (int32_t s = 0; s < sessions; ++s)
+    {
+        index.unsubscribe(sessionOf(s));
+    }
+    auto index_unsub_ns = timer.nsPerIteration(1);
+
+    printf("%d subscriptions (%d sessions x %d objects), %d broadcasts, %llu messages\n",
+           subscriptions, sessions, objects, broadcasts, (unsigned long long)index_sent);
+    printf("%-22s%12s%12s\n", "", "nested map", "index");
+    printf("%-22s%10.1f us%10.1f us\n", "subscribe all:", nested_sub_ns / 1000, index_sub_ns / 1000);
+    printf("%-22s%10.1f ns%10.1f ns (%.1fx)\n", "broadcast:", nested_ns, index_ns, nested_ns / index_ns);
+    printf("%-22s%12s%10.1f us\n", "drop all sessions:", "", index_unsub_ns / 1000);
+    return 0;
+}
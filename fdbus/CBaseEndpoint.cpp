@@ -21,11 +21,19 @@
 #include <common_base/CIntraNameProxy.h>
 #include <utils/Log.h>
 
+// by default kick off a peer unable to receive for as long as the
+// retries of blocking send used to take
+#define FDB_SLOW_PEER_MAX_BYTES (16 * 1024 * 1024)
+#define FDB_SLOW_PEER_MAX_AGE (10 * 1000)
+
 CBaseEndpoint::CBaseEndpoint(const char *name, CBaseWorker *worker, EFdbEndpointRole role)
     : CFdbBaseObject(name, worker, role)
     , mSessionCnt(0)
     , mSnAllocator(1)
     , mEpid(FDB_INVALID_ID)
+    , mSlowPolicy(FDB_SLOW_DISCONNECT)
+    , mSlowMaxBytes(FDB_SLOW_PEER_MAX_BYTES)
+    , mSlowMaxAge(FDB_SLOW_PEER_MAX_AGE)
 {
     mObjId = FDB_OBJECT_MAIN;
     mEndpoint = this;
@@ -185,6 +193,11 @@ FdbObjectId_t CBaseEndpoint::addObject(CFdbBaseObject *obj)
     {
         return FDB_INVALID_ID;
     }
+    mObjectIdIndex[obj_id] = obj;
+    if (obj->role() == FDB_OBJECT_ROLE_SERVER)
+    {
+        mServerClassIndex[FDB_OBJECT_GET_CLASS(obj_id)] = obj;
+    }
 
     obj->enableMigrate(true);
     bool is_first = true;
@@ -241,6 +254,12 @@ void CBaseEndpoint::removeObject(CFdbBaseObject *obj)
     }
     
     mObjectContainer.deleteEntry(obj->objId());
+    mObjectIdIndex.erase(obj->objId());
+    auto it = mServerClassIndex.find(FDB_OBJECT_GET_CLASS(obj->objId()));
+    if ((it != mServerClassIndex.end()) && (it->second == obj))
+    {
+        mServerClassIndex.erase(it);
+    }
     // obj->objId(FDB_INVALID_ID);
     obj->enableMigrate(false);
 }
@@ -389,25 +408,10 @@ bool CBaseEndpoint::peerIp(std::string &peer_ip, CFdbSession *session)
 
 CFdbBaseObject *CBaseEndpoint::findObject(FdbObjectId_t obj_id, bool server_only)
 {
-    auto &object_tbl = mObjectContainer.getContainer();
-    for (auto it = object_tbl.begin(); it != object_tbl.end(); ++it)
-    {
-        auto object = it->second;
-        if (server_only)
-        {
-            if ((object->role() == FDB_OBJECT_ROLE_SERVER) &&
-                (FDB_OBJECT_GET_CLASS(obj_id) == 
-                    FDB_OBJECT_GET_CLASS(object->objId())))
-            {
-                return object;
-            }
-        }
-        else if (obj_id == object->objId())
-        {
-            return object;
-        }
-    }
-    return 0;
+    // only one server object is allowed for each class (see addObject())
+    auto &index = server_only ? mServerClassIndex : mObjectIdIndex;
+    auto it = index.find(server_only ? FDB_OBJECT_GET_CLASS(obj_id) : obj_id);
+    return (it == index.end()) ? 0 : it->second;
 }
 
 //================================== register ==========================================
@@ -553,9 +557,11 @@ bool CBaseEndpoint::requestServiceAddress(const char *server_name)
     {
         return false;
     }
-    if (server_name)
+    if (server_name && mNsName.compare(server_name))
     {
+        auto old_name = mNsName;
         mNsName = server_name;
+        CFdbContext::getInstance()->renameEndpoint(this, old_name);
     }
     if (mNsName.empty())
     {
@@ -312,6 +312,10 @@ void CBaseServer::onSidebandInvoke(CBaseJob::Ptr &msg_ref)
                         }
                         cinfo->set_peer_address(addr.c_str());
                         cinfo->set_security_level(session->securityLevel());
+                        CFdbOutboundStats stats;
+                        session->getOutboundStats(stats);
+                        cinfo->set_outbound(stats.mQueuedBytes, stats.mOldestAge, stats.mDropped,
+                                            stats.mConflated, stats.mSlowCount, stats.mSlow);
                     }
                 }
             }
@@ -333,10 +337,15 @@ bool CBaseServer::onMessageAuthentication(CFdbMessage *msg, CFdbSession *session
 
 bool CBaseServer::onEventAuthentication(CFdbMessage *msg, CFdbSession *session)
 {
-    auto security_level = mApiSecurity.getEventSecLevel(msg->code());
+    auto security_level = eventSecurityLevel(msg->code());
     return session->securityLevel() >= security_level;
 }
 
+int32_t CBaseServer::eventSecurityLevel(FdbMsgCode_t code)
+{
+    return mApiSecurity.getEventSecLevel(code);
+}
+
 bool CBaseServer::publishNoQueue(FdbMsgCode_t code, const char *topic, const void *buffer,
                                  int32_t size, CFdbSession *session)
 {
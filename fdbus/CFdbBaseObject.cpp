@@ -1,1847 +1,2991 @@
-/*
- * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
- *
- * Licensed under the Apache License, Version 2.0 (the "License");
- * you may not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- *      http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-#include <common_base/CFdbBaseObject.h>
-#include <common_base/CBaseEndpoint.h>
-#include <common_base/CFdbMessage.h>
-#include <common_base/CBaseWorker.h>
-#include <common_base/CFdbSession.h>
-#include <common_base/CFdbContext.h>
-#include <common_base/CFdbIfMessageHeader.h>
-#include <common_base/CFdbIfNameServer.h>
-#include <utils/Log.h>
-#include <string.h>
-
-enum EFdbCallback
-{
-    FDB_CALLBACK_ON_BROADCAST = 1,
-    FDB_CALLBACK_ON_GET_EVENT,
-    FDB_CALLBACK_ON_INVOKE,
-    FDB_CALLBACK_ON_ONLINE,
-    FDB_CALLBACK_ON_OFFLINE,
-    FDB_CALLBACK_ON_REPLY,
-    FDB_CALLBACK_ON_STATUS,
-    FDB_CALLBACK_ON_SUBSCRIBE,
-};
-
-CFdbBaseObject::CFdbBaseObject(const char *name, CBaseWorker *worker, EFdbEndpointRole role)
-    : mEndpoint(0)
-    , mWorker(worker)
-    , mObjId(FDB_INVALID_ID)
-    , mFlag(0)
-    , mRole(role)
-    , mSid(FDB_INVALID_ID)
-{
-    if (name)
-    {
-        mName = name;
-    }
-}
-
-CFdbBaseObject::~CFdbBaseObject()
-{
-}
-
-bool CFdbBaseObject::invoke(FdbSessionId_t receiver
-                          , FdbMsgCode_t code
-                          , IFdbMsgBuilder &data
-                          , int32_t timeout)
-{
-    auto msg = new CBaseMessage(code, this, receiver);
-    if (!msg->serialize(data, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->invoke(timeout);
-}
-
-bool CFdbBaseObject::invoke(FdbSessionId_t receiver
-                            , CFdbMessage *msg
-                            , IFdbMsgBuilder &data
-                            , int32_t timeout)
-{
-    msg->setDestination(this, receiver);
-    if (!msg->serialize(data, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->invoke(timeout);
-}
-
-bool CFdbBaseObject::invoke(FdbMsgCode_t code
-                            , IFdbMsgBuilder &data
-                            , int32_t timeout)
-{
-    return invoke(FDB_INVALID_ID, code, data, timeout);
-}
-
-bool CFdbBaseObject::invoke(CFdbMessage *msg
-                            , IFdbMsgBuilder &data
-                            , int32_t timeout)
-{
-    return invoke(FDB_INVALID_ID, msg, data, timeout);
-}
-
-bool CFdbBaseObject::invoke(FdbSessionId_t receiver
-                            , CBaseJob::Ptr &msg_ref
-                            , IFdbMsgBuilder &data
-                            , int32_t timeout)
-{
-    auto msg = castToMessage<CFdbMessage *>(msg_ref);
-    msg->setDestination(this, receiver);
-    if (!msg->serialize(data, this))
-    {
-       return false;
-    }
-    return msg->invoke(msg_ref, timeout);
-}
-
-bool CFdbBaseObject::invoke(CBaseJob::Ptr &msg_ref
-                            , IFdbMsgBuilder &data
-                            , int32_t timeout)
-{
-    return invoke(FDB_INVALID_ID, msg_ref, data, timeout);
-}
-
-bool CFdbBaseObject::send(FdbSessionId_t receiver
-                          , FdbMsgCode_t code
-                          , IFdbMsgBuilder &data)
-{
-    auto msg = new CBaseMessage(code, this, receiver);
-    if (!msg->serialize(data, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->send();
-}
-
-bool CFdbBaseObject::send(FdbMsgCode_t code, IFdbMsgBuilder &data)
-{
-    return send(FDB_INVALID_ID, code, data);
-}
-
-bool CFdbBaseObject::send(FdbSessionId_t receiver
-                         , FdbMsgCode_t code
-                         , const void *buffer
-                         , int32_t size
-                         , const char *log_data)
-{
-    auto msg = new CBaseMessage(code, this, receiver);
-    msg->setLogData(log_data);
-    if (!msg->serialize(buffer, size, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->send();
-}
-
-bool CFdbBaseObject::send(FdbMsgCode_t code
-                         , const void *buffer
-                         , int32_t size
-                         , const char *log_data)
-{
-    return send(FDB_INVALID_ID, code, buffer, size, log_data);
-}
-
-bool CFdbBaseObject::get(FdbMsgCode_t code, const char *topic, int32_t timeout)
-{
-    auto msg = new CBaseMessage(code, this, FDB_INVALID_ID);
-    if (!msg->serialize(0, 0, this))
-    {
-        delete msg;
-        return false;
-    }
-    msg->topic(topic);
-    msg->setEventGet(true);
-    return msg->invoke(timeout);
-}
-
-bool CFdbBaseObject::get(CFdbMessage *msg, const char *topic, int32_t timeout)
-{
-    msg->setDestination(this, FDB_INVALID_ID);
-    if (!msg->serialize(0, 0, this))
-    {
-        delete msg;
-        return false;
-    }
-    msg->topic(topic);
-    msg->setEventGet(true);
-    return msg->invoke(timeout);
-}
-
-bool CFdbBaseObject::get(CBaseJob::Ptr &msg_ref, const char *topic, int32_t timeout)
-{
-    auto msg = castToMessage<CFdbMessage *>(msg_ref);
-    msg->setDestination(this, FDB_INVALID_ID);
-    if (!msg->serialize(0, 0, this))
-    {
-        return false;
-    }
-    msg->topic(topic);
-    msg->setEventGet(true);
-    return msg->invoke(msg_ref, timeout);
-}
-
-bool CFdbBaseObject::sendLog(FdbMsgCode_t code, IFdbMsgBuilder &data)
-{
-    auto msg = new CBaseMessage(code, this);
-    if (!msg->serialize(data))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->send();
-}
-
-bool CFdbBaseObject::sendLogNoQueue(FdbMsgCode_t code, IFdbMsgBuilder &data)
-{
-    CBaseMessage msg(code, this);
-    msg.expectReply(false);
-    if (!msg.serialize(data))
-    {
-        return false;
-    }
-    auto session = mEndpoint->preferredPeer();
-    if (session)
-    {
-        return session->sendMessage(&msg);
-    }
-    return false;
-}
-
-bool CFdbBaseObject::broadcast(FdbMsgCode_t code
-                               , IFdbMsgBuilder &data
-                               , const char *filter)
-{
-    auto msg = new CFdbMessage(code, this, filter);
-    if (!msg->serialize(data, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->broadcast();
-}
-
-bool CFdbBaseObject::broadcast(FdbMsgCode_t code
-                              , const void *buffer
-                              , int32_t size
-                              , const char *filter
-                              , const char *log_data)
-{
-    auto msg = new CFdbMessage(code, this, filter, FDB_INVALID_ID, FDB_INVALID_ID);
-    msg->setLogData(log_data);
-    if (!msg->serialize(buffer, size, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->broadcast();
-}
-
-void CFdbBaseObject::broadcastLogNoQueue(FdbMsgCode_t code, const uint8_t *data, int32_t size,
-                                         const char *filter)
-{
-    CFdbMessage msg(code, this, filter, FDB_INVALID_ID, FDB_INVALID_ID);
-    if (!msg.serialize(data, size, this))
-    {
-        return;
-    }
-    msg.enableLog(false);
-
-    broadcast(&msg);
-}
-
-void CFdbBaseObject::broadcastNoQueue(FdbMsgCode_t code, const uint8_t *data, int32_t size,
-                                      const char *filter, bool force_update)
-{
-    CFdbMessage msg(code, this, filter, FDB_INVALID_ID, FDB_INVALID_ID);
-    if (!msg.serialize(data, size, this))
-    {
-        return;
-    }
-    msg.forceUpdate(force_update);
-
-    broadcast(&msg);
-}
-
-bool CFdbBaseObject::unsubscribe(CFdbMsgSubscribeList &msg_list)
-{
-    auto msg = new CBaseMessage(FDB_INVALID_ID, this);
-    msg->type(FDB_MT_SUBSCRIBE_REQ);
-    CFdbParcelableBuilder builder(msg_list);
-    if (!msg->serialize(builder, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->unsubscribe();
-}
-
-bool CFdbBaseObject::unsubscribe()
-{
-    CFdbMsgSubscribeList msg_list;
-    return unsubscribe(msg_list);
-}
-
-bool CFdbBaseObject::migrateOnSubscribeToWorker(CBaseJob::Ptr &msg_ref, CBaseWorker *worker)
-{
-    if (!worker)
-    {
-        worker = mWorker;
-    }
-    if (worker)
-    {
-        if (enableMigrate())
-        {
-            auto msg = castToMessage<CBaseMessage *>(msg_ref);
-            msg->setRemoteCall(this, FDB_CALLBACK_ON_SUBSCRIBE);
-            if (!worker->sendAsync(msg_ref))
-            {
-                LOG_E("CFdbBaseObject: Unable to migrate onsubscribe to worker!\n");
-            }
-        }
-        return true;
-    }
-    return false;
-}
-
-bool CFdbBaseObject::migrateOnBroadcastToWorker(CBaseJob::Ptr &msg_ref, CBaseWorker *worker)
-{
-    if (!worker)
-    {
-        worker = mWorker;
-    }
-    if (worker)
-    {
-        if (enableMigrate())
-        {
-            auto msg = castToMessage<CBaseMessage *>(msg_ref);
-            msg->setRemoteCall(this, FDB_CALLBACK_ON_BROADCAST);
-            if (!worker->sendAsync(msg_ref))
-            {
-                LOG_E("CFdbBaseObject: Unable to migrate onbroadcast to worker!\n");
-            }
-        }
-        return true;
-    }
-    return false;
-}
-
-bool CFdbBaseObject::migrateOnInvokeToWorker(CBaseJob::Ptr &msg_ref, CBaseWorker *worker)
-{
-    if (!worker)
-    {
-        worker = mWorker;
-    }
-    if (worker)
-    {
-        if (enableMigrate())
-        {
-            auto msg = castToMessage<CBaseMessage *>(msg_ref);
-            msg->setRemoteCall(this, FDB_CALLBACK_ON_INVOKE);
-            if (!worker->sendAsync(msg_ref))
-            {
-                LOG_E("CFdbBaseObject: Unable to migrate oninvoke to worker!\n");
-            }
-        }
-        return true;
-    }
-    return false;
-}
-
-class COnOfflineJob : public CMethodJob<CFdbBaseObject>
-{
-public:
-    COnOfflineJob(CFdbBaseObject *object, FdbSessionId_t sid, bool is_last)
-        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callOnOffline, JOB_FORCE_RUN)
-        , mSid(sid)
-        , mIsLast(is_last)
-    {}
-
-    FdbSessionId_t mSid;
-    bool mIsLast;
-};
-
-void CFdbBaseObject::callOnOffline(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
-{
-    COnOfflineJob *the_job = fdb_dynamic_cast_if_available<COnOfflineJob *>(job);
-    if (the_job)
-    {
-        onOffline(the_job->mSid, the_job->mIsLast);
-        if (!isPrimary() && (mSid == the_job->mSid))
-        {
-            mSid = FDB_INVALID_ID;
-        }
-    }
-}
-
-bool CFdbBaseObject::migrateOnOfflineToWorker(FdbSessionId_t sid, bool is_last, CBaseWorker *worker)
-{
-    if (!worker)
-    {
-        worker = mWorker;
-    }
-    if (worker)
-    {
-        if (enableMigrate())
-        {
-            if (!worker->sendAsync(new COnOfflineJob(this, sid, is_last)))
-            {
-                LOG_E("CFdbBaseObject: Unable to migrate onoffline to worker!\n");
-            }
-        }
-        return true;
-    }
-    return false;
-}
-
-void CFdbBaseObject::notifyOffline(CFdbSession *session, bool is_last)
-{
-    if (!migrateOnOfflineToWorker(session->sid(), is_last))
-    {
-        onOffline(session->sid(), is_last);
-        if (!isPrimary() && (mSid == session->sid()))
-        {
-            mSid = FDB_INVALID_ID;
-        }
-    }
-}
-
-class COnOnlineJob : public CMethodJob<CFdbBaseObject>
-{
-public:
-    COnOnlineJob(CFdbBaseObject *object, FdbSessionId_t sid, bool is_first)
-        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callOnOnline, JOB_FORCE_RUN)
-        , mSid(sid)
-        , mIsFirst(is_first)
-    {}
-
-    FdbSessionId_t mSid;
-    bool mIsFirst;
-};
-
-void CFdbBaseObject::callOnOnline(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
-{
-    auto the_job = fdb_dynamic_cast_if_available<COnOnlineJob *>(job);
-    if (the_job)
-    {
-        if (!isPrimary() && (mRole == FDB_OBJECT_ROLE_CLIENT) && !fdbValidFdbId(mSid))
-        {
-            mSid = the_job->mSid;
-        }
-        onOnline(the_job->mSid, the_job->mIsFirst);
-    }
-}
-
-bool CFdbBaseObject::migrateOnOnlineToWorker(FdbSessionId_t sid, bool is_first, CBaseWorker *worker)
-{
-    if (!worker)
-    {
-        worker = mWorker;
-    }
-    if (worker)
-    {
-        if (enableMigrate())
-        {
-            if (!worker->sendAsync(new COnOnlineJob(this, sid, is_first)))
-            {
-                LOG_E("CFdbBaseObject: Unable to migrate ononline to worker!\n");
-            }
-        }
-        return true;
-    }
-    return false;
-}
-
-void CFdbBaseObject::notifyOnline(CFdbSession *session, bool is_first)
-{
-    if (isPrimary() && (mRole == FDB_OBJECT_ROLE_CLIENT))
-    {
-        // send session info from client to primary object of server
-        NFdbBase::FdbSessionInfo sinfo;
-        sinfo.set_sender_name(mName.c_str());
-        CFdbParcelableBuilder builder(sinfo);
-        sendSideband(FDB_SIDEBAND_SESSION_INFO, builder);
-    }
-
-    if (!migrateOnOnlineToWorker(session->sid(), is_first))
-    {
-        if (!isPrimary() && (mRole == FDB_OBJECT_ROLE_CLIENT) && !fdbValidFdbId(mSid))
-        {
-            mSid = session->sid();
-        }
-        onOnline(session->sid(), is_first);
-    }
-}
-
-bool CFdbBaseObject::migrateOnReplyToWorker(CBaseJob::Ptr &msg_ref, CBaseWorker *worker)
-{
-    if (!worker)
-    {
-        worker = mWorker;
-    }
-    if (worker)
-    {
-        if (enableMigrate())
-        {
-            auto msg = castToMessage<CBaseMessage *>(msg_ref);
-            msg->setRemoteCall(this, FDB_CALLBACK_ON_REPLY);
-            if (!worker->sendAsync(msg_ref))
-            {
-                LOG_E("CFdbBaseObject: Unable to migrate onreply to worker!\n");
-            }
-        }
-        return true;
-    }
-    return false;
-}
-
-bool CFdbBaseObject::migrateGetEventToWorker(CBaseJob::Ptr &msg_ref, CBaseWorker *worker)
-{
-    if (!worker)
-    {
-        worker = mWorker;
-    }
-    if (worker)
-    {
-        if (enableMigrate())
-        {
-            auto msg = castToMessage<CBaseMessage *>(msg_ref);
-            msg->setRemoteCall(this, FDB_CALLBACK_ON_GET_EVENT);
-            if (!worker->sendAsync(msg_ref))
-            {
-                LOG_E("CFdbBaseObject: Unable to migrate onreply to worker!\n");
-            }
-        }
-        return true;
-    }
-    return false;
-}
-
-bool CFdbBaseObject::migrateOnStatusToWorker(CBaseJob::Ptr &msg_ref, CBaseWorker *worker)
-{
-    if (!worker)
-    {
-        worker = mWorker;
-    }
-    if (worker)
-    {
-        if (enableMigrate())
-        {
-            auto msg = castToMessage<CBaseMessage *>(msg_ref);
-            msg->setRemoteCall(this, FDB_CALLBACK_ON_STATUS);
-            if (!worker->sendAsync(msg_ref))
-            {
-                LOG_E("CFdbBaseObject: Unable to migrate onstatus to worker!\n");
-            }
-        }
-        return true;
-    }
-    return false;
-}
-
-const CFdbBaseObject::CEventData *CFdbBaseObject::getCachedEventData(FdbMsgCode_t msg_code,
-                                                                     const char *filter)
-{
-    auto it_events = mEventCache.find(msg_code);
-    if (it_events != mEventCache.end())
-    {
-        auto &events = it_events->second;
-        auto it_event = events.find(filter);
-        if (it_event != events.end())
-        {
-            auto &data = it_event->second;
-            return &data;
-        }
-    }
-    return 0;
-}
-
-void CFdbBaseObject::broadcastCached(CBaseJob::Ptr &msg_ref)
-{
-    auto msg = castToMessage<CFdbMessage *>(msg_ref);
-    auto session = FDB_CONTEXT->getSession(msg->session());
-    if (!session)
-    {
-        return;
-    }
-    const CFdbMsgSubscribeItem *sub_item;
-    /* iterate all message id subscribed */
-    FDB_BEGIN_FOREACH_SIGNAL(msg, sub_item)
-    {
-        FdbMsgCode_t msg_code = sub_item->msg_code();
-        const char *filter = "";
-        if (sub_item->has_filter())
-        {
-            filter = sub_item->filter().c_str();
-        }
-        auto cached_data = getCachedEventData(msg_code, filter);
-        if (cached_data)
-        {
-            CFdbMessage broadcast_msg(msg_code, msg, filter);
-            if (broadcast_msg.serialize(cached_data->mBuffer, cached_data->mSize, this))
-            {
-                broadcast_msg.forceUpdate(true);
-                broadcast(&broadcast_msg, session);
-            }
-        }
-    }
-    FDB_END_FOREACH_SIGNAL()
-}
-
-void CFdbBaseObject::doSubscribe(CBaseJob::Ptr &msg_ref)
-{
-    if (mFlag & FDB_OBJ_ENABLE_EVENT_CACHE)
-    {
-        /* broadcast current value of event/filter pair */
-        broadcastCached(msg_ref);
-        CFdbMessage::autoReply(msg_ref, NFdbBase::FDB_ST_AUTO_REPLY_OK, "Automatically reply to subscribe request.");
-        return;
-    }
-
-    if (!migrateOnSubscribeToWorker(msg_ref))
-    {
-        onSubscribe(msg_ref);
-        CFdbMessage::autoReply(msg_ref, NFdbBase::FDB_ST_AUTO_REPLY_OK, "Automatically reply to subscribe request.");
-    }
-}
-
-void CFdbBaseObject::doBroadcast(CBaseJob::Ptr &msg_ref)
-{
-    if (!migrateOnBroadcastToWorker(msg_ref))
-    {
-        onBroadcast(msg_ref);
-    }
-}
-
-void CFdbBaseObject::doInvoke(CBaseJob::Ptr &msg_ref)
-{
-    if (mFlag & FDB_OBJ_ENABLE_EVENT_CACHE)
-    {
-        /* reply current value for 'get' request */
-        auto msg = castToMessage<CBaseMessage *>(msg_ref);
-        if (msg->isEventGet())
-        {
-            if (!msg->expectReply())
-            {
-                msg->status(msg_ref, NFdbBase::FDB_ST_BAD_PARAMETER, "Intend to get event but reply is not expected!");
-                return;
-            }
-            /*
-             * We come here because client intends to retrieve current value of event/topic pair.
-             * It acts as a 'get' command.
-             */
-            auto cached_data = getCachedEventData(msg->code(), msg->topic().c_str());
-            if (cached_data)
-            {
-                msg->replyNoQueue(msg_ref, cached_data->mBuffer, cached_data->mSize);
-            }
-            else
-            {
-                msg->statusf(msg_ref, NFdbBase::FDB_ST_NON_EXIST, "Event %d topic %s doesn't exists!",
-                             msg->code(), msg->topic().c_str());
-            }
-            return;
-        }
-    }
-
-    if (!migrateOnInvokeToWorker(msg_ref))
-    {
-        onInvoke(msg_ref);
-        CFdbMessage::autoReply(msg_ref, NFdbBase::FDB_ST_AUTO_REPLY_OK, "Automatically reply to request.");
-    }
-}
-
-void CFdbBaseObject::doReply(CBaseJob::Ptr &msg_ref)
-{
-    if (!migrateOnReplyToWorker(msg_ref))
-    {
-        onReply(msg_ref);
-    }
-}
-
-void CFdbBaseObject::doGetEvent(CBaseJob::Ptr &msg_ref)
-{
-    if (!migrateGetEventToWorker(msg_ref))
-    {
-        onGetEvent(msg_ref);
-    }
-}
-
-void CFdbBaseObject::doStatus(CBaseJob::Ptr &msg_ref)
-{
-    if (!migrateOnStatusToWorker(msg_ref))
-    {
-        auto fdb_msg = castToMessage<CFdbMessage *>(msg_ref);
-        int32_t error_code;
-        std::string description;
-        if (!fdb_msg->decodeStatus(error_code, description))
-        {
-            return;
-        }
-
-        onStatus(msg_ref, error_code, description.c_str());
-    }
-}
-
-bool CFdbBaseObject::invoke(FdbSessionId_t receiver
-                           , FdbMsgCode_t code
-                           , const void *buffer
-                           , int32_t size
-                           , int32_t timeout
-                           , const char *log_data)
-{
-    auto msg = new CBaseMessage(code, this, receiver);
-    msg->setLogData(log_data);
-    if (!msg->serialize(buffer, size, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->invoke(timeout);
-}
-
-bool CFdbBaseObject::invoke(FdbMsgCode_t code
-                           , const void *buffer
-                           , int32_t size
-                           , int32_t timeout
-                           , const char *log_data)
-{
-    return invoke(FDB_INVALID_ID, code, buffer, size, timeout, log_data);
-}
-
-
-bool CFdbBaseObject::invoke(FdbSessionId_t receiver
-                           , CFdbMessage *msg
-                           , const void *buffer
-                           , int32_t size
-                           , int32_t timeout)
-{
-    msg->setDestination(this, receiver);
-    if (!msg->serialize(buffer, size, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->invoke(timeout);
-}
-
-bool CFdbBaseObject::invoke(CFdbMessage *msg
-                           , const void *buffer
-                           , int32_t size
-                           , int32_t timeout)
-{
-    return invoke(FDB_INVALID_ID, msg, buffer, size, timeout);
-}
-
-bool CFdbBaseObject::invoke(FdbSessionId_t receiver
-                           , CBaseJob::Ptr &msg_ref
-                           , const void *buffer
-                           , int32_t size
-                           , int32_t timeout)
-{
-    auto msg = castToMessage<CFdbMessage *>(msg_ref);
-    msg->setDestination(this, receiver);
-    if (!msg->serialize(buffer, size, this))
-    {
-       return false;
-    }
-    return msg->invoke(msg_ref, timeout);
-}
-
-bool CFdbBaseObject::invoke(CBaseJob::Ptr &msg_ref
-                           , const void *buffer
-                           , int32_t size
-                           , int32_t timeout)
-{
-    return invoke(FDB_INVALID_ID, msg_ref, buffer, size, timeout);
-}
-
-bool CFdbBaseObject::subscribe(CFdbMsgSubscribeList &msg_list
-                              , int32_t timeout)
-{
-    auto msg = new CBaseMessage(FDB_INVALID_ID, this);
-    msg->type(FDB_MT_SUBSCRIBE_REQ);
-    CFdbParcelableBuilder builder(msg_list);
-    if (!msg->serialize(builder, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->subscribe(timeout);
-}
-
-bool CFdbBaseObject::subscribe(CFdbMsgSubscribeList &msg_list
-                              , CFdbMessage *msg
-                              , int32_t timeout)
-{
-    msg->type(FDB_MT_SUBSCRIBE_REQ);
-    msg->setDestination(this);
-    CFdbParcelableBuilder builder(msg_list);
-    if (!msg->serialize(builder, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->subscribe(timeout);
-}
-
-bool CFdbBaseObject::subscribeSync(CFdbMsgSubscribeList &msg_list
-                              , int32_t timeout)
-{
-    auto msg = new CBaseMessage(FDB_INVALID_ID, this);
-    msg->type(FDB_MT_SUBSCRIBE_REQ);
-    msg->setDestination(this);
-    CFdbParcelableBuilder builder(msg_list);
-    if (!msg->serialize(builder, this))
-    {
-        delete msg;
-        return false;
-    }
-    CBaseJob::Ptr msg_ref(msg);
-    if (!msg->subscribe(msg_ref, timeout))
-    {
-        return false;
-    }
-    if (msg->isError())
-    {
-        return false;
-    }
-    if (worker())
-    {
-        worker()->flush();
-    }
-
-    return true;
-}
-
-bool CFdbBaseObject::update(CFdbMsgTriggerList &msg_list
-                            , int32_t timeout)
-{
-    auto msg = new CBaseMessage(FDB_INVALID_ID, this);
-    msg->type(FDB_MT_SUBSCRIBE_REQ);
-    CFdbParcelableBuilder builder(msg_list);
-    if (!msg->serialize(builder, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->update(timeout);
-}
-
-bool CFdbBaseObject::update(CFdbMsgTriggerList &msg_list
-                            , CFdbMessage *msg
-                            , int32_t timeout)
-{
-    msg->type(FDB_MT_SUBSCRIBE_REQ);
-    msg->setDestination(this);
-    CFdbParcelableBuilder builder(msg_list);
-    if (!msg->serialize(builder, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->update(timeout);
-}
-
-bool CFdbBaseObject::updateSync(CFdbMsgTriggerList &msg_list
-                                , int32_t timeout)
-{
-    auto msg = new CBaseMessage(FDB_INVALID_ID, this);
-    msg->type(FDB_MT_SUBSCRIBE_REQ);
-    msg->setDestination(this);
-    CFdbParcelableBuilder builder(msg_list);
-    if (!msg->serialize(builder, this))
-    {
-        delete msg;
-        return false;
-    }
-    CBaseJob::Ptr msg_ref(msg);
-    if (!msg->update(msg_ref, timeout))
-    {
-        return false;
-    }
-    if (msg->isError())
-    {
-        return false;
-    }
-    if (worker())
-    {
-        worker()->flush();
-    }
-
-    return true;
-}
-
-void CFdbBaseObject::addNotifyItem(CFdbMsgSubscribeList &msg_list
-                                  , FdbMsgCode_t msg_code
-                                  , const char *filter)
-{
-    auto item = msg_list.add_subscribe_tbl();
-    item->set_msg_code(msg_code);
-    if (filter)
-    {
-        item->set_filter(filter);
-    }
-}
-
-void CFdbBaseObject::addNotifyGroup(CFdbMsgSubscribeList &msg_list
-                                    , FdbEventGroup_t event_group
-                                    , const char *filter)
-{
-    addNotifyItem(msg_list, fdbmakeEventGroup(event_group), filter);
-}
-
-void CFdbBaseObject::addUpdateItem(CFdbMsgSubscribeList &msg_list
-                                  , FdbMsgCode_t msg_code
-                                  , const char *filter)
-{
-    auto item = msg_list.add_subscribe_tbl();
-    item->set_msg_code(msg_code);
-    if (filter)
-    {
-        item->set_filter(filter);
-    }
-    item->set_type(FDB_SUB_TYPE_ON_REQUEST);
-}
-
-void CFdbBaseObject::addUpdateGroup(CFdbMsgSubscribeList &msg_list
-                                    , FdbEventGroup_t event_group
-                                    , const char *filter)
-{
-    addUpdateItem(msg_list, fdbmakeEventGroup(event_group), filter);
-}
-
-void CFdbBaseObject::addTriggerItem(CFdbMsgTriggerList &msg_list
-                                     , FdbMsgCode_t msg_code
-                                     , const char *filter)
-{
-    addNotifyItem(msg_list, msg_code, filter);
-}
-
- void CFdbBaseObject::addTriggerGroup(CFdbMsgTriggerList &msg_list
-                                      , FdbEventGroup_t event_group
-                                      , const char *filter)
-{
-    addNotifyGroup(msg_list, event_group, filter);
-}
-
-void CFdbBaseObject::subscribe(CFdbSession *session,
-                               FdbMsgCode_t msg,
-                               FdbObjectId_t obj_id,
-                               const char *filter,
-                               CFdbSubscribeType type)
-{
-    if (!filter)
-    {
-        filter = "";
-    }
-    SubscribeTable_t &subscribe_table = fdbIsGroup(msg) ? mGroupSubscribeTable : mEventSubscribeTable;
-    auto &subitem = subscribe_table[msg][session][obj_id][filter];
-    subitem.mType = type;
-}
-
-void CFdbBaseObject::unsubscribe(CFdbSession *session,
-                                 FdbMsgCode_t msg,
-                                 FdbObjectId_t obj_id,
-                                 const char *filter)
-{
-    SubscribeTable_t &subscribe_table = fdbIsGroup(msg) ? mGroupSubscribeTable : mEventSubscribeTable;
-    
-    auto it_sessions = subscribe_table.find(msg);
-    if (it_sessions != subscribe_table.end())
-    {
-        auto &sessions = it_sessions->second;
-        auto it_objects = sessions.find(session);
-        if (it_objects != sessions.end())
-        {
-            auto &objects = it_objects->second;
-            auto it_subitems = objects.find(obj_id);
-            if (it_subitems != objects.end())
-            {
-                if (filter)
-                {
-                    auto &subitems = it_subitems->second;
-                    auto it_subitem = subitems.find(filter);
-                    if (it_subitem != subitems.end())
-                    {
-                        subitems.erase(it_subitem);
-                    }
-                    if (subitems.empty())
-                    {
-                        objects.erase(it_subitems);
-                    }
-                }
-                else
-                {
-                    objects.erase(it_subitems);
-                }
-            }
-            if (objects.empty())
-            {
-                sessions.erase(it_objects);
-            }
-        }
-        if (sessions.empty())
-        {
-            subscribe_table.erase(it_sessions);
-        }
-    }
-}
-
-void CFdbBaseObject::unsubscribeSession(SubscribeTable_t &subscribe_table,
-                                        CFdbSession *session)
-{
-    for (auto it_sessions = subscribe_table.begin();
-            it_sessions != subscribe_table.end();)
-    {
-        auto the_it_sessions = it_sessions;
-        ++it_sessions;
-
-        auto &sessions = the_it_sessions->second;
-        auto it_objects = sessions.find(session);
-        if (it_objects != sessions.end())
-        {
-            sessions.erase(it_objects);
-        }
-        if (sessions.empty())
-        {
-            subscribe_table.erase(the_it_sessions);
-        }
-    }
-}
-
-void CFdbBaseObject::unsubscribe(CFdbSession *session)
-{
-    unsubscribeSession(mEventSubscribeTable, session);
-    unsubscribeSession(mGroupSubscribeTable, session);
-}
-
-void CFdbBaseObject::unsubscribeObject(SubscribeTable_t &subscribe_table,
-                                       FdbObjectId_t obj_id)
-{
-    for (auto it_sessions = subscribe_table.begin();
-            it_sessions != subscribe_table.end();)
-    {
-        auto the_it_sessions = it_sessions;
-        ++it_sessions;
-
-        auto &sessions = the_it_sessions->second;
-        for (auto it_objects = sessions.begin();
-                it_objects != sessions.end();)
-        {
-            auto the_it_objects = it_objects;
-            ++it_objects;
-
-            auto &objects = the_it_objects->second;
-            auto it_subitems = objects.find(obj_id);
-            if (it_subitems != objects.end())
-            {
-                objects.erase(it_subitems);
-            }
-            if (objects.empty())
-            {
-                sessions.erase(the_it_objects);
-            }
-        }
-        if (sessions.empty())
-        {
-            subscribe_table.erase(the_it_sessions);
-        }
-    }
-}
-
-void CFdbBaseObject::unsubscribe(FdbObjectId_t obj_id)
-{
-    unsubscribeObject(mEventSubscribeTable, obj_id);
-    unsubscribeObject(mGroupSubscribeTable, obj_id);
-}
-
-void CFdbBaseObject::broadcastOneMsg(CFdbSession *session,
-                                     CFdbMessage *msg,
-                                     CSubscribeItem &sub_item)
-{
-    if ((sub_item.mType == FDB_SUB_TYPE_NORMAL) || msg->manualUpdate())
-    {
-        session->sendMessage(msg);
-    }
-}
-
-void CFdbBaseObject::broadcast(SubscribeTable_t &subscribe_table,
-                               CFdbMessage *msg, FdbMsgCode_t event)
-{
-    auto it_sessions = subscribe_table.find(event);
-    if (it_sessions != subscribe_table.end())
-    {
-        auto filter = msg->topic().c_str();
-        auto &sessions = it_sessions->second;
-        for (auto it_objects = sessions.begin();
-                it_objects != sessions.end(); ++it_objects)
-        {
-            auto session = it_objects->first;
-            auto &objects = it_objects->second;
-            for (auto it_subitems = objects.begin();
-                    it_subitems != objects.end(); ++it_subitems)
-            {
-                auto object_id = it_subitems->first;
-                msg->updateObjectId(object_id); // send to the specific object.
-                auto &subitems = it_subitems->second;
-                auto it_subitem = subitems.find(filter);
-                if (it_subitem == subitems.end())
-                {
-                    /*
-                     * If filter doesn't match, check who registers filter "".
-                     * It represents any filter.
-                     */
-                    if (filter[0] != '\0')
-                    {
-                        auto it_subitem = subitems.find("");
-                        if (it_subitem != subitems.end())
-                        {
-                            broadcastOneMsg(session, msg, it_subitem->second);
-                        }
-                    }
-                }
-                else
-                {
-                    broadcastOneMsg(session, msg, it_subitem->second);
-                }
-            }
-        }
-    }
-}
-
-bool CFdbBaseObject::updateEventCache(CFdbMessage *msg)
-{
-    if (mFlag & FDB_OBJ_ENABLE_EVENT_CACHE)
-    {
-        // update cached event data
-        auto &cached_event = mEventCache[msg->code()][msg->topic()];
-        auto updated = cached_event.setEventCache(msg->getPayloadBuffer(), msg->getPayloadSize());
-        if (!updated)
-        {
-            if (!cached_event.mAlwaysUpdate && !msg->isForceUpdate())
-            {
-                return false;
-            }
-        }
-    }
-    return true;
-}
-
-void CFdbBaseObject::broadcast(CFdbMessage *msg)
-{
-    if (updateEventCache(msg))
-    {
-        broadcast(mEventSubscribeTable, msg, msg->code());
-        broadcast(mGroupSubscribeTable, msg, fdbMakeGroup(msg->code()));
-    }
-}
-
-bool CFdbBaseObject::broadcast(SubscribeTable_t &subscribe_table, CFdbMessage *msg,
-                               CFdbSession *session, FdbMsgCode_t event)
-{
-    bool sent = false;
-    auto it_sessions = subscribe_table.find(event);
-    if (it_sessions != subscribe_table.end())
-    {
-        auto &sessions = it_sessions->second;
-        auto it_objects = sessions.find(session);
-        if (it_objects != sessions.end())
-        {
-            auto &objects = it_objects->second;
-            auto it_subitems = objects.find(msg->objectId());
-            if (it_subitems != objects.end())
-            {
-                auto filter = msg->topic().c_str();
-                auto &subitems = it_subitems->second;
-                auto it_subitem = subitems.find(filter);
-                if (it_subitem == subitems.end())
-                {
-                    /*
-                     * If filter doesn't match, check who registers filter "".
-                     * It represents any filter.
-                     */
-                    if (filter[0] != '\0')
-                    {
-                        auto it_subitem = subitems.find("");
-                        if (it_subitem != subitems.end())
-                        {
-                            broadcastOneMsg(session, msg, it_subitem->second);
-                            sent = true;
-                        }
-                    }
-                }
-                else
-                {
-                    broadcastOneMsg(session, msg, it_subitem->second);
-                    sent = true;
-                }
-            }
-        }
-    }
-    return sent;
-}
-
-bool CFdbBaseObject::broadcast(CFdbMessage *msg, CFdbSession *session)
-{
-    if (updateEventCache(msg))
-    {
-        if (!broadcast(mEventSubscribeTable, msg, session, msg->code()))
-        {
-            return broadcast(mGroupSubscribeTable, msg, session, fdbMakeGroup(msg->code()));
-        }
-    }
-    return false;
-}
-
-void CFdbBaseObject::getSubscribeTable(SessionTable_t &sessions, tFdbFilterSets &filter_tbl)
-{
-    for (auto it_objects = sessions.begin(); it_objects != sessions.end(); ++it_objects)
-    {
-        auto &objects = it_objects->second;
-        for (auto it_subitems = objects.begin(); it_subitems != objects.end(); ++it_subitems)
-        {
-            auto &subitems = it_subitems->second;
-            for (auto it_subitem = subitems.begin(); it_subitem != subitems.end(); ++it_subitem)
-            {
-                auto &subitem = it_subitem->second;
-                if (subitem.mType == FDB_SUB_TYPE_NORMAL)
-                {
-                    filter_tbl.insert(it_subitem->first);
-                }
-            }
-        }
-    }
-}
-
-void CFdbBaseObject::getSubscribeTable(SubscribeTable_t &subscribe_table,
-                                       tFdbSubscribeMsgTbl &table)
-{
-    for (auto it_sessions = subscribe_table.begin();
-            it_sessions != subscribe_table.end(); ++it_sessions)
-    {
-        auto &filter_table = table[it_sessions->first];
-        auto &sessions = it_sessions->second;
-        getSubscribeTable(sessions, filter_table);
-    }
-}
-
-void CFdbBaseObject::getSubscribeTable(tFdbSubscribeMsgTbl &table)
-{
-    getSubscribeTable(mEventSubscribeTable, table);
-    getSubscribeTable(mGroupSubscribeTable, table);
-}
-
-void CFdbBaseObject::getSubscribeTable(SubscribeTable_t &subscribe_table, FdbMsgCode_t code,
-                                       tFdbFilterSets &filters)
-{
-    auto it_sessions = subscribe_table.find(code);
-    if (it_sessions != subscribe_table.end())
-    {
-        auto &sessions = it_sessions->second;
-        getSubscribeTable(sessions, filters);
-    }
-}
-
-void CFdbBaseObject::getSubscribeTable(FdbMsgCode_t code, tFdbFilterSets &filters)
-{
-    getSubscribeTable(mEventSubscribeTable, code, filters);
-    getSubscribeTable(mGroupSubscribeTable, fdbMakeGroup(code), filters);
-}
-
-void CFdbBaseObject::getSubscribeTable(SubscribeTable_t &subscribe_table, FdbMsgCode_t code,
-                                       CFdbSession *session, tFdbFilterSets &filter_tbl)
-{
-    auto it_sessions = subscribe_table.find(code);
-    if (it_sessions != subscribe_table.end())
-    {
-        auto &sessions = it_sessions->second;
-        auto it_objects = sessions.find(session);
-        if (it_objects != sessions.end())
-        {
-            auto &objects = it_objects->second;
-            for (auto it_subitems = objects.begin();
-                    it_subitems != objects.end(); ++it_subitems)
-            {
-                auto &subitems = it_subitems->second;
-                for (auto it_subitem = subitems.begin(); it_subitem != subitems.end(); ++it_subitem)
-                {
-                    auto &subitem = it_subitem->second;
-                    if (subitem.mType == FDB_SUB_TYPE_NORMAL)
-                    {
-                        filter_tbl.insert(it_subitem->first);
-                    }
-                }
-            }
-        }
-    }
-}
-
-void CFdbBaseObject::getSubscribeTable(FdbMsgCode_t code, CFdbSession *session,
-                                        tFdbFilterSets &filter_tbl)
-{
-    getSubscribeTable(mEventSubscribeTable, code, session, filter_tbl);
-    getSubscribeTable(mGroupSubscribeTable, fdbMakeGroup(code), session, filter_tbl);
-}
-
-void CFdbBaseObject::getSubscribeTable(SubscribeTable_t &subscribe_table, FdbMsgCode_t code,
-                                       const char *filter, tSubscribedSessionSets &session_tbl)
-{
-    auto it_sessions = subscribe_table.find(code);
-    if (it_sessions != subscribe_table.end())
-    {
-        if (!filter)
-        {
-            filter = "";
-        }
-        auto &sessions = it_sessions->second;
-        for (auto it_objects = sessions.begin();
-                it_objects != sessions.end(); ++it_objects)
-        {
-            auto session = it_objects->first;
-            auto &objects = it_objects->second;
-            for (auto it_subitems = objects.begin();
-                    it_subitems != objects.end(); ++it_subitems)
-            {
-                auto &subitems = it_subitems->second;
-                auto it_subitem = subitems.find(filter);
-                if (it_subitem == subitems.end())
-                {
-                    /*
-                     * If filter doesn't match, check who registers filter "".
-                     * It represents any filter.
-                     */
-                    if (filter[0] != '\0')
-                    {
-                        auto it_subitem = subitems.find("");
-                        if (it_subitem != subitems.end())
-                        {
-                            auto &subitem = it_subitem->second;
-                            if (subitem.mType == FDB_SUB_TYPE_NORMAL)
-                            {
-                                session_tbl.insert(session);
-                                break;
-                            }
-                        }
-                    }
-                }
-                else
-                {
-                    auto &subitem = it_subitem->second;
-                    if (subitem.mType == FDB_SUB_TYPE_NORMAL)
-                    {
-                        session_tbl.insert(session);
-                        break;
-                    }
-                }
-            }
-        }
-    }
-}
-
-void CFdbBaseObject::getSubscribeTable(FdbMsgCode_t code, const char *filter,
-                                       tSubscribedSessionSets &session_tbl)
-{
-    getSubscribeTable(mEventSubscribeTable, code, filter, session_tbl);
-    getSubscribeTable(mGroupSubscribeTable, fdbMakeGroup(code), filter, session_tbl);
-}
-
-FdbObjectId_t CFdbBaseObject::addToEndpoint(CBaseEndpoint *endpoint, FdbObjectId_t obj_id)
-{
-    mEndpoint = endpoint;
-    mObjId = obj_id;
-    obj_id = endpoint->addObject(this);
-    if (fdbValidFdbId(obj_id))
-    {
-        LOG_I("CFdbBaseObject: Object %d is created.\n", obj_id);
-        registered(true);
-    }
-    return mObjId;
-}
-
-void CFdbBaseObject::removeFromEndpoint()
-{
-    if (mEndpoint)
-    {
-        mEndpoint->removeObject(this);
-        registered(false);
-        mEndpoint = 0;
-    }
-}
-
-FdbEndpointId_t CFdbBaseObject::epid() const
-{
-    return mEndpoint ? mEndpoint->epid() : FDB_INVALID_ID;
-}
-
-
-FdbObjectId_t CFdbBaseObject::doBind(CBaseEndpoint *endpoint, FdbObjectId_t obj_id)
-{
-    mRole = FDB_OBJECT_ROLE_SERVER;
-    return addToEndpoint(endpoint, obj_id);
-}
-
-FdbObjectId_t CFdbBaseObject::doConnect(CBaseEndpoint *endpoint, FdbObjectId_t obj_id)
-{
-    mRole = FDB_OBJECT_ROLE_CLIENT;
-    return addToEndpoint(endpoint, obj_id);
-}
-
-void CFdbBaseObject::doUnbind()
-{
-    removeFromEndpoint();
-}
-
-void CFdbBaseObject::doDisconnect()
-{
-    removeFromEndpoint();
-}
-
-//================================== Bind ==========================================
-class CBindObjectJob : public CMethodJob<CFdbBaseObject>
-{
-public:
-    CBindObjectJob(CFdbBaseObject *object, CBaseEndpoint *endpoint, FdbObjectId_t &oid)
-        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callBindObject, JOB_FORCE_RUN)
-        , mEndpoint(endpoint)
-        , mOid(oid)
-    {
-    }
-
-    CBaseEndpoint *mEndpoint;
-    FdbObjectId_t &mOid;
-};
-
-void CFdbBaseObject::callBindObject(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
-{
-    auto the_job = fdb_dynamic_cast_if_available<CBindObjectJob *>(job);
-    if (the_job)
-    {
-        the_job->mOid = doBind(the_job->mEndpoint, the_job->mOid);
-    }
-}
-
-FdbObjectId_t CFdbBaseObject::bind(CBaseEndpoint *endpoint, FdbObjectId_t oid)
-{
-    if (registered())
-    {
-        oid = mObjId;
-    }
-    else
-    {
-        CFdbContext::getInstance()->sendSyncEndeavor(new CBindObjectJob(this, endpoint, oid), 0, true);
-    }
-    return oid;
-}
-
-//================================== Connect ==========================================
-class CConnectObjectJob : public CMethodJob<CFdbBaseObject>
-{
-public:
-    CConnectObjectJob(CFdbBaseObject *object, CBaseEndpoint *endpoint, FdbObjectId_t &oid)
-        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callConnectObject, JOB_FORCE_RUN)
-        , mEndpoint(endpoint)
-        , mOid(oid)
-    {
-    }
-
-    CBaseEndpoint *mEndpoint;
-    FdbObjectId_t &mOid;
-};
-
-void CFdbBaseObject::callConnectObject(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
-{
-    auto the_job = fdb_dynamic_cast_if_available<CConnectObjectJob *>(job);
-    if (the_job)
-    {
-        the_job->mOid = doConnect(the_job->mEndpoint, the_job->mOid);
-    }
-}
-
-FdbObjectId_t CFdbBaseObject::connect(CBaseEndpoint *endpoint, FdbObjectId_t oid)
-{
-    if (registered())
-    {
-        oid = mObjId;
-    }
-    else
-    {
-        CFdbContext::getInstance()->sendSyncEndeavor(new CConnectObjectJob(this, endpoint, oid));
-    }
-    return oid;
-}
-
-//================================== Unbind ==========================================
-class CUnbindObjectJob : public CMethodJob<CFdbBaseObject>
-{
-public:
-    CUnbindObjectJob(CFdbBaseObject *object)
-        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callUnbindObject, JOB_FORCE_RUN)
-    {
-    }
-};
-
-void CFdbBaseObject::callUnbindObject(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
-{
-     doUnbind();
-}
-
-void CFdbBaseObject::unbind()
-{
-    if (registered())
-    {
-        CFdbContext::getInstance()->sendSyncEndeavor(new CUnbindObjectJob(this), 0, true);
-        // From now on, there will be no jobs migrated to worker thread. Applying a
-        // flush to worker thread to ensure no one refers to the object.
-    }
-}
-
-//================================== Disconnect ==========================================
-class CDisconnectObjectJob : public CMethodJob<CFdbBaseObject>
-{
-public:
-    CDisconnectObjectJob(CFdbBaseObject *object)
-        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callDisconnectObject, JOB_FORCE_RUN)
-    {
-    }
-};
-
-void CFdbBaseObject::callDisconnectObject(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
-{
-     doDisconnect();
-}
-
-void CFdbBaseObject::disconnect()
-{
-    if (registered())
-    {
-        unsubscribe();
-        CFdbContext::getInstance()->sendSyncEndeavor(new CDisconnectObjectJob(this), 0, true);
-        // From now on, there will be no jobs migrated to worker thread. Applying a
-        // flush to worker thread to ensure no one refers to the object.
-    }
-}
-
-bool CFdbBaseObject::broadcast(FdbSessionId_t sid
-                              , FdbObjectId_t obj_id
-                              , FdbMsgCode_t code
-                              , IFdbMsgBuilder &data
-                              , const char *filter)
-{
-    auto msg = new CFdbMessage(code, this, filter, sid, obj_id);
-    if (!msg->serialize(data, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->broadcast();
-}
-
-bool CFdbBaseObject::broadcast(FdbSessionId_t sid
-                      , FdbObjectId_t obj_id
-                      , FdbMsgCode_t code
-                      , const void *buffer
-                      , int32_t size
-                      , const char *filter
-                      , const char *log_data)
-{
-    auto msg = new CFdbMessage(code, this, filter, sid, obj_id);
-    msg->setLogData(log_data);
-    if (!msg->serialize(buffer, size, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->broadcast();
-}
-
-void CFdbBaseObject::initEventCache(FdbMsgCode_t event
-                                    , const char *topic
-                                    , IFdbMsgBuilder &data
-                                    , bool always_update)
-{
-    if (!topic)
-    {
-        topic = "";
-    }
-    auto &cached_event = mEventCache[event][topic];
-    cached_event.mAlwaysUpdate = always_update;
-    int32_t size = data.build();
-    if (size < 0)
-    {
-        return;
-    }
-    cached_event.setEventCache(0, size);
-    data.toBuffer(cached_event.mBuffer, size);
-}
-                
-void CFdbBaseObject::initEventCache(FdbMsgCode_t event
-                                    , const char *topic
-                                    , const void *buffer
-                                    , int32_t size
-                                    , bool always_update)
-{
-    if (!topic)
-    {
-        topic = "";
-    }
-    auto &cached_event = mEventCache[event][topic];
-    cached_event.mAlwaysUpdate = always_update;
-    cached_event.setEventCache((const uint8_t *)buffer, size);
-}
-
-bool CFdbBaseObject::invokeSideband(FdbMsgCode_t code
-                                  , IFdbMsgBuilder &data
-                                  , int32_t timeout)
-{
-    auto msg = new CBaseMessage(code, this, FDB_INVALID_ID);
-    if (!msg->serialize(data, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->invokeSideband(timeout);
-}
-
-bool CFdbBaseObject::invokeSideband(FdbMsgCode_t code
-                                  , const void *buffer
-                                  , int32_t size
-                                  , int32_t timeout)
-{
-    auto msg = new CBaseMessage(code, this, FDB_INVALID_ID);
-    if (!msg->serialize(buffer, size, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->invokeSideband(timeout);
-}
-
-bool CFdbBaseObject::sendSideband(FdbMsgCode_t code, IFdbMsgBuilder &data)
-{
-    auto msg = new CBaseMessage(code, this, FDB_INVALID_ID);
-    if (!msg->serialize(data, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->sendSideband();
-}
-
-bool CFdbBaseObject::sendSideband(FdbMsgCode_t code, const void *buffer, int32_t size)
-{
-    auto msg = new CBaseMessage(code, this, FDB_INVALID_ID);
-    if (!msg->serialize(buffer, size, this))
-    {
-        delete msg;
-        return false;
-    }
-    return msg->sendSideband();
-}
-
-CFdbBaseObject::CEventData::CEventData()
-    : mBuffer(0)
-    , mSize(0)
-    , mAlwaysUpdate(false)
-{
-}
-
-CFdbBaseObject::CEventData::~CEventData()
-{
-    if (mBuffer)
-    {
-        delete[] mBuffer;
-        mBuffer = 0;
-    }
-}
-
-bool CFdbBaseObject::CEventData::setEventCache(const uint8_t *buffer, int32_t size)
-{
-    if (size == mSize)
-    {
-        if (mBuffer)
-        {
-            if (buffer)
-            {
-                if (!memcmp(mBuffer, buffer, size))
-                {
-                    return false;
-                }
-            }
-        }
-        else if (size)
-        {
-            mBuffer = new uint8_t[size];
-        }
-    }
-    else
-    {
-        if (mBuffer)
-        {
-            delete[] mBuffer;
-            mBuffer = 0;
-        }
-
-        if (size)
-        {
-            mBuffer = new uint8_t[size];
-        }
-        mSize = size;
-    }
-
-    if (size && buffer)
-    {
-        memcpy(mBuffer, buffer, size);
-    }
-    return true;
-}
-
-void CFdbBaseObject::CEventData::replaceEventCache(uint8_t *buffer, int32_t size)
-{
-    if (mBuffer)
-    {
-        delete[] mBuffer;
-        mBuffer = 0;
-    }
-    mBuffer = buffer;
-    mSize = size;
-}
-
-void CFdbBaseObject::onSidebandInvoke(CBaseJob::Ptr &msg_ref)
-{
-    auto msg = castToMessage<CFdbMessage *>(msg_ref);
-    switch (msg->code())
-    {
-        case FDB_SIDEBAND_QUERY_EVT_CACHE:
-        {
-            NFdbBase::FdbMsgEventCache msg_cache;
-            for (auto it_events = mEventCache.begin(); it_events != mEventCache.end(); ++it_events)
-            {
-                auto event_code = it_events->first;
-                auto &events = it_events->second;
-                for (auto it_data = events.begin(); it_data != events.end(); ++it_data)
-                {
-                    auto &filter = it_data->first;
-                    auto &data = it_data->second;
-                    auto cache_item = msg_cache.add_cache();
-                    cache_item->set_event(event_code);
-                    cache_item->set_topic(filter.c_str());
-                    cache_item->set_size(data.mSize);
-                }
-            }
-            CFdbParcelableBuilder builder(msg_cache);
-            msg->replySideband(msg_ref, builder);
-        }
-        break;
-        default:
-        break;
-    }
-}
-
-void CFdbBaseObject::remoteCallback(CBaseJob::Ptr &msg_ref, long flag)
-{
-    switch (flag)
-    {
-        case FDB_CALLBACK_ON_BROADCAST:
-        {
-            onBroadcast(msg_ref);
-        }
-        break;
-        case FDB_CALLBACK_ON_GET_EVENT:
-        {
-            onGetEvent(msg_ref);
-        }
-        break;
-        case FDB_CALLBACK_ON_INVOKE:
-        {
-            onInvoke(msg_ref);
-            CFdbMessage::autoReply(msg_ref, NFdbBase::FDB_ST_AUTO_REPLY_OK, "Automatically reply to request.");
-        }
-        break;
-        case FDB_CALLBACK_ON_ONLINE:
-        {
-        }
-        break;
-        case FDB_CALLBACK_ON_OFFLINE:
-        {
-        }
-        break;
-        case FDB_CALLBACK_ON_REPLY:
-        {
-            onReply(msg_ref);
-        }
-        break;
-        case FDB_CALLBACK_ON_STATUS:
-        {
-            auto fdb_msg = castToMessage<CFdbMessage *>(msg_ref);
-            int32_t error_code;
-            std::string description;
-            if (!fdb_msg->decodeStatus(error_code, description))
-            {
-                return;
-            }
-            onStatus(msg_ref, error_code, description.c_str());
-        }
-        break;
-        case FDB_CALLBACK_ON_SUBSCRIBE:
-        {
-            onSubscribe(msg_ref);
-            CFdbMessage::autoReply(msg_ref, NFdbBase::FDB_ST_AUTO_REPLY_OK, "Automatically reply to subscribe request.");
-        }
-        break;
-        default:
-        break;
-    }
-}
-
-class CPrepareDestroyJob : public CMethodJob<CFdbBaseObject>
-{
-public:
-    CPrepareDestroyJob(CFdbBaseObject *object)
-        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callPrepareDestroy, JOB_FORCE_RUN)
-    {
-    }
-};
-
-void CFdbBaseObject::callPrepareDestroy(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
-{
-    enableMigrate(false);
-    autoRemove(false);
-}
-
-void CFdbBaseObject::prepareDestroy()
-{
-    /*
-     * Why not just call callPrepareDestroy()? Supposing the following case:
-     * CFdbContext is executing the following logic:
-     * 1. check if migration flag is set;
-     * 2. if set, migrate callback to worker thread.
-     * between 1 and 2, call callPrepareDestroy() followed by flush(). It might
-     * be possible that the job to flush is in front of the job for migration.
-     */
-    CFdbContext::getInstance()->sendSyncEndeavor(new CPrepareDestroyJob(this), 0, true);
-    if (mWorker)
-    {
-        // Make sure no pending remote callback is queued
-        mWorker->flush();
-    }
-}
-
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <common_base/CFdbBaseObject.h>
+#include <common_base/CBaseEndpoint.h>
+#include <common_base/CFdbMessage.h>
+#include <common_base/CBaseWorker.h>
+#include <common_base/CFdbSession.h>
+#include <common_base/CFdbContext.h>
+#include <common_base/CFdbSharedSubscription.h>
+#include <common_base/CFdbIfMessageHeader.h>
+#include <common_base/CFdbIfNameServer.h>
+#include <utils/Log.h>
+#include <string.h>
+#include <chrono>
+#include <utility>
+#include <atomic>
+
+// xxHash64 with seed 0
+#define FDB_XXH_PRIME1 11400714785074694791ULL
+#define FDB_XXH_PRIME2 14029467366897019727ULL
+#define FDB_XXH_PRIME3 1609587929392839161ULL
+#define FDB_XXH_PRIME4 9650029242287828579ULL
+#define FDB_XXH_PRIME5 2870177450012600261ULL
+
+static inline uint64_t fdbRotl64(uint64_t x, int32_t r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t fdbXxhRound(uint64_t acc, uint64_t input)
+{
+    acc += input * FDB_XXH_PRIME2;
+    return fdbRotl64(acc, 31) * FDB_XXH_PRIME1;
+}
+
+static inline uint64_t fdbXxhMerge(uint64_t acc, uint64_t val)
+{
+    acc ^= fdbXxhRound(0, val);
+    return acc * FDB_XXH_PRIME1 + FDB_XXH_PRIME4;
+}
+
+/*
+ * 32 bytes are consumed per iteration by four independent lanes, which
+ * keeps the hash far cheaper than memcmp() + memcpy() of large payloads.
+ */
+static uint64_t fdbHash64(const uint8_t *data, int32_t size)
+{
+    auto p = data;
+    auto end = data + size;
+    uint64_t hash;
+    if (size >= 32)
+    {
+        auto limit = end - 32;
+        uint64_t v1 = FDB_XXH_PRIME1 + FDB_XXH_PRIME2;
+        uint64_t v2 = FDB_XXH_PRIME2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - FDB_XXH_PRIME1;
+        do
+        {
+            v1 = fdbXxhRound(v1, fdbLoadScalar<uint64_t>(p));
+            v2 = fdbXxhRound(v2, fdbLoadScalar<uint64_t>(p + 8));
+            v3 = fdbXxhRound(v3, fdbLoadScalar<uint64_t>(p + 16));
+            v4 = fdbXxhRound(v4, fdbLoadScalar<uint64_t>(p + 24));
+            p += 32;
+        } while (p <= limit);
+        hash = fdbRotl64(v1, 1) + fdbRotl64(v2, 7) + fdbRotl64(v3, 12) + fdbRotl64(v4, 18);
+        hash = fdbXxhMerge(hash, v1);
+        hash = fdbXxhMerge(hash, v2);
+        hash = fdbXxhMerge(hash, v3);
+        hash = fdbXxhMerge(hash, v4);
+    }
+    else
+    {
+        hash = FDB_XXH_PRIME5;
+    }
+    hash += (uint64_t)size;
+
+    for (; (p + 8) <= end; p += 8)
+    {
+        hash ^= fdbXxhRound(0, fdbLoadScalar<uint64_t>(p));
+        hash = fdbRotl64(hash, 27) * FDB_XXH_PRIME1 + FDB_XXH_PRIME4;
+    }
+    if ((p + 4) <= end)
+    {
+        hash ^= (uint64_t)fdbLoadScalar<uint32_t>(p) * FDB_XXH_PRIME1;
+        hash = fdbRotl64(hash, 23) * FDB_XXH_PRIME2 + FDB_XXH_PRIME3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        hash ^= (uint64_t)*p * FDB_XXH_PRIME5;
+        hash = fdbRotl64(hash, 11) * FDB_XXH_PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= FDB_XXH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= FDB_XXH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/*
+ * Delta of cached event (all in little endian):
+ *     base version: u64
+ *     size of new payload: u32
+ *     runs of changed bytes, each of:
+ *         offset: u32
+ *         length: u32
+ *         bytes of new payload
+ * Runs closer than FDB_DELTA_MIN_GAP are merged since a run head costs
+ * about the same.
+ */
+#define FDB_DELTA_HEAD_SIZE 12
+#define FDB_DELTA_RUN_HEAD_SIZE 8
+#define FDB_DELTA_MIN_GAP FDB_DELTA_RUN_HEAD_SIZE
+
+static void fdbAddDeltaRun(std::vector<uint8_t> &delta, const uint8_t *data,
+                           uint32_t offset, uint32_t length)
+{
+    auto pos = delta.size();
+    delta.resize(pos + FDB_DELTA_RUN_HEAD_SIZE + length);
+    fdbStoreScalar<uint32_t>(&delta[pos], offset);
+    fdbStoreScalar<uint32_t>(&delta[pos + 4], length);
+    memcpy(&delta[pos + FDB_DELTA_RUN_HEAD_SIZE], data + offset, length);
+}
+
+// return false if the delta is not smaller than the new payload
+static bool fdbEncodeDelta(const uint8_t *base, int32_t base_size, uint64_t base_version,
+                           const uint8_t *data, int32_t size, std::vector<uint8_t> &delta)
+{
+    delta.resize(FDB_DELTA_HEAD_SIZE);
+    fdbStoreScalar<uint64_t>(&delta[0], base_version);
+    fdbStoreScalar<uint32_t>(&delta[8], (uint32_t)size);
+
+    uint32_t common = (uint32_t)((base_size < size) ? base_size : size);
+    uint32_t i = 0;
+    while (i < common)
+    {
+        if (base[i] == data[i])
+        {
+            ++i;
+            continue;
+        }
+        uint32_t start = i;
+        uint32_t end = i + 1; // one past the last changed byte
+        for (i = end; (i < common) && ((i - end) < FDB_DELTA_MIN_GAP); ++i)
+        {
+            if (base[i] != data[i])
+            {
+                end = i + 1;
+            }
+        }
+        if ((i >= common) && (common < (uint32_t)size) && ((common - end) < FDB_DELTA_MIN_GAP))
+        {
+            // merge with the appended bytes
+            end = (uint32_t)size;
+        }
+        fdbAddDeltaRun(delta, data, start, end - start);
+        if (delta.size() >= (size_t)size)
+        {
+            return false;
+        }
+        i = end;
+    }
+    if (i < (uint32_t)size)
+    {
+        fdbAddDeltaRun(delta, data, i, (uint32_t)size - i);
+    }
+    return delta.size() < (size_t)size;
+}
+
+// rebuild payload of @size (read from head of @delta) into @data
+static bool fdbDecodeDelta(const uint8_t *base, int32_t base_size, const uint8_t *delta,
+                           int32_t delta_size, uint8_t *data, uint32_t size)
+{
+    if ((uint32_t)base_size < size)
+    {
+        memcpy(data, base, base_size);
+        memset(data + base_size, 0, size - base_size);
+    }
+    else
+    {
+        memcpy(data, base, size);
+    }
+    int32_t pos = FDB_DELTA_HEAD_SIZE;
+    while (pos < delta_size)
+    {
+        if ((delta_size - pos) < FDB_DELTA_RUN_HEAD_SIZE)
+        {
+            return false;
+        }
+        auto offset = fdbLoadScalar<uint32_t>(delta + pos);
+        auto length = fdbLoadScalar<uint32_t>(delta + pos + 4);
+        pos += FDB_DELTA_RUN_HEAD_SIZE;
+        if ((offset > size) || (length > (size - offset)) || (length > (uint32_t)(delta_size - pos)))
+        {
+            return false;
+        }
+        memcpy(data + offset, delta + pos, length);
+        pos += length;
+    }
+    return true;
+}
+
+/*
+ * Event version: epoch of the run in the upper 24 bits and a counter
+ * in the rest. Versions of the same run are ordered; versions of
+ * different runs are never compared, since the clock of a restarted
+ * server might well be behind the one of the earlier run.
+ */
+#define FDB_EVENT_EPOCH_SHIFT 40
+#define fdbEventEpoch(_version) ((uint64_t)(_version) >> FDB_EVENT_EPOCH_SHIFT)
+
+static uint64_t fdbInitialEventVersion()
+{
+    // not a clock but a nonce: mixed from whatever differs between runs
+    static std::atomic<uint64_t> instance(0);
+    uint64_t seed[4];
+    seed[0] = (uint64_t)std::chrono::system_clock::now().time_since_epoch().count();
+    seed[1] = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+    seed[2] = (uint64_t)(uintptr_t)&seed;
+    seed[3] = instance++;
+    auto epoch = fdbEventEpoch(fdbHash64((const uint8_t *)seed, (int32_t)sizeof(seed)));
+    if (!epoch)
+    {
+        epoch = 1;
+    }
+    return epoch << FDB_EVENT_EPOCH_SHIFT;
+}
+
+// client holding @version of an event has nothing older than @cached
+static bool fdbEventUpToDate(uint64_t cached, uint64_t version)
+{
+    return (fdbEventEpoch(cached) == fdbEventEpoch(version)) && (cached <= version);
+}
+
+// bytes of event cache of all objects in the process
+static std::atomic<uint64_t> fdb_event_cache_bytes(0);
+static std::atomic<uint64_t> fdb_event_cache_max_bytes(0);
+
+/*
+ * Snapshot: cached events replayed to a subscriber in one message.
+ * Layout (little endian):
+ *     count: u32, reserved: u32
+ *     for each event:
+ *         code: i32, topic size: u32, version: u64,
+ *         payload size: u32, reserved: u32
+ *         topic without '\0', padded to 8 bytes
+ *         payload, padded to 8 bytes
+ * so payload of each event keeps the alignment of the snapshot payload.
+ */
+#define FDB_SNAPSHOT_HEAD_SIZE 8
+#define FDB_SNAPSHOT_ITEM_HEAD_SIZE 24
+#define FDB_SNAPSHOT_ALIGN(_size) (((_size) + 7) & ~7)
+
+class CFdbSnapshotBuilder : public IFdbMsgBuilder
+{
+public:
+    // @payload is referred until the snapshot is serialized
+    void add(FdbMsgCode_t code, const std::string &topic, uint64_t version,
+             const uint8_t *payload, int32_t size)
+    {
+        mItems.push_back(CItem());
+        auto &item = mItems.back();
+        item.mCode = code;
+        item.mTopic = topic;
+        item.mVersion = version;
+        item.mPayload = payload;
+        item.mSize = (payload && (size > 0)) ? (uint32_t)size : 0;
+    }
+
+    bool empty() const
+    {
+        return mItems.empty();
+    }
+
+    int32_t build()
+    {
+        int32_t size = FDB_SNAPSHOT_HEAD_SIZE;
+        for (auto it = mItems.begin(); it != mItems.end(); ++it)
+        {
+            size += FDB_SNAPSHOT_ITEM_HEAD_SIZE + FDB_SNAPSHOT_ALIGN(it->mTopic.size()) +
+                    FDB_SNAPSHOT_ALIGN(it->mSize);
+        }
+        return size;
+    }
+
+    bool toBuffer(uint8_t *buffer, int32_t size)
+    {
+        if (size < build())
+        {
+            return false;
+        }
+        memset(buffer, 0, size);
+        fdbStoreScalar<uint32_t>(buffer, (uint32_t)mItems.size());
+        auto p = buffer + FDB_SNAPSHOT_HEAD_SIZE;
+        for (auto it = mItems.begin(); it != mItems.end(); ++it)
+        {
+            fdbStoreScalar<int32_t>(p, (int32_t)it->mCode);
+            auto topic_size = (uint32_t)it->mTopic.size();
+            fdbStoreScalar<uint32_t>(p + 4, topic_size);
+            fdbStoreScalar<uint64_t>(p + 8, it->mVersion);
+            fdbStoreScalar<uint32_t>(p + 16, it->mSize);
+            p += FDB_SNAPSHOT_ITEM_HEAD_SIZE;
+            memcpy(p, it->mTopic.c_str(), topic_size);
+            p += FDB_SNAPSHOT_ALIGN(topic_size);
+            if (it->mSize)
+            {
+                memcpy(p, it->mPayload, it->mSize);
+            }
+            p += FDB_SNAPSHOT_ALIGN(it->mSize);
+        }
+        return true;
+    }
+
+private:
+    struct CItem
+    {
+        FdbMsgCode_t mCode;
+        // copied: topic might be a temporary of the caller
+        std::string mTopic;
+        uint64_t mVersion;
+        const uint8_t *mPayload;
+        uint32_t mSize;
+    };
+    std::vector<CItem> mItems;
+};
+
+enum EFdbCallback
+{
+    FDB_CALLBACK_ON_BROADCAST = 1,
+    FDB_CALLBACK_ON_GET_EVENT,
+    FDB_CALLBACK_ON_INVOKE,
+    FDB_CALLBACK_ON_ONLINE,
+    FDB_CALLBACK_ON_OFFLINE,
+    FDB_CALLBACK_ON_REPLY,
+    FDB_CALLBACK_ON_STATUS,
+    FDB_CALLBACK_ON_SUBSCRIBE,
+};
+
+CFdbBaseObject::CFdbBaseObject(const char *name, CBaseWorker *worker, EFdbEndpointRole role)
+    : mEndpoint(0)
+    , mWorker(worker)
+    , mObjId(FDB_INVALID_ID)
+    , mFlag(0)
+    , mRole(role)
+    , mSid(FDB_INVALID_ID)
+    , mEventVersion(fdbInitialEventVersion())
+    , mCacheMaxBytes(0)
+    , mCacheTtl(0)
+    , mCacheBytes(0)
+    , mCacheEvicted(0)
+    , mCacheExpired(0)
+    , mPropertyStore(0)
+    , mDeliveryTimer(0)
+    , mDeliveryDue(0)
+{
+    if (name)
+    {
+        mName = name;
+    }
+}
+
+class CLeaveSharedSubscriptionJob : public CMethodJob<CFdbBaseObject>
+{
+public:
+    CLeaveSharedSubscriptionJob(CFdbBaseObject *object)
+        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callLeaveSharedSubscription,
+                                     JOB_FORCE_RUN)
+    {
+    }
+};
+
+void CFdbBaseObject::callLeaveSharedSubscription(CBaseWorker *worker,
+                                                 CMethodJob<CFdbBaseObject> *job,
+                                                 CBaseJob::Ptr &ref)
+{
+    FDB_CONTEXT->getSharedSubscription()->remove(this);
+}
+
+CFdbBaseObject::~CFdbBaseObject()
+{
+    if (mFlag & FDB_OBJ_SHARED_SUBSCRIBED)
+    {
+        // neither offline nor prepareDestroy() yet: owner/follower must not dangle
+        CFdbContext::getInstance()->sendSyncEndeavor(new CLeaveSharedSubscriptionJob(this), 0, true);
+    }
+    if (mDeliveryTimer)
+    {
+        delete mDeliveryTimer;
+    }
+    clearEventCache();
+    disablePropertyStore();
+}
+
+bool CFdbBaseObject::invoke(FdbSessionId_t receiver
+                          , FdbMsgCode_t code
+                          , IFdbMsgBuilder &data
+                          , int32_t timeout)
+{
+    auto msg = new CBaseMessage(code, this, receiver);
+    if (!msg->serialize(data, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->invoke(timeout);
+}
+
+bool CFdbBaseObject::invoke(FdbSessionId_t receiver
+                            , CFdbMessage *msg
+                            , IFdbMsgBuilder &data
+                            , int32_t timeout)
+{
+    msg->setDestination(this, receiver);
+    if (!msg->serialize(data, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->invoke(timeout);
+}
+
+bool CFdbBaseObject::invoke(FdbMsgCode_t code
+                            , IFdbMsgBuilder &data
+                            , int32_t timeout)
+{
+    return invoke(FDB_INVALID_ID, code, data, timeout);
+}
+
+bool CFdbBaseObject::invoke(CFdbMessage *msg
+                            , IFdbMsgBuilder &data
+                            , int32_t timeout)
+{
+    return invoke(FDB_INVALID_ID, msg, data, timeout);
+}
+
+bool CFdbBaseObject::invoke(FdbSessionId_t receiver
+                            , CBaseJob::Ptr &msg_ref
+                            , IFdbMsgBuilder &data
+                            , int32_t timeout)
+{
+    auto msg = castToMessage<CFdbMessage *>(msg_ref);
+    msg->setDestination(this, receiver);
+    if (!msg->serialize(data, this))
+    {
+       return false;
+    }
+    return msg->invoke(msg_ref, timeout);
+}
+
+bool CFdbBaseObject::invoke(CBaseJob::Ptr &msg_ref
+                            , IFdbMsgBuilder &data
+                            , int32_t timeout)
+{
+    return invoke(FDB_INVALID_ID, msg_ref, data, timeout);
+}
+
+bool CFdbBaseObject::send(FdbSessionId_t receiver
+                          , FdbMsgCode_t code
+                          , IFdbMsgBuilder &data)
+{
+    auto msg = new CBaseMessage(code, this, receiver);
+    if (!msg->serialize(data, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->send();
+}
+
+bool CFdbBaseObject::send(FdbMsgCode_t code, IFdbMsgBuilder &data)
+{
+    return send(FDB_INVALID_ID, code, data);
+}
+
+bool CFdbBaseObject::send(FdbSessionId_t receiver
+                         , FdbMsgCode_t code
+                         , const void *buffer
+                         , int32_t size
+                         , const char *log_data)
+{
+    auto msg = new CBaseMessage(code, this, receiver);
+    msg->setLogData(log_data);
+    if (!msg->serialize(buffer, size, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->send();
+}
+
+bool CFdbBaseObject::send(FdbMsgCode_t code
+                         , const void *buffer
+                         , int32_t size
+                         , const char *log_data)
+{
+    return send(FDB_INVALID_ID, code, buffer, size, log_data);
+}
+
+bool CFdbBaseObject::get(FdbMsgCode_t code, const char *topic, int32_t timeout)
+{
+    auto msg = new CBaseMessage(code, this, FDB_INVALID_ID);
+    if (!msg->serialize(0, 0, this))
+    {
+        delete msg;
+        return false;
+    }
+    msg->topic(topic);
+    msg->setEventGet(true);
+    return msg->invoke(timeout);
+}
+
+bool CFdbBaseObject::get(CFdbMessage *msg, const char *topic, int32_t timeout)
+{
+    msg->setDestination(this, FDB_INVALID_ID);
+    if (!msg->serialize(0, 0, this))
+    {
+        delete msg;
+        return false;
+    }
+    msg->topic(topic);
+    msg->setEventGet(true);
+    return msg->invoke(timeout);
+}
+
+bool CFdbBaseObject::get(CBaseJob::Ptr &msg_ref, const char *topic, int32_t timeout)
+{
+    auto msg = castToMessage<CFdbMessage *>(msg_ref);
+    msg->setDestination(this, FDB_INVALID_ID);
+    if (!msg->serialize(0, 0, this))
+    {
+        return false;
+    }
+    msg->topic(topic);
+    msg->setEventGet(true);
+    return msg->invoke(msg_ref, timeout);
+}
+
+bool CFdbBaseObject::sendLog(FdbMsgCode_t code, IFdbMsgBuilder &data)
+{
+    auto msg = new CBaseMessage(code, this);
+    if (!msg->serialize(data))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->send();
+}
+
+bool CFdbBaseObject::sendLogNoQueue(FdbMsgCode_t code, IFdbMsgBuilder &data)
+{
+    CBaseMessage msg(code, this);
+    msg.expectReply(false);
+    if (!msg.serialize(data))
+    {
+        return false;
+    }
+    auto session = mEndpoint->preferredPeer();
+    if (session)
+    {
+        return session->sendMessage(&msg);
+    }
+    return false;
+}
+
+bool CFdbBaseObject::broadcast(FdbMsgCode_t code
+                               , IFdbMsgBuilder &data
+                               , const char *filter)
+{
+    auto msg = new CFdbMessage(code, this, filter);
+    if (!msg->serialize(data, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->broadcast();
+}
+
+bool CFdbBaseObject::broadcast(FdbMsgCode_t code
+                              , const void *buffer
+                              , int32_t size
+                              , const char *filter
+                              , const char *log_data)
+{
+    auto msg = new CFdbMessage(code, this, filter, FDB_INVALID_ID, FDB_INVALID_ID);
+    msg->setLogData(log_data);
+    if (!msg->serialize(buffer, size, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->broadcast();
+}
+
+void CFdbBaseObject::broadcastLogNoQueue(FdbMsgCode_t code, const uint8_t *data, int32_t size,
+                                         const char *filter)
+{
+    CFdbMessage msg(code, this, filter, FDB_INVALID_ID, FDB_INVALID_ID);
+    if (!msg.serialize(data, size, this))
+    {
+        return;
+    }
+    msg.enableLog(false);
+
+    broadcast(&msg);
+}
+
+void CFdbBaseObject::broadcastNoQueue(FdbMsgCode_t code, const uint8_t *data, int32_t size,
+                                      const char *filter, bool force_update)
+{
+    CFdbMessage msg(code, this, filter, FDB_INVALID_ID, FDB_INVALID_ID);
+    if (!msg.serialize(data, size, this))
+    {
+        return;
+    }
+    msg.forceUpdate(force_update);
+
+    broadcast(&msg);
+}
+
+bool CFdbBaseObject::unsubscribe(CFdbMsgSubscribeList &msg_list)
+{
+    auto msg = new CBaseMessage(FDB_INVALID_ID, this);
+    msg->type(FDB_MT_SUBSCRIBE_REQ);
+    CFdbParcelableBuilder builder(msg_list);
+    if (!msg->serialize(builder, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->unsubscribe();
+}
+
+bool CFdbBaseObject::unsubscribe()
+{
+    CFdbMsgSubscribeList msg_list;
+    return unsubscribe(msg_list);
+}
+
+bool CFdbBaseObject::migrateOnSubscribeToWorker(CBaseJob::Ptr &msg_ref, CBaseWorker *worker)
+{
+    if (!worker)
+    {
+        worker = mWorker;
+    }
+    if (worker)
+    {
+        if (enableMigrate())
+        {
+            auto msg = castToMessage<CBaseMessage *>(msg_ref);
+            msg->setRemoteCall(this, FDB_CALLBACK_ON_SUBSCRIBE);
+            if (!worker->sendAsync(msg_ref))
+            {
+                LOG_E("CFdbBaseObject: Unable to migrate onsubscribe to worker!\n");
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool CFdbBaseObject::migrateOnBroadcastToWorker(CBaseJob::Ptr &msg_ref, CBaseWorker *worker)
+{
+    if (!worker)
+    {
+        worker = mWorker;
+    }
+    if (worker)
+    {
+        if (enableMigrate())
+        {
+            auto msg = castToMessage<CBaseMessage *>(msg_ref);
+            msg->setRemoteCall(this, FDB_CALLBACK_ON_BROADCAST);
+            if (!worker->sendAsync(msg_ref))
+            {
+                LOG_E("CFdbBaseObject: Unable to migrate onbroadcast to worker!\n");
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool CFdbBaseObject::migrateOnInvokeToWorker(CBaseJob::Ptr &msg_ref, CBaseWorker *worker)
+{
+    if (!worker)
+    {
+        worker = mWorker;
+    }
+    if (worker)
+    {
+        if (enableMigrate())
+        {
+            auto msg = castToMessage<CBaseMessage *>(msg_ref);
+            msg->setRemoteCall(this, FDB_CALLBACK_ON_INVOKE);
+            if (!worker->sendAsync(msg_ref))
+            {
+                LOG_E("CFdbBaseObject: Unable to migrate oninvoke to worker!\n");
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+class COnOfflineJob : public CMethodJob<CFdbBaseObject>
+{
+public:
+    COnOfflineJob(CFdbBaseObject *object, FdbSessionId_t sid, bool is_last)
+        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callOnOffline, JOB_FORCE_RUN)
+        , mSid(sid)
+        , mIsLast(is_last)
+    {}
+
+    FdbSessionId_t mSid;
+    bool mIsLast;
+};
+
+void CFdbBaseObject::callOnOffline(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
+{
+    COnOfflineJob *the_job = fdb_dynamic_cast_if_available<COnOfflineJob *>(job);
+    if (the_job)
+    {
+        onOffline(the_job->mSid, the_job->mIsLast);
+        if (!isPrimary() && (mSid == the_job->mSid))
+        {
+            mSid = FDB_INVALID_ID;
+        }
+    }
+}
+
+bool CFdbBaseObject::migrateOnOfflineToWorker(FdbSessionId_t sid, bool is_last, CBaseWorker *worker)
+{
+    if (!worker)
+    {
+        worker = mWorker;
+    }
+    if (worker)
+    {
+        if (enableMigrate())
+        {
+            if (!worker->sendAsync(new COnOfflineJob(this, sid, is_last)))
+            {
+                LOG_E("CFdbBaseObject: Unable to migrate onoffline to worker!\n");
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+void CFdbBaseObject::notifyOffline(CFdbSession *session, bool is_last)
+{
+    if (mRole == FDB_OBJECT_ROLE_CLIENT)
+    {
+        // subscriptions are gone with the session
+        clearMirror();
+        FDB_CONTEXT->getSharedSubscription()->remove(this);
+    }
+    if (!migrateOnOfflineToWorker(session->sid(), is_last))
+    {
+        onOffline(session->sid(), is_last);
+        if (!isPrimary() && (mSid == session->sid()))
+        {
+            mSid = FDB_INVALID_ID;
+        }
+    }
+}
+
+class COnOnlineJob : public CMethodJob<CFdbBaseObject>
+{
+public:
+    COnOnlineJob(CFdbBaseObject *object, FdbSessionId_t sid, bool is_first)
+        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callOnOnline, JOB_FORCE_RUN)
+        , mSid(sid)
+        , mIsFirst(is_first)
+    {}
+
+    FdbSessionId_t mSid;
+    bool mIsFirst;
+};
+
+void CFdbBaseObject::callOnOnline(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
+{
+    auto the_job = fdb_dynamic_cast_if_available<COnOnlineJob *>(job);
+    if (the_job)
+    {
+        if (!isPrimary() && (mRole == FDB_OBJECT_ROLE_CLIENT) && !fdbValidFdbId(mSid))
+        {
+            mSid = the_job->mSid;
+        }
+        onOnline(the_job->mSid, the_job->mIsFirst);
+    }
+}
+
+bool CFdbBaseObject::migrateOnOnlineToWorker(FdbSessionId_t sid, bool is_first, CBaseWorker *worker)
+{
+    if (!worker)
+    {
+        worker = mWorker;
+    }
+    if (worker)
+    {
+        if (enableMigrate())
+        {
+            if (!worker->sendAsync(new COnOnlineJob(this, sid, is_first)))
+            {
+                LOG_E("CFdbBaseObject: Unable to migrate ononline to worker!\n");
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+void CFdbBaseObject::notifyOnline(CFdbSession *session, bool is_first)
+{
+    if (isPrimary() && (mRole == FDB_OBJECT_ROLE_CLIENT))
+    {
+        // send session info from client to primary object of server
+        NFdbBase::FdbSessionInfo sinfo;
+        sinfo.set_sender_name(mName.c_str());
+        CFdbParcelableBuilder builder(sinfo);
+        sendSideband(FDB_SIDEBAND_SESSION_INFO, builder);
+    }
+
+    if (!migrateOnOnlineToWorker(session->sid(), is_first))
+    {
+        if (!isPrimary() && (mRole == FDB_OBJECT_ROLE_CLIENT) && !fdbValidFdbId(mSid))
+        {
+            mSid = session->sid();
+        }
+        onOnline(session->sid(), is_first);
+    }
+}
+
+bool CFdbBaseObject::migrateOnReplyToWorker(CBaseJob::Ptr &msg_ref, CBaseWorker *worker)
+{
+    if (!worker)
+    {
+        worker = mWorker;
+    }
+    if (worker)
+    {
+        if (enableMigrate())
+        {
+            auto msg = castToMessage<CBaseMessage *>(msg_ref);
+            msg->setRemoteCall(this, FDB_CALLBACK_ON_REPLY);
+            if (!worker->sendAsync(msg_ref))
+            {
+                LOG_E("CFdbBaseObject: Unable to migrate onreply to worker!\n");
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool CFdbBaseObject::migrateGetEventToWorker(CBaseJob::Ptr &msg_ref, CBaseWorker *worker)
+{
+    if (!worker)
+    {
+        worker = mWorker;
+    }
+    if (worker)
+    {
+        if (enableMigrate())
+        {
+            auto msg = castToMessage<CBaseMessage *>(msg_ref);
+            msg->setRemoteCall(this, FDB_CALLBACK_ON_GET_EVENT);
+            if (!worker->sendAsync(msg_ref))
+            {
+                LOG_E("CFdbBaseObject: Unable to migrate onreply to worker!\n");
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool CFdbBaseObject::migrateOnStatusToWorker(CBaseJob::Ptr &msg_ref, CBaseWorker *worker)
+{
+    if (!worker)
+    {
+        worker = mWorker;
+    }
+    if (worker)
+    {
+        if (enableMigrate())
+        {
+            auto msg = castToMessage<CBaseMessage *>(msg_ref);
+            msg->setRemoteCall(this, FDB_CALLBACK_ON_STATUS);
+            if (!worker->sendAsync(msg_ref))
+            {
+                LOG_E("CFdbBaseObject: Unable to migrate onstatus to worker!\n");
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+const CFdbBaseObject::CEventData *CFdbBaseObject::getCachedEventData(FdbMsgCode_t msg_code,
+                                                                     const char *filter)
+{
+    auto it_events = mEventCache.find(msg_code);
+    if (it_events != mEventCache.end())
+    {
+        auto &events = it_events->second;
+        auto it_event = events.find(filter);
+        if (it_event != events.end())
+        {
+            auto &data = it_event->second;
+            touchEventCache(msg_code, it_event->first, data);
+            return &data;
+        }
+    }
+    return 0;
+}
+
+void CFdbBaseObject::broadcastCached(CBaseJob::Ptr &msg_ref)
+{
+    auto msg = castToMessage<CFdbMessage *>(msg_ref);
+    auto session = FDB_CONTEXT->getSession(msg->session());
+    if (!session)
+    {
+        return;
+    }
+    // expired events are not replayed
+    trimEventCache();
+    CFdbSnapshotBuilder snapshot;
+    const CFdbMsgSubscribeItem *sub_item;
+    /* iterate all message id subscribed */
+    FDB_BEGIN_FOREACH_SIGNAL(msg, sub_item)
+    {
+        FdbMsgCode_t msg_code = sub_item->msg_code();
+        const char *filter = "";
+        if (sub_item->has_filter())
+        {
+            filter = sub_item->filter().c_str();
+        }
+        if (sub_item->pattern())
+        {
+            // broadcast current value of all topics matching the pattern
+            auto it_events = mEventCache.find(msg_code);
+            if (it_events == mEventCache.end())
+            {
+                continue;
+            }
+            auto &events = it_events->second;
+            for (auto it_event = events.begin(); it_event != events.end(); ++it_event)
+            {
+                auto &topic = it_event->first;
+                if (!CFdbSubscribeIndex::matchTopic(filter, topic.c_str()))
+                {
+                    continue;
+                }
+                auto &cached_data = it_event->second;
+                if (sub_item->has_version() && fdbEventUpToDate(cached_data.mVersion, sub_item->version()))
+                {
+                    continue;
+                }
+                if (sub_item->snapshot() && snapshotEvent(snapshot, session, msg, msg_code, topic, cached_data))
+                {
+                    continue;
+                }
+                CFdbMessage broadcast_msg(msg_code, msg, topic.c_str());
+                if (cached_data.toMessage(&broadcast_msg, this))
+                {
+                    broadcast_msg.forceUpdate(true);
+                    broadcast_msg.eventVersion(cached_data.mVersion);
+                    broadcast(&broadcast_msg, session);
+                }
+            }
+            continue;
+        }
+        auto cached_data = getCachedEventData(msg_code, filter);
+        // skip replay if client already has the latest
+        if (cached_data && (!sub_item->has_version() ||
+                            !fdbEventUpToDate(cached_data->mVersion, sub_item->version())))
+        {
+            if (sub_item->snapshot() && snapshotEvent(snapshot, session, msg, msg_code, filter, *cached_data))
+            {
+                continue;
+            }
+            CFdbMessage broadcast_msg(msg_code, msg, filter);
+            if (cached_data->toMessage(&broadcast_msg, this))
+            {
+                broadcast_msg.forceUpdate(true);
+                broadcast_msg.eventVersion(cached_data->mVersion);
+                broadcast(&broadcast_msg, session);
+            }
+        }
+    }
+    FDB_END_FOREACH_SIGNAL()
+
+    if (!snapshot.empty())
+    {
+        CFdbMessage snapshot_msg(FDB_CODE_SNAPSHOT, msg, 0);
+        if (snapshot_msg.serialize(snapshot, this))
+        {
+            snapshot_msg.mFlag |= MSG_FLAG_SNAPSHOT;
+            snapshot_msg.forceUpdate(true);
+            session->sendMessage(&snapshot_msg);
+        }
+    }
+}
+
+bool CFdbBaseObject::snapshotEvent(CFdbSnapshotBuilder &snapshot,
+                                   CFdbSession *session,
+                                   CFdbMessage *msg,
+                                   FdbMsgCode_t code,
+                                   const std::string &topic,
+                                   const CEventData &data)
+{
+    auto subscribe_table = &mEventSubscribeTable;
+    auto target = subscribe_table->findTarget(code, session, msg->objectId(), topic.c_str(),
+                                              data.mBuffer, data.mSize);
+    if (!target)
+    {
+        subscribe_table = &mGroupSubscribeTable;
+        target = subscribe_table->findTarget(fdbMakeGroup(code), session, msg->objectId(),
+                                             topic.c_str(), data.mBuffer, data.mSize);
+        if (!target)
+        {
+            return true;
+        }
+    }
+    if (!msg->manualUpdate())
+    {
+        if (target->mType != FDB_SUB_TYPE_NORMAL)
+        {
+            return true;
+        }
+        // per-event delivery state is kept by deliver(): send alone
+        if (target->mDelivery && (target->mDelivery->mPolicy != FDB_DELIVER_FULL))
+        {
+            return false;
+        }
+    }
+    snapshot.add(code, topic, data.mVersion, data.mBuffer, data.mSize);
+    markDeltaBase(*subscribe_table, *target, code, topic, data.mVersion);
+    return true;
+}
+
+/*
+ * At client: dispatch events in snapshot one by one as if they are
+ * received separately. Payload of each event refers to the snapshot.
+ */
+void CFdbBaseObject::unpackSnapshot(CBaseJob::Ptr &msg_ref)
+{
+    auto msg = castToMessage<CFdbMessage *>(msg_ref);
+    auto payload = msg->getPayloadBuffer();
+    int32_t size = msg->getPayloadSize();
+    if (!payload || (size < FDB_SNAPSHOT_HEAD_SIZE))
+    {
+        LOG_E("CFdbBaseObject: snapshot of size %d is invalid!\n", size);
+        return;
+    }
+    auto offset = msg->getPayloadOffset();
+    auto buffer = msg->shareBuffer();
+    auto count = fdbLoadScalar<uint32_t>(payload);
+    int32_t pos = FDB_SNAPSHOT_HEAD_SIZE;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if ((size - pos) < FDB_SNAPSHOT_ITEM_HEAD_SIZE)
+        {
+            break;
+        }
+        auto item = payload + pos;
+        auto code = fdbLoadScalar<int32_t>(item);
+        auto topic_size = fdbLoadScalar<uint32_t>(item + 4);
+        auto version = fdbLoadScalar<uint64_t>(item + 8);
+        auto payload_size = fdbLoadScalar<uint32_t>(item + 16);
+        pos += FDB_SNAPSHOT_ITEM_HEAD_SIZE;
+        if (topic_size > (uint32_t)(size - pos))
+        {
+            break;
+        }
+        std::string topic((const char *)payload + pos, topic_size);
+        pos += FDB_SNAPSHOT_ALIGN(topic_size);
+        if ((pos > size) || (payload_size > (uint32_t)(size - pos)))
+        {
+            break;
+        }
+
+        auto event = new CFdbMessage(code, this, topic.c_str(), msg->session(), msg->objectId());
+        event->mFlag |= msg->mFlag & MSG_GLOBAL_FLAG_MASK & ~MSG_FLAG_SNAPSHOT;
+        event->sharePayload(buffer, offset + pos, (int32_t)payload_size);
+        event->eventVersion(version);
+        CBaseJob::Ptr event_ref(event);
+        doBroadcast(event_ref);
+        pos += FDB_SNAPSHOT_ALIGN(payload_size);
+    }
+}
+
+void CFdbBaseObject::doSubscribe(CBaseJob::Ptr &msg_ref)
+{
+    if (mFlag & FDB_OBJ_ENABLE_EVENT_CACHE)
+    {
+        /* broadcast current value of event/filter pair */
+        broadcastCached(msg_ref);
+        CFdbMessage::autoReply(msg_ref, NFdbBase::FDB_ST_AUTO_REPLY_OK, "Automatically reply to subscribe request.");
+        return;
+    }
+
+    if (!migrateOnSubscribeToWorker(msg_ref))
+    {
+        onSubscribe(msg_ref);
+        CFdbMessage::autoReply(msg_ref, NFdbBase::FDB_ST_AUTO_REPLY_OK, "Automatically reply to subscribe request.");
+    }
+}
+
+void CFdbBaseObject::doBroadcast(CBaseJob::Ptr &msg_ref)
+{
+    if (castToMessage<CFdbMessage *>(msg_ref)->mFlag & MSG_FLAG_SNAPSHOT)
+    {
+        unpackSnapshot(msg_ref);
+        return;
+    }
+    if ((mFlag & (FDB_OBJ_ENABLE_EVENT_DELTA | FDB_OBJ_ENABLE_EVENT_MIRROR)) &&
+        !applyDelta(castToMessage<CFdbMessage *>(msg_ref)))
+    {
+        return;
+    }
+    if (mFlag & FDB_OBJ_SHARE_SUBSCRIPTION)
+    {
+        FDB_CONTEXT->getSharedSubscription()->forward(this, msg_ref);
+    }
+    if (!migrateOnBroadcastToWorker(msg_ref))
+    {
+        onBroadcast(msg_ref);
+    }
+}
+
+// event received by another object sharing subscription
+void CFdbBaseObject::doSharedBroadcast(CBaseJob::Ptr &msg_ref)
+{
+    if (mFlag & (FDB_OBJ_ENABLE_EVENT_DELTA | FDB_OBJ_ENABLE_EVENT_MIRROR))
+    {
+        // keep the value as delta base or mirror
+        applyDelta(castToMessage<CFdbMessage *>(msg_ref));
+    }
+    if (!migrateOnBroadcastToWorker(msg_ref))
+    {
+        onBroadcast(msg_ref);
+    }
+}
+
+void CFdbBaseObject::doInvoke(CBaseJob::Ptr &msg_ref)
+{
+    if (mFlag & FDB_OBJ_ENABLE_EVENT_CACHE)
+    {
+        /* reply current value for 'get' request */
+        auto msg = castToMessage<CBaseMessage *>(msg_ref);
+        if (msg->isEventGet())
+        {
+            if (!msg->expectReply())
+            {
+                msg->status(msg_ref, NFdbBase::FDB_ST_BAD_PARAMETER, "Intend to get event but reply is not expected!");
+                return;
+            }
+            /*
+             * We come here because client intends to retrieve current value of event/topic pair.
+             * It acts as a 'get' command.
+             */
+            auto cached_data = getCachedEventData(msg->code(), msg->topic().c_str());
+            if (cached_data)
+            {
+                msg->replyNoQueue(msg_ref, cached_data->mBuffer, cached_data->mSize);
+            }
+            else
+            {
+                msg->statusf(msg_ref, NFdbBase::FDB_ST_NON_EXIST, "Event %d topic %s doesn't exists!",
+                             msg->code(), msg->topic().c_str());
+            }
+            return;
+        }
+    }
+
+    if (!migrateOnInvokeToWorker(msg_ref))
+    {
+        onInvoke(msg_ref);
+        CFdbMessage::autoReply(msg_ref, NFdbBase::FDB_ST_AUTO_REPLY_OK, "Automatically reply to request.");
+    }
+}
+
+void CFdbBaseObject::doReply(CBaseJob::Ptr &msg_ref)
+{
+    if (!migrateOnReplyToWorker(msg_ref))
+    {
+        onReply(msg_ref);
+    }
+}
+
+void CFdbBaseObject::doGetEvent(CBaseJob::Ptr &msg_ref)
+{
+    if (!migrateGetEventToWorker(msg_ref))
+    {
+        onGetEvent(msg_ref);
+    }
+}
+
+void CFdbBaseObject::doStatus(CBaseJob::Ptr &msg_ref)
+{
+    if (!migrateOnStatusToWorker(msg_ref))
+    {
+        auto fdb_msg = castToMessage<CFdbMessage *>(msg_ref);
+        int32_t error_code;
+        std::string description;
+        if (!fdb_msg->decodeStatus(error_code, description))
+        {
+            return;
+        }
+
+        onStatus(msg_ref, error_code, description.c_str());
+    }
+}
+
+bool CFdbBaseObject::invoke(FdbSessionId_t receiver
+                           , FdbMsgCode_t code
+                           , const void *buffer
+                           , int32_t size
+                           , int32_t timeout
+                           , const char *log_data)
+{
+    auto msg = new CBaseMessage(code, this, receiver);
+    msg->setLogData(log_data);
+    if (!msg->serialize(buffer, size, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->invoke(timeout);
+}
+
+bool CFdbBaseObject::invoke(FdbMsgCode_t code
+                           , const void *buffer
+                           , int32_t size
+                           , int32_t timeout
+                           , const char *log_data)
+{
+    return invoke(FDB_INVALID_ID, code, buffer, size, timeout, log_data);
+}
+
+
+bool CFdbBaseObject::invoke(FdbSessionId_t receiver
+                           , CFdbMessage *msg
+                           , const void *buffer
+                           , int32_t size
+                           , int32_t timeout)
+{
+    msg->setDestination(this, receiver);
+    if (!msg->serialize(buffer, size, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->invoke(timeout);
+}
+
+bool CFdbBaseObject::invoke(CFdbMessage *msg
+                           , const void *buffer
+                           , int32_t size
+                           , int32_t timeout)
+{
+    return invoke(FDB_INVALID_ID, msg, buffer, size, timeout);
+}
+
+bool CFdbBaseObject::invoke(FdbSessionId_t receiver
+                           , CBaseJob::Ptr &msg_ref
+                           , const void *buffer
+                           , int32_t size
+                           , int32_t timeout)
+{
+    auto msg = castToMessage<CFdbMessage *>(msg_ref);
+    msg->setDestination(this, receiver);
+    if (!msg->serialize(buffer, size, this))
+    {
+       return false;
+    }
+    return msg->invoke(msg_ref, timeout);
+}
+
+bool CFdbBaseObject::invoke(CBaseJob::Ptr &msg_ref
+                           , const void *buffer
+                           , int32_t size
+                           , int32_t timeout)
+{
+    return invoke(FDB_INVALID_ID, msg_ref, buffer, size, timeout);
+}
+
+bool CFdbBaseObject::subscribe(CFdbMsgSubscribeList &msg_list
+                              , int32_t timeout)
+{
+    prepareSubscribe(msg_list);
+    auto msg = new CBaseMessage(FDB_INVALID_ID, this);
+    msg->type(FDB_MT_SUBSCRIBE_REQ);
+    CFdbParcelableBuilder builder(msg_list);
+    if (!msg->serialize(builder, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->subscribe(timeout);
+}
+
+bool CFdbBaseObject::subscribe(CFdbMsgSubscribeList &msg_list
+                              , CFdbMessage *msg
+                              , int32_t timeout)
+{
+    prepareSubscribe(msg_list);
+    msg->type(FDB_MT_SUBSCRIBE_REQ);
+    msg->setDestination(this);
+    CFdbParcelableBuilder builder(msg_list);
+    if (!msg->serialize(builder, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->subscribe(timeout);
+}
+
+bool CFdbBaseObject::subscribeSync(CFdbMsgSubscribeList &msg_list
+                              , int32_t timeout)
+{
+    prepareSubscribe(msg_list);
+    auto msg = new CBaseMessage(FDB_INVALID_ID, this);
+    msg->type(FDB_MT_SUBSCRIBE_REQ);
+    msg->setDestination(this);
+    CFdbParcelableBuilder builder(msg_list);
+    if (!msg->serialize(builder, this))
+    {
+        delete msg;
+        return false;
+    }
+    CBaseJob::Ptr msg_ref(msg);
+    if (!msg->subscribe(msg_ref, timeout))
+    {
+        return false;
+    }
+    if (msg->isError())
+    {
+        return false;
+    }
+    if (worker())
+    {
+        worker()->flush();
+    }
+
+    return true;
+}
+
+bool CFdbBaseObject::update(CFdbMsgTriggerList &msg_list
+                            , int32_t timeout)
+{
+    auto msg = new CBaseMessage(FDB_INVALID_ID, this);
+    msg->type(FDB_MT_SUBSCRIBE_REQ);
+    CFdbParcelableBuilder builder(msg_list);
+    if (!msg->serialize(builder, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->update(timeout);
+}
+
+bool CFdbBaseObject::update(CFdbMsgTriggerList &msg_list
+                            , CFdbMessage *msg
+                            , int32_t timeout)
+{
+    msg->type(FDB_MT_SUBSCRIBE_REQ);
+    msg->setDestination(this);
+    CFdbParcelableBuilder builder(msg_list);
+    if (!msg->serialize(builder, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->update(timeout);
+}
+
+bool CFdbBaseObject::updateSync(CFdbMsgTriggerList &msg_list
+                                , int32_t timeout)
+{
+    auto msg = new CBaseMessage(FDB_INVALID_ID, this);
+    msg->type(FDB_MT_SUBSCRIBE_REQ);
+    msg->setDestination(this);
+    CFdbParcelableBuilder builder(msg_list);
+    if (!msg->serialize(builder, this))
+    {
+        delete msg;
+        return false;
+    }
+    CBaseJob::Ptr msg_ref(msg);
+    if (!msg->update(msg_ref, timeout))
+    {
+        return false;
+    }
+    if (msg->isError())
+    {
+        return false;
+    }
+    if (worker())
+    {
+        worker()->flush();
+    }
+
+    return true;
+}
+
+void CFdbBaseObject::addNotifyItem(CFdbMsgSubscribeList &msg_list
+                                  , FdbMsgCode_t msg_code
+                                  , const char *filter)
+{
+    auto item = msg_list.add_subscribe_tbl();
+    item->set_msg_code(msg_code);
+    if (filter)
+    {
+        item->set_filter(filter);
+    }
+}
+
+void CFdbBaseObject::addNotifyItem(CFdbMsgSubscribeList &msg_list
+                                  , FdbMsgCode_t msg_code
+                                  , const char *filter
+                                  , const CFdbContentFilter &content)
+{
+    auto item = msg_list.add_subscribe_tbl();
+    item->set_msg_code(msg_code);
+    if (filter)
+    {
+        item->set_filter(filter);
+    }
+    item->set_content_filter(content);
+}
+
+void CFdbBaseObject::addNotifyItem(CFdbMsgSubscribeList &msg_list
+                                  , FdbMsgCode_t msg_code
+                                  , const char *filter
+                                  , CFdbDeliveryPolicy policy
+                                  , uint32_t interval)
+{
+    auto item = msg_list.add_subscribe_tbl();
+    item->set_msg_code(msg_code);
+    if (filter)
+    {
+        item->set_filter(filter);
+    }
+    item->set_policy(policy, interval);
+}
+
+void CFdbBaseObject::addNotifyItem(CFdbMsgSubscribeList &msg_list
+                                  , FdbMsgCode_t msg_code
+                                  , const char *filter
+                                  , uint64_t version)
+{
+    auto item = msg_list.add_subscribe_tbl();
+    item->set_msg_code(msg_code);
+    if (filter)
+    {
+        item->set_filter(filter);
+    }
+    item->set_version(version);
+}
+
+void CFdbBaseObject::addNotifyGroup(CFdbMsgSubscribeList &msg_list
+                                    , FdbEventGroup_t event_group
+                                    , const char *filter)
+{
+    addNotifyItem(msg_list, fdbmakeEventGroup(event_group), filter);
+}
+
+void CFdbBaseObject::addNotifyPattern(CFdbMsgSubscribeList &msg_list
+                                     , FdbMsgCode_t msg_code
+                                     , const char *pattern)
+{
+    auto item = msg_list.add_subscribe_tbl();
+    item->set_msg_code(msg_code);
+    item->set_filter(pattern ? pattern : "");
+    item->set_pattern(true);
+}
+
+void CFdbBaseObject::addUpdateItem(CFdbMsgSubscribeList &msg_list
+                                  , FdbMsgCode_t msg_code
+                                  , const char *filter)
+{
+    auto item = msg_list.add_subscribe_tbl();
+    item->set_msg_code(msg_code);
+    if (filter)
+    {
+        item->set_filter(filter);
+    }
+    item->set_type(FDB_SUB_TYPE_ON_REQUEST);
+}
+
+void CFdbBaseObject::addUpdateGroup(CFdbMsgSubscribeList &msg_list
+                                    , FdbEventGroup_t event_group
+                                    , const char *filter)
+{
+    addUpdateItem(msg_list, fdbmakeEventGroup(event_group), filter);
+}
+
+void CFdbBaseObject::addTriggerItem(CFdbMsgTriggerList &msg_list
+                                     , FdbMsgCode_t msg_code
+                                     , const char *filter)
+{
+    addNotifyItem(msg_list, msg_code, filter);
+}
+
+ void CFdbBaseObject::addTriggerGroup(CFdbMsgTriggerList &msg_list
+                                      , FdbEventGroup_t event_group
+                                      , const char *filter)
+{
+    addNotifyGroup(msg_list, event_group, filter);
+}
+
+void CFdbBaseObject::subscribe(CFdbSession *session,
+                               FdbMsgCode_t msg,
+                               FdbObjectId_t obj_id,
+                               const char *filter,
+                               CFdbSubscribeType type,
+                               bool pattern,
+                               const CFdbContentFilter *content,
+                               CFdbDeliveryPolicy policy,
+                               uint32_t interval,
+                               bool delta)
+{
+    SubscribeTable_t &subscribe_table = fdbIsGroup(msg) ? mGroupSubscribeTable : mEventSubscribeTable;
+    subscribe_table.subscribe(msg, session, obj_id, filter, type, pattern, content, policy, interval,
+                              delta);
+}
+
+void CFdbBaseObject::unsubscribe(CFdbSession *session,
+                                 FdbMsgCode_t msg,
+                                 FdbObjectId_t obj_id,
+                                 const char *filter,
+                                 bool pattern)
+{
+    SubscribeTable_t &subscribe_table = fdbIsGroup(msg) ? mGroupSubscribeTable : mEventSubscribeTable;
+    subscribe_table.unsubscribe(msg, session, obj_id, filter, pattern);
+}
+
+void CFdbBaseObject::unsubscribe(CFdbSession *session)
+{
+    mEventSubscribeTable.unsubscribe(session);
+    mGroupSubscribeTable.unsubscribe(session);
+}
+
+void CFdbBaseObject::unsubscribe(FdbObjectId_t obj_id)
+{
+    mEventSubscribeTable.unsubscribe(obj_id);
+    mGroupSubscribeTable.unsubscribe(obj_id);
+}
+
+void CFdbBaseObject::broadcastOneMsg(SubscribeTable_t &subscribe_table,
+                                     CFdbSession *session,
+                                     CFdbMessage *msg,
+                                     CFdbSubscribeIndex::CTarget &target,
+                                     CPayloadHash &hash)
+{
+    if (msg->manualUpdate())
+    {
+        // explicitly requested: always send at once and in full
+        session->sendMessage(msg);
+        markDeltaBase(subscribe_table, target, msg->code(), msg->topic(), msg->eventVersion());
+    }
+    else if (target.mType == FDB_SUB_TYPE_NORMAL)
+    {
+        if (target.mDelivery)
+        {
+            deliver(subscribe_table, session, msg, target, hash);
+        }
+        else
+        {
+            session->sendMessage(msg);
+        }
+    }
+}
+
+// full payload of @version is sent to @target: base of the next delta
+void CFdbBaseObject::markDeltaBase(SubscribeTable_t &subscribe_table,
+                                   CFdbSubscribeIndex::CTarget &target, FdbMsgCode_t code,
+                                   const std::string &topic, uint64_t version)
+{
+    if (target.mDelivery && target.mDelivery->mDelta)
+    {
+        subscribe_table.deliveryState(target, code, topic).mVersion = version;
+    }
+}
+
+void CFdbBaseObject::deliver(SubscribeTable_t &subscribe_table,
+                             CFdbSession *session,
+                             CFdbMessage *msg,
+                             CFdbSubscribeIndex::CTarget &target,
+                             CPayloadHash &hash)
+{
+    auto delivery = target.mDelivery;
+    auto code = msg->code();
+    auto &state = subscribe_table.deliveryState(target, code, msg->topic());
+    auto payload = msg->getPayloadBuffer();
+    auto size = msg->getPayloadSize();
+
+    if (delivery->mPolicy == FDB_DELIVER_ON_CHANGE)
+    {
+        if (!hash.mValid)
+        {
+            hash.mValue = fdbHash64(payload, size);
+            hash.mValid = true;
+        }
+        if (state.mSent && (state.mHash == hash.mValue) && !msg->isForceUpdate())
+        {
+            return;
+        }
+        state.mSent = true;
+        state.mHash = hash.mValue;
+        sendEvent(session, msg, target, state);
+        return;
+    }
+    if (delivery->mPolicy == FDB_DELIVER_FULL)
+    {
+        // delta only
+        sendEvent(session, msg, target, state);
+        return;
+    }
+
+    // FDB_DELIVER_CONFLATE
+    auto now = sysdep_getsystemtime_milli();
+    if (!state.mPending && (!state.mSent || ((now - state.mLastSent) >= delivery->mInterval)))
+    {
+        state.mSent = true;
+        state.mLastSent = now;
+        sendEvent(session, msg, target, state);
+        return;
+    }
+    // keep the latest only; sent when the interval expires
+    state.mPayload.assign(payload, payload + size);
+    state.mPendingVersion = msg->eventVersion();
+    if (!state.mPending)
+    {
+        state.mPending = true;
+        subscribe_table.schedule(target);
+        scheduleDelivery(now, state.mLastSent + delivery->mInterval);
+    }
+}
+
+bool CFdbBaseObject::flushDelivery(CFdbSubscribeIndex::CTarget &target, uint64_t now,
+                                   uint64_t &next_due)
+{
+    auto delivery = target.mDelivery;
+    if (!delivery)
+    {
+        return false;
+    }
+
+    /*
+     * Sending might reenter and update or clear the states: collect keys
+     * of the states before sending and look each up again. Keys are only
+     * compared, never dereferenced.
+     */
+    std::vector<CFdbSubscribeIndex::CStateKey> due_keys;
+    bool pending = false;
+    for (auto it = delivery->mStates.begin(); it != delivery->mStates.end(); ++it)
+    {
+        auto &state = it->second;
+        if (!state.mPending)
+        {
+            continue;
+        }
+        auto due = state.mLastSent + delivery->mInterval;
+        if (due > now)
+        {
+            pending = true;
+            if (!next_due || (due < next_due))
+            {
+                next_due = due;
+            }
+            continue;
+        }
+        due_keys.push_back(it->first);
+    }
+
+    for (auto it = due_keys.begin(); it != due_keys.end(); ++it)
+    {
+        if (target.mDead || (target.mDelivery != delivery))
+        {
+            break;
+        }
+        auto it_state = delivery->mStates.find(*it);
+        if ((it_state == delivery->mStates.end()) || !it_state->second.mPending)
+        {
+            continue;
+        }
+        auto &state = it_state->second;
+        state.mPending = false;
+        state.mLastSent = now;
+        CFdbMessage msg(state.mCode, this, state.mTopic->c_str(), FDB_INVALID_ID, FDB_INVALID_ID);
+        if (msg.serialize(state.mPayload.data(), (int32_t)state.mPayload.size(), this))
+        {
+            msg.updateObjectId(target.objectId());
+            // sent in full: the payload is a copy rather than the cached one
+            msg.eventVersion(state.mPendingVersion);
+            target.session()->sendMessage(&msg);
+            if (target.mDelivery != delivery)
+            {
+                break;
+            }
+            // sending might reenter and drop the state
+            it_state = delivery->mStates.find(*it);
+            if (it_state != delivery->mStates.end())
+            {
+                it_state->second.mVersion = it_state->second.mPendingVersion;
+            }
+        }
+    }
+    return pending;
+}
+
+void CFdbBaseObject::sendEvent(CFdbSession *session,
+                               CFdbMessage *msg,
+                               CFdbSubscribeIndex::CTarget &target,
+                               CFdbSubscribeIndex::CDeliveryState &state)
+{
+    auto version = msg->eventVersion();
+    if (!target.mDelivery->mDelta || !(mFlag & FDB_OBJ_ENABLE_EVENT_DELTA) ||
+        !version || !state.mVersion || !sendDelta(session, msg, state.mVersion))
+    {
+        session->sendMessage(msg);
+    }
+    state.mVersion = version;
+}
+
+bool CFdbBaseObject::sendDelta(CFdbSession *session, CFdbMessage *msg, uint64_t base_version)
+{
+    auto it_events = mEventCache.find(msg->code());
+    if (it_events == mEventCache.end())
+    {
+        return false;
+    }
+    auto it_event = it_events->second.find(msg->topic());
+    if (it_event == it_events->second.end())
+    {
+        return false;
+    }
+    // only the change from the previous value to the current one is known
+    auto &cached_event = it_event->second;
+    if ((cached_event.mVersion != msg->eventVersion()) || (cached_event.mPrevVersion != base_version))
+    {
+        return false;
+    }
+    if (cached_event.mDeltaVersion != cached_event.mVersion)
+    {
+        // built once and shared by all subscribers
+        cached_event.mDeltaVersion = cached_event.mVersion;
+        if (!fdbEncodeDelta(cached_event.mPrevBuffer, cached_event.mPrevSize, base_version,
+                            cached_event.mBuffer, cached_event.mSize, cached_event.mDelta))
+        {
+            cached_event.mDelta.clear();
+        }
+        chargeEventCache(cached_event);
+    }
+    if (cached_event.mDelta.empty())
+    {
+        return false;
+    }
+
+    CFdbMessage delta_msg(msg->code(), this, msg->topic().c_str(), FDB_INVALID_ID, FDB_INVALID_ID);
+    if (!delta_msg.serialize(cached_event.mDelta.data(), (int32_t)cached_event.mDelta.size(), this))
+    {
+        return false;
+    }
+    delta_msg.updateObjectId(msg->objectId());
+    delta_msg.eventVersion(cached_event.mVersion);
+    delta_msg.mFlag |= MSG_FLAG_DELTA;
+    return session->sendMessage(&delta_msg);
+}
+
+/*
+ * At client: rebuild full payload of delta and keep the value received
+ * as base of the next delta. Return false if the message should be
+ * dropped.
+ */
+bool CFdbBaseObject::applyDelta(CFdbMessage *msg)
+{
+    auto version = msg->eventVersion();
+    if (!version)
+    {
+        return true;
+    }
+    auto &events = mDeltaBase[msg->code()];
+    auto it_base = events.find(msg->topic());
+    if (!(msg->mFlag & MSG_FLAG_DELTA))
+    {
+        if (it_base == events.end())
+        {
+            it_base = events.insert(std::make_pair(msg->topic(), CEventData())).first;
+        }
+        it_base->second.setEventCache(msg->getPayloadBuffer(), msg->getPayloadSize());
+        it_base->second.mVersion = version;
+        return true;
+    }
+
+    auto delta = msg->getPayloadBuffer();
+    auto delta_size = msg->getPayloadSize();
+    bool applied = false;
+    if ((it_base != events.end()) && it_base->second.mVersion && (delta_size >= FDB_DELTA_HEAD_SIZE) &&
+        (fdbLoadScalar<uint64_t>(delta) == it_base->second.mVersion))
+    {
+        auto &base = it_base->second;
+        auto size = fdbLoadScalar<uint32_t>(delta + 8);
+        auto buffer = new uint8_t[CFdbMessage::maxReservedSize() + size];
+        auto payload = buffer + CFdbMessage::maxReservedSize();
+        if (fdbDecodeDelta(base.mBuffer, base.mSize, delta, delta_size, payload, size))
+        {
+            msg->replaceBuffer(buffer, (int32_t)size, CFdbMessage::mMaxHeadSize, 0);
+            msg->mFlag &= ~MSG_FLAG_DELTA;
+            base.setEventCache(payload, (int32_t)size);
+            base.mVersion = version;
+            applied = true;
+        }
+        else
+        {
+            delete[] buffer;
+        }
+    }
+    if (applied)
+    {
+        return true;
+    }
+
+    // version 0 means full payload is already requested
+    if ((it_base == events.end()) || it_base->second.mVersion)
+    {
+        LOG_W("CFdbBaseObject: delta of event %d, topic %s is dropped for version mismatch.\n",
+              msg->code(), msg->topic().c_str());
+        events[msg->topic()].mVersion = 0;
+        CFdbMsgTriggerList trigger_list;
+        addTriggerItem(trigger_list, msg->code(), msg->topic().c_str());
+        update(trigger_list);
+    }
+    return false;
+}
+
+void CFdbBaseObject::prepareSubscribe(CFdbMsgSubscribeList &msg_list)
+{
+    bool delta = !!(mFlag & FDB_OBJ_ENABLE_EVENT_DELTA);
+    auto &items = msg_list.subscribe_tbl();
+    for (auto it = items.vpool().begin(); it != items.vpool().end(); ++it)
+    {
+        // snapshot is always unpacked by doBroadcast()
+        it->set_snapshot(true);
+        if (delta)
+        {
+            it->set_delta(true);
+        }
+    }
+}
+
+/*
+ * At client: record from subscribe/unsubscribe request which events are
+ * completely received so that the last value can reply get().
+ */
+void CFdbBaseObject::updateMirrorRules(CFdbMessage *msg)
+{
+    if (msg->code() == FDB_CODE_UPDATE)
+    {
+        return;
+    }
+    bool subscribe = msg->code() == FDB_CODE_SUBSCRIBE;
+    bool empty = true;
+    const CFdbMsgSubscribeItem *sub_item;
+    FDB_BEGIN_FOREACH_SIGNAL(msg, sub_item)
+    {
+        empty = false;
+        auto code = sub_item->msg_code();
+        const char *topic = sub_item->has_filter() ? sub_item->filter().c_str() : "";
+        auto &rules = mMirrorRules[code];
+        auto it_rule = rules.find(topic);
+        if (subscribe)
+        {
+            bool complete = !sub_item->has_content_filter() &&
+                    (!sub_item->has_type() || (sub_item->type() == FDB_SUB_TYPE_NORMAL)) &&
+                    (sub_item->policy() != FDB_DELIVER_CONFLATE);
+            if ((it_rule != rules.end()) && it_rule->second.mComplete && complete)
+            {
+                continue;
+            }
+            auto &rule = rules[topic];
+            rule.mPattern = sub_item->pattern();
+            rule.mComplete = complete;
+        }
+        else
+        {
+            if (it_rule != rules.end())
+            {
+                rules.erase(it_rule);
+            }
+            if (rules.empty())
+            {
+                mMirrorRules.erase(code);
+            }
+        }
+    }
+    FDB_END_FOREACH_SIGNAL()
+
+    if (!subscribe && empty)
+    {
+        // unsubscribe all
+        mMirrorRules.clear();
+    }
+}
+
+/*
+ * At client: drop the last values of events in subscribe/unsubscribe
+ * request. Once unsubscribed they are no longer updated; when
+ * subscribed again they might be out of date: wait for the next.
+ */
+void CFdbBaseObject::pruneDeltaBase(CFdbMessage *msg)
+{
+    if ((msg->code() == FDB_CODE_UPDATE) || mDeltaBase.empty())
+    {
+        return;
+    }
+    bool empty = true;
+    const CFdbMsgSubscribeItem *sub_item;
+    FDB_BEGIN_FOREACH_SIGNAL(msg, sub_item)
+    {
+        empty = false;
+        auto it_events = mDeltaBase.find(sub_item->msg_code());
+        if (it_events == mDeltaBase.end())
+        {
+            continue;
+        }
+        const char *topic = sub_item->has_filter() ? sub_item->filter().c_str() : "";
+        if (!topic[0] || sub_item->pattern())
+        {
+            mDeltaBase.erase(it_events);
+        }
+        else
+        {
+            it_events->second.erase(topic);
+            if (it_events->second.empty())
+            {
+                mDeltaBase.erase(it_events);
+            }
+        }
+    }
+    FDB_END_FOREACH_SIGNAL()
+
+    if ((msg->code() == FDB_CODE_UNSUBSCRIBE) && empty)
+    {
+        // unsubscribe all
+        mDeltaBase.clear();
+    }
+}
+
+// same order as server matches subscription: topic, pattern and then ""
+bool CFdbBaseObject::isMirrored(FdbMsgCode_t code, const char *topic) const
+{
+    auto it_rules = mMirrorRules.find(code);
+    if (it_rules == mMirrorRules.end())
+    {
+        return false;
+    }
+    auto &rules = it_rules->second;
+    auto it_rule = rules.find(topic);
+    if ((it_rule != rules.end()) && !it_rule->second.mPattern)
+    {
+        return it_rule->second.mComplete;
+    }
+    for (it_rule = rules.begin(); it_rule != rules.end(); ++it_rule)
+    {
+        if (it_rule->second.mPattern && CFdbSubscribeIndex::matchTopic(it_rule->first.c_str(), topic))
+        {
+            return it_rule->second.mComplete;
+        }
+    }
+    if (topic[0] != '\0')
+    {
+        it_rule = rules.find("");
+        if ((it_rule != rules.end()) && !it_rule->second.mPattern)
+        {
+            return it_rule->second.mComplete;
+        }
+    }
+    return false;
+}
+
+/*
+ * At client: check get/subscribe request on context thread before it is
+ * sent. Return true if it is completed locally.
+ */
+bool CFdbBaseObject::doLocalRequest(CBaseJob::Ptr &msg_ref, CFdbSession *session)
+{
+    auto msg = castToMessage<CFdbMessage *>(msg_ref);
+    if (msg->type() != FDB_MT_SUBSCRIBE_REQ)
+    {
+        return msg->isEventGet() && replyMirroredEvent(msg_ref);
+    }
+    if (mFlag & FDB_OBJ_ENABLE_EVENT_MIRROR)
+    {
+        updateMirrorRules(msg);
+    }
+    // checked anyway in case delta or mirror is disabled afterwards
+    pruneDeltaBase(msg);
+    // unsubscribe is checked anyway in case sharing is disabled afterwards
+    if (msg->code() == FDB_CODE_UNSUBSCRIBE)
+    {
+        FDB_CONTEXT->getSharedSubscription()->onUnsubscribe(this, msg);
+    }
+    else if ((mFlag & FDB_OBJ_SHARE_SUBSCRIPTION) &&
+             !FDB_CONTEXT->getSharedSubscription()->onSubscribe(this, session, msg))
+    {
+        // every item is shared: nothing is sent; reply as server would
+        if (!(msg->mFlag & MSG_FLAG_NOREPLY_EXPECTED))
+        {
+            msg->setErrorMsg(FDB_MT_UNKNOWN, NFdbBase::FDB_ST_AUTO_REPLY_OK,
+                             "Subscription is shared.");
+            // synchronous caller is woken up by worker once the job returns
+            if (!msg->sync())
+            {
+                doStatus(msg_ref);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+/*
+ * At client: reply get() request with the last value received. Return
+ * false if it should be sent to server.
+ */
+bool CFdbBaseObject::replyMirroredEvent(CBaseJob::Ptr &msg_ref)
+{
+    auto msg = castToMessage<CFdbMessage *>(msg_ref);
+    if (!(mFlag & FDB_OBJ_ENABLE_EVENT_MIRROR) || !isMirrored(msg->code(), msg->topic().c_str()))
+    {
+        return false;
+    }
+    auto it_events = mDeltaBase.find(msg->code());
+    if (it_events == mDeltaBase.end())
+    {
+        return false;
+    }
+    auto it_event = it_events->second.find(msg->topic());
+    // version 0 means full payload is being requested again
+    if ((it_event == it_events->second.end()) || !it_event->second.mVersion)
+    {
+        return false;
+    }
+    auto &data = it_event->second;
+    auto buffer = new uint8_t[CFdbMessage::maxReservedSize() + data.mSize];
+    if (data.mSize)
+    {
+        memcpy(buffer + CFdbMessage::maxReservedSize(), data.mBuffer, data.mSize);
+    }
+    msg->replaceBuffer(buffer, data.mSize, CFdbMessage::mMaxHeadSize, 0);
+    msg->mType = FDB_MT_REPLY;
+    msg->mFlag |= MSG_FLAG_REPLIED;
+    msg->eventVersion(data.mVersion);
+    // synchronous caller is woken up by worker once the job returns
+    if (!msg->sync())
+    {
+        doGetEvent(msg_ref);
+    }
+    return true;
+}
+
+void CFdbBaseObject::clearMirror()
+{
+    mMirrorRules.clear();
+    // delta against value from another session is meaningless as well
+    mDeltaBase.clear();
+}
+
+void CFdbBaseObject::scheduleDelivery(uint64_t now, uint64_t due)
+{
+    if (mDeliveryDue && (mDeliveryDue <= due))
+    {
+        return;
+    }
+    if (!mDeliveryTimer)
+    {
+        mDeliveryTimer = new CDeliveryTimer(this);
+        mDeliveryTimer->attach(FDB_CONTEXT, false);
+    }
+    mDeliveryDue = due;
+    // interval of 0 is ignored by the timer
+    mDeliveryTimer->enableOneShot((due > now) ? (int32_t)(due - now) : 1);
+}
+
+void CFdbBaseObject::onDeliveryTimer(CMethodLoopTimer<CFdbBaseObject> *timer)
+{
+    mDeliveryDue = 0;
+    auto now = sysdep_getsystemtime_milli();
+    uint64_t next_due = 0;
+    auto flush = [this, now, &next_due](CFdbSubscribeIndex::CTarget &target)
+        {
+            return flushDelivery(target, now, next_due);
+        };
+    mEventSubscribeTable.flush(flush);
+    mGroupSubscribeTable.flush(flush);
+    if (next_due)
+    {
+        scheduleDelivery(now, next_due);
+    }
+}
+
+void CFdbBaseObject::broadcast(SubscribeTable_t &subscribe_table,
+                               CFdbMessage *msg, FdbMsgCode_t event, CPayloadHash &hash)
+{
+    // only subscribers of the topic and accepting the payload are visited
+    subscribe_table.forEachMatch(event, msg->topic().c_str(),
+        msg->getPayloadBuffer(), msg->getPayloadSize(),
+        [this, msg, &subscribe_table, &hash](CFdbSubscribeIndex::CTarget &target)
+        {
+            msg->updateObjectId(target.objectId()); // send to the specific object.
+            broadcastOneMsg(subscribe_table, target.session(), msg, target, hash);
+        });
+}
+
+bool CFdbBaseObject::updateEventCache(CFdbMessage *msg, CPayloadHash &hash)
+{
+    if (mFlag & FDB_OBJ_ENABLE_EVENT_CACHE)
+    {
+        // update cached event data
+        auto &events = mEventCache[msg->code()];
+        auto it_event = events.find(msg->topic());
+        if (it_event == events.end())
+        {
+            it_event = events.insert(std::make_pair(msg->topic(), CEventData())).first;
+        }
+        auto &cached_event = it_event->second;
+        // the message and the cache share the same payload buffer
+        auto updated = cached_event.shareEventCache(msg, !!(mFlag & FDB_OBJ_ENABLE_EVENT_HASH),
+                                                    !!(mFlag & FDB_OBJ_ENABLE_EVENT_DELTA));
+        touchEventCache(msg->code(), it_event->first, cached_event);
+        if (cached_event.mHashValid)
+        {
+            // the cache holds the same payload: reuse its hash for delivery
+            hash.mValue = cached_event.mHash;
+            hash.mValid = true;
+        }
+        if (updated)
+        {
+            cached_event.mVersion = ++mEventVersion;
+            storeEventCache(msg->code(), it_event->first, cached_event);
+            trimEventCache(&cached_event);
+        }
+        else if (!cached_event.mAlwaysUpdate && !msg->isForceUpdate())
+        {
+            return false;
+        }
+        msg->eventVersion(cached_event.mVersion);
+    }
+    return true;
+}
+
+void CFdbBaseObject::broadcast(CFdbMessage *msg)
+{
+    CPayloadHash hash;
+    if (updateEventCache(msg, hash))
+    {
+        broadcast(mEventSubscribeTable, msg, msg->code(), hash);
+        broadcast(mGroupSubscribeTable, msg, fdbMakeGroup(msg->code()), hash);
+    }
+}
+
+bool CFdbBaseObject::broadcast(SubscribeTable_t &subscribe_table, CFdbMessage *msg,
+                               CFdbSession *session, FdbMsgCode_t event, CPayloadHash &hash)
+{
+    auto target = subscribe_table.findTarget(event, session, msg->objectId(), msg->topic().c_str(),
+                                             msg->getPayloadBuffer(), msg->getPayloadSize());
+    if (target)
+    {
+        broadcastOneMsg(subscribe_table, session, msg, *target, hash);
+        return true;
+    }
+    return false;
+}
+
+bool CFdbBaseObject::broadcast(CFdbMessage *msg, CFdbSession *session)
+{
+    CPayloadHash hash;
+    if (updateEventCache(msg, hash))
+    {
+        if (!broadcast(mEventSubscribeTable, msg, session, msg->code(), hash))
+        {
+            return broadcast(mGroupSubscribeTable, msg, session, fdbMakeGroup(msg->code()), hash);
+        }
+    }
+    return false;
+}
+
+void CFdbBaseObject::getSubscribeTable(SubscribeTable_t &subscribe_table,
+                                       tFdbSubscribeMsgTbl &table)
+{
+    subscribe_table.forEachTarget([&table](FdbMsgCode_t code, CFdbSubscribeIndex::CTarget &target)
+        {
+            auto &filter_table = table[code];
+            if (target.mType == FDB_SUB_TYPE_NORMAL)
+            {
+                filter_table.insert(target.topic());
+            }
+        });
+}
+
+void CFdbBaseObject::getSubscribeTable(tFdbSubscribeMsgTbl &table)
+{
+    getSubscribeTable(mEventSubscribeTable, table);
+    getSubscribeTable(mGroupSubscribeTable, table);
+}
+
+void CFdbBaseObject::getSubscribeTable(SubscribeTable_t &subscribe_table, FdbMsgCode_t code,
+                                       tFdbFilterSets &filters)
+{
+    getSubscribeTable(subscribe_table, code, 0, filters);
+}
+
+void CFdbBaseObject::getSubscribeTable(FdbMsgCode_t code, tFdbFilterSets &filters)
+{
+    getSubscribeTable(mEventSubscribeTable, code, filters);
+    getSubscribeTable(mGroupSubscribeTable, fdbMakeGroup(code), filters);
+}
+
+void CFdbBaseObject::getSubscribeTable(SubscribeTable_t &subscribe_table, FdbMsgCode_t code,
+                                       CFdbSession *session, tFdbFilterSets &filter_tbl)
+{
+    subscribe_table.forEachTarget(code, session,
+        [&filter_tbl](FdbMsgCode_t, CFdbSubscribeIndex::CTarget &target)
+        {
+            if (target.mType == FDB_SUB_TYPE_NORMAL)
+            {
+                filter_tbl.insert(target.topic());
+            }
+        });
+}
+
+void CFdbBaseObject::getSubscribeTable(FdbMsgCode_t code, CFdbSession *session,
+                                        tFdbFilterSets &filter_tbl)
+{
+    getSubscribeTable(mEventSubscribeTable, code, session, filter_tbl);
+    getSubscribeTable(mGroupSubscribeTable, fdbMakeGroup(code), session, filter_tbl);
+}
+
+void CFdbBaseObject::getSubscribeTable(SubscribeTable_t &subscribe_table, FdbMsgCode_t code,
+                                       const char *filter, tSubscribedSessionSets &session_tbl)
+{
+    subscribe_table.forEachMatch(code, filter, [&session_tbl](CFdbSubscribeIndex::CTarget &target)
+        {
+            if (target.mType == FDB_SUB_TYPE_NORMAL)
+            {
+                session_tbl.insert(target.session());
+            }
+        });
+}
+
+void CFdbBaseObject::getSubscribeTable(FdbMsgCode_t code, const char *filter,
+                                       tSubscribedSessionSets &session_tbl)
+{
+    getSubscribeTable(mEventSubscribeTable, code, filter, session_tbl);
+    getSubscribeTable(mGroupSubscribeTable, fdbMakeGroup(code), filter, session_tbl);
+}
+
+FdbObjectId_t CFdbBaseObject::addToEndpoint(CBaseEndpoint *endpoint, FdbObjectId_t obj_id)
+{
+    mEndpoint = endpoint;
+    mObjId = obj_id;
+    obj_id = endpoint->addObject(this);
+    if (fdbValidFdbId(obj_id))
+    {
+        LOG_I("CFdbBaseObject: Object %d is created.\n", obj_id);
+        registered(true);
+    }
+    return mObjId;
+}
+
+void CFdbBaseObject::removeFromEndpoint()
+{
+    if (mEndpoint)
+    {
+        mEndpoint->removeObject(this);
+        registered(false);
+        mEndpoint = 0;
+    }
+}
+
+FdbEndpointId_t CFdbBaseObject::epid() const
+{
+    return mEndpoint ? mEndpoint->epid() : FDB_INVALID_ID;
+}
+
+
+FdbObjectId_t CFdbBaseObject::doBind(CBaseEndpoint *endpoint, FdbObjectId_t obj_id)
+{
+    mRole = FDB_OBJECT_ROLE_SERVER;
+    return addToEndpoint(endpoint, obj_id);
+}
+
+FdbObjectId_t CFdbBaseObject::doConnect(CBaseEndpoint *endpoint, FdbObjectId_t obj_id)
+{
+    mRole = FDB_OBJECT_ROLE_CLIENT;
+    return addToEndpoint(endpoint, obj_id);
+}
+
+void CFdbBaseObject::doUnbind()
+{
+    removeFromEndpoint();
+}
+
+void CFdbBaseObject::doDisconnect()
+{
+    removeFromEndpoint();
+}
+
+//================================== Bind ==========================================
+class CBindObjectJob : public CMethodJob<CFdbBaseObject>
+{
+public:
+    CBindObjectJob(CFdbBaseObject *object, CBaseEndpoint *endpoint, FdbObjectId_t &oid)
+        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callBindObject, JOB_FORCE_RUN)
+        , mEndpoint(endpoint)
+        , mOid(oid)
+    {
+    }
+
+    CBaseEndpoint *mEndpoint;
+    FdbObjectId_t &mOid;
+};
+
+void CFdbBaseObject::callBindObject(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
+{
+    auto the_job = fdb_dynamic_cast_if_available<CBindObjectJob *>(job);
+    if (the_job)
+    {
+        the_job->mOid = doBind(the_job->mEndpoint, the_job->mOid);
+    }
+}
+
+FdbObjectId_t CFdbBaseObject::bind(CBaseEndpoint *endpoint, FdbObjectId_t oid)
+{
+    if (registered())
+    {
+        oid = mObjId;
+    }
+    else
+    {
+        CFdbContext::getInstance()->sendSyncEndeavor(new CBindObjectJob(this, endpoint, oid), 0, true);
+    }
+    return oid;
+}
+
+//================================== Connect ==========================================
+class CConnectObjectJob : public CMethodJob<CFdbBaseObject>
+{
+public:
+    CConnectObjectJob(CFdbBaseObject *object, CBaseEndpoint *endpoint, FdbObjectId_t &oid)
+        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callConnectObject, JOB_FORCE_RUN)
+        , mEndpoint(endpoint)
+        , mOid(oid)
+    {
+    }
+
+    CBaseEndpoint *mEndpoint;
+    FdbObjectId_t &mOid;
+};
+
+void CFdbBaseObject::callConnectObject(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
+{
+    auto the_job = fdb_dynamic_cast_if_available<CConnectObjectJob *>(job);
+    if (the_job)
+    {
+        the_job->mOid = doConnect(the_job->mEndpoint, the_job->mOid);
+    }
+}
+
+FdbObjectId_t CFdbBaseObject::connect(CBaseEndpoint *endpoint, FdbObjectId_t oid)
+{
+    if (registered())
+    {
+        oid = mObjId;
+    }
+    else
+    {
+        CFdbContext::getInstance()->sendSyncEndeavor(new CConnectObjectJob(this, endpoint, oid));
+    }
+    return oid;
+}
+
+//================================== Unbind ==========================================
+class CUnbindObjectJob : public CMethodJob<CFdbBaseObject>
+{
+public:
+    CUnbindObjectJob(CFdbBaseObject *object)
+        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callUnbindObject, JOB_FORCE_RUN)
+    {
+    }
+};
+
+void CFdbBaseObject::callUnbindObject(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
+{
+     doUnbind();
+}
+
+void CFdbBaseObject::unbind()
+{
+    if (registered())
+    {
+        CFdbContext::getInstance()->sendSyncEndeavor(new CUnbindObjectJob(this), 0, true);
+        // From now on, there will be no jobs migrated to worker thread. Applying a
+        // flush to worker thread to ensure no one refers to the object.
+    }
+}
+
+//================================== Disconnect ==========================================
+class CDisconnectObjectJob : public CMethodJob<CFdbBaseObject>
+{
+public:
+    CDisconnectObjectJob(CFdbBaseObject *object)
+        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callDisconnectObject, JOB_FORCE_RUN)
+    {
+    }
+};
+
+void CFdbBaseObject::callDisconnectObject(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
+{
+     doDisconnect();
+}
+
+void CFdbBaseObject::disconnect()
+{
+    if (registered())
+    {
+        unsubscribe();
+        CFdbContext::getInstance()->sendSyncEndeavor(new CDisconnectObjectJob(this), 0, true);
+        // From now on, there will be no jobs migrated to worker thread. Applying a
+        // flush to worker thread to ensure no one refers to the object.
+    }
+}
+
+bool CFdbBaseObject::broadcast(FdbSessionId_t sid
+                              , FdbObjectId_t obj_id
+                              , FdbMsgCode_t code
+                              , IFdbMsgBuilder &data
+                              , const char *filter)
+{
+    auto msg = new CFdbMessage(code, this, filter, sid, obj_id);
+    if (!msg->serialize(data, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->broadcast();
+}
+
+bool CFdbBaseObject::broadcast(FdbSessionId_t sid
+                      , FdbObjectId_t obj_id
+                      , FdbMsgCode_t code
+                      , const void *buffer
+                      , int32_t size
+                      , const char *filter
+                      , const char *log_data)
+{
+    auto msg = new CFdbMessage(code, this, filter, sid, obj_id);
+    msg->setLogData(log_data);
+    if (!msg->serialize(buffer, size, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->broadcast();
+}
+
+void CFdbBaseObject::initEventCache(FdbMsgCode_t event
+                                    , const char *topic
+                                    , IFdbMsgBuilder &data
+                                    , bool always_update)
+{
+    if (!topic)
+    {
+        topic = "";
+    }
+    auto &events = mEventCache[event];
+    auto it_event = events.insert(std::make_pair(std::string(topic), CEventData())).first;
+    auto &cached_event = it_event->second;
+    cached_event.mAlwaysUpdate = always_update;
+    int32_t size = data.build();
+    if (size < 0)
+    {
+        return;
+    }
+    cached_event.setEventCache(0, size);
+    data.toBuffer(cached_event.mBuffer, size);
+    cached_event.mVersion = ++mEventVersion;
+    storeEventCache(event, it_event->first, cached_event);
+    touchEventCache(event, it_event->first, cached_event);
+    trimEventCache(&cached_event);
+}
+                
+void CFdbBaseObject::initEventCache(FdbMsgCode_t event
+                                    , const char *topic
+                                    , const void *buffer
+                                    , int32_t size
+                                    , bool always_update)
+{
+    if (!topic)
+    {
+        topic = "";
+    }
+    auto &events = mEventCache[event];
+    auto it_event = events.insert(std::make_pair(std::string(topic), CEventData())).first;
+    auto &cached_event = it_event->second;
+    cached_event.mAlwaysUpdate = always_update;
+    if (cached_event.setEventCache((const uint8_t *)buffer, size,
+                                   !!(mFlag & FDB_OBJ_ENABLE_EVENT_HASH),
+                                   !!(mFlag & FDB_OBJ_ENABLE_EVENT_DELTA)))
+    {
+        cached_event.mVersion = ++mEventVersion;
+        storeEventCache(event, it_event->first, cached_event);
+        touchEventCache(event, it_event->first, cached_event);
+        trimEventCache(&cached_event);
+    }
+}
+
+bool CFdbBaseObject::invokeSideband(FdbMsgCode_t code
+                                  , IFdbMsgBuilder &data
+                                  , int32_t timeout)
+{
+    auto msg = new CBaseMessage(code, this, FDB_INVALID_ID);
+    if (!msg->serialize(data, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->invokeSideband(timeout);
+}
+
+bool CFdbBaseObject::invokeSideband(FdbMsgCode_t code
+                                  , const void *buffer
+                                  , int32_t size
+                                  , int32_t timeout)
+{
+    auto msg = new CBaseMessage(code, this, FDB_INVALID_ID);
+    if (!msg->serialize(buffer, size, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->invokeSideband(timeout);
+}
+
+bool CFdbBaseObject::sendSideband(FdbMsgCode_t code, IFdbMsgBuilder &data)
+{
+    auto msg = new CBaseMessage(code, this, FDB_INVALID_ID);
+    if (!msg->serialize(data, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->sendSideband();
+}
+
+bool CFdbBaseObject::sendSideband(FdbMsgCode_t code, const void *buffer, int32_t size)
+{
+    auto msg = new CBaseMessage(code, this, FDB_INVALID_ID);
+    if (!msg->serialize(buffer, size, this))
+    {
+        delete msg;
+        return false;
+    }
+    return msg->sendSideband();
+}
+
+CFdbBaseObject::CEventData::CEventData()
+    : mBuffer(0)
+    , mSize(0)
+    , mAlwaysUpdate(false)
+    , mHashValid(false)
+    , mHash(0)
+    , mVersion(0)
+    , mPrevBuffer(0)
+    , mPrevSize(0)
+    , mPrevVersion(0)
+    , mDeltaVersion(0)
+    , mLastUsed(0)
+    , mCharged(0)
+    , mEvictable(false)
+{
+}
+
+bool CFdbBaseObject::CEventData::changed(const uint8_t *buffer, int32_t size, bool use_hash,
+                                         uint64_t &hash) const
+{
+    hash = 0;
+    if (use_hash && buffer)
+    {
+        // one pass over the payload rather than memcmp(); copy only if changed
+        hash = fdbHash64(buffer, size);
+        return !(mHashValid && mBuffer && (size == mSize) && (hash == mHash));
+    }
+    return !(buffer && mBuffer && (size == mSize) && !memcmp(mBuffer, buffer, size));
+}
+
+void CFdbBaseObject::CEventData::keepPrevious(bool keep_prev)
+{
+    if (keep_prev)
+    {
+        // current value becomes the previous one
+        std::swap(mStorage, mPrevStorage);
+        std::swap(mBuffer, mPrevBuffer);
+        std::swap(mSize, mPrevSize);
+        mPrevVersion = mVersion;
+    }
+    else
+    {
+        mPrevStorage.reset();
+        mPrevBuffer = 0;
+        mPrevSize = 0;
+        mPrevVersion = 0;
+    }
+    mDelta.clear();
+    mDeltaVersion = 0;
+}
+
+bool CFdbBaseObject::CEventData::setEventCache(const uint8_t *buffer, int32_t size, bool use_hash,
+                                               bool keep_prev)
+{
+    uint64_t hash;
+    if (!changed(buffer, size, use_hash, hash))
+    {
+        return false;
+    }
+
+    keepPrevious(keep_prev);
+    // the buffer can be reused only if no message refers to it
+    if ((size != mSize) || !mStorage || (mStorage.use_count() > 1) ||
+        (mBuffer != mStorage.get() + CFdbMessage::maxReservedSize()))
+    {
+        mStorage.reset();
+        mBuffer = 0;
+        if (size)
+        {
+            // leave room for head so that the buffer can be sent as is
+            mStorage.reset(new uint8_t[CFdbMessage::maxReservedSize() + size],
+                           std::default_delete<uint8_t[]>());
+            mBuffer = mStorage.get() + CFdbMessage::maxReservedSize();
+        }
+    }
+    mSize = size;
+
+    if (size && buffer)
+    {
+        memcpy(mBuffer, buffer, size);
+    }
+    // without buffer the data is filled by caller later
+    mHashValid = use_hash && buffer;
+    mHash = hash;
+    return true;
+}
+
+bool CFdbBaseObject::CEventData::shareEventCache(CFdbMessage *msg, bool use_hash, bool keep_prev)
+{
+    auto buffer = msg->getPayloadBuffer();
+    auto size = msg->getPayloadSize();
+    if (!buffer || !size)
+    {
+        return setEventCache(buffer, size, use_hash, keep_prev);
+    }
+    uint64_t hash;
+    if (!changed(buffer, size, use_hash, hash))
+    {
+        return false;
+    }
+
+    keepPrevious(keep_prev);
+    mStorage = msg->shareBuffer();
+    mBuffer = buffer;
+    mSize = size;
+    mHashValid = use_hash;
+    mHash = hash;
+    return true;
+}
+
+void CFdbBaseObject::CEventData::replaceEventCache(uint8_t *buffer, int32_t size)
+{
+    mStorage.reset(buffer, std::default_delete<uint8_t[]>());
+    mBuffer = buffer;
+    mSize = size;
+    mHashValid = false;
+}
+
+bool CFdbBaseObject::CEventData::toMessage(CFdbMessage *msg, const CFdbBaseObject *object) const
+{
+    if (mStorage && (mBuffer == mStorage.get() + CFdbMessage::maxReservedSize()))
+    {
+        return msg->serialize(mStorage, mSize, object);
+    }
+    return msg->serialize(mBuffer, mSize, object);
+}
+
+void CFdbBaseObject::touchEventCache(FdbMsgCode_t code, const std::string &topic, CEventData &data)
+{
+    data.mLastUsed = sysdep_getsystemtime_milli();
+    if (!topic.empty())
+    {
+        if (data.mEvictable)
+        {
+            mCacheLru.splice(mCacheLru.begin(), mCacheLru, data.mLru);
+        }
+        else
+        {
+            data.mLru = mCacheLru.insert(mCacheLru.begin(), std::make_pair(code, topic));
+            data.mEvictable = true;
+        }
+    }
+    chargeEventCache(data);
+}
+
+void CFdbBaseObject::chargeEventCache(CEventData &data)
+{
+    auto size = (uint32_t)(data.mSize + data.mPrevSize + data.mDelta.size());
+    mCacheBytes += size - data.mCharged;
+    fdb_event_cache_bytes += size;
+    fdb_event_cache_bytes -= data.mCharged;
+    data.mCharged = size;
+}
+
+void CFdbBaseObject::evictEventCache(CacheLru_t::iterator it)
+{
+    auto it_events = mEventCache.find(it->first);
+    if (it_events != mEventCache.end())
+    {
+        auto &events = it_events->second;
+        auto it_event = events.find(it->second);
+        if (it_event != events.end())
+        {
+            mCacheBytes -= it_event->second.mCharged;
+            fdb_event_cache_bytes -= it_event->second.mCharged;
+            if (mPropertyStore)
+            {
+                mPropertyStore->remove(it->first, it->second.c_str());
+            }
+            events.erase(it_event);
+        }
+        if (events.empty())
+        {
+            mEventCache.erase(it_events);
+        }
+    }
+    mCacheLru.erase(it);
+}
+
+void CFdbBaseObject::trimEventCache(const CEventData *keep)
+{
+    auto now = sysdep_getsystemtime_milli();
+    uint64_t process_max = fdb_event_cache_max_bytes;
+    while (!mCacheLru.empty())
+    {
+        // the least recently used is at the end
+        auto it = std::prev(mCacheLru.end());
+        auto &data = mEventCache[it->first][it->second];
+        if (&data == keep)
+        {
+            break;
+        }
+        bool expired = mCacheTtl && ((now - data.mLastUsed) >= mCacheTtl);
+        bool over = (mCacheMaxBytes && (mCacheBytes > mCacheMaxBytes)) ||
+                    (process_max && (fdb_event_cache_bytes > process_max));
+        if (expired)
+        {
+            mCacheExpired++;
+        }
+        else if (over)
+        {
+            mCacheEvicted++;
+        }
+        else
+        {
+            break;
+        }
+        evictEventCache(it);
+    }
+}
+
+void CFdbBaseObject::clearEventCache()
+{
+    fdb_event_cache_bytes -= mCacheBytes;
+    mCacheBytes = 0;
+    mCacheLru.clear();
+    mEventCache.clear();
+}
+
+void CFdbBaseObject::setProcessEventCacheLimit(uint64_t max_bytes)
+{
+    fdb_event_cache_max_bytes = max_bytes;
+}
+
+uint64_t CFdbBaseObject::processEventCacheBytes()
+{
+    return fdb_event_cache_bytes;
+}
+
+void CFdbBaseObject::storeEventCache(FdbMsgCode_t code, const std::string &topic,
+                                     const CEventData &data)
+{
+    // the store is not guarded by onEventAuthentication()
+    if (mPropertyStore && (eventSecurityLevel(code) <= FDB_SECURITY_LEVEL_NONE))
+    {
+        mPropertyStore->write(code, topic.c_str(), data.mBuffer, data.mSize, data.mVersion);
+    }
+}
+
+bool CFdbBaseObject::enablePropertyStore(const char *name, uint32_t slots, uint32_t slot_size)
+{
+    disablePropertyStore();
+    auto store = new CFdbPropertyStore();
+    if (!store->create(name, slots, slot_size))
+    {
+        delete store;
+        return false;
+    }
+    mPropertyStore = store;
+    // publish what is already cached
+    for (auto it_events = mEventCache.begin(); it_events != mEventCache.end(); ++it_events)
+    {
+        auto &events = it_events->second;
+        for (auto it_event = events.begin(); it_event != events.end(); ++it_event)
+        {
+            storeEventCache(it_events->first, it_event->first, it_event->second);
+        }
+    }
+    return true;
+}
+
+void CFdbBaseObject::disablePropertyStore()
+{
+    if (mPropertyStore)
+    {
+        delete mPropertyStore;
+        mPropertyStore = 0;
+    }
+}
+
+void CFdbBaseObject::onSidebandInvoke(CBaseJob::Ptr &msg_ref)
+{
+    auto msg = castToMessage<CFdbMessage *>(msg_ref);
+    switch (msg->code())
+    {
+        case FDB_SIDEBAND_QUERY_EVT_CACHE:
+        {
+            NFdbBase::FdbMsgEventCache msg_cache;
+            trimEventCache();
+            auto now = sysdep_getsystemtime_milli();
+            for (auto it_events = mEventCache.begin(); it_events != mEventCache.end(); ++it_events)
+            {
+                auto event_code = it_events->first;
+                auto &events = it_events->second;
+                for (auto it_data = events.begin(); it_data != events.end(); ++it_data)
+                {
+                    auto &filter = it_data->first;
+                    auto &data = it_data->second;
+                    auto cache_item = msg_cache.add_cache();
+                    cache_item->set_event(event_code);
+                    cache_item->set_topic(filter.c_str());
+                    cache_item->set_size(data.mSize);
+                    cache_item->set_age(data.mLastUsed ? (uint32_t)(now - data.mLastUsed) : 0);
+                }
+            }
+            msg_cache.set_bytes(mCacheBytes);
+            msg_cache.set_max_bytes(mCacheMaxBytes);
+            msg_cache.set_ttl(mCacheTtl);
+            msg_cache.set_evicted(mCacheEvicted);
+            msg_cache.set_expired(mCacheExpired);
+            msg_cache.set_process_bytes(fdb_event_cache_bytes);
+            msg_cache.set_process_max_bytes(fdb_event_cache_max_bytes);
+            CFdbParcelableBuilder builder(msg_cache);
+            msg->replySideband(msg_ref, builder);
+        }
+        break;
+        default:
+        break;
+    }
+}
+
+void CFdbBaseObject::remoteCallback(CBaseJob::Ptr &msg_ref, long flag)
+{
+    switch (flag)
+    {
+        case FDB_CALLBACK_ON_BROADCAST:
+        {
+            onBroadcast(msg_ref);
+        }
+        break;
+        case FDB_CALLBACK_ON_GET_EVENT:
+        {
+            onGetEvent(msg_ref);
+        }
+        break;
+        case FDB_CALLBACK_ON_INVOKE:
+        {
+            onInvoke(msg_ref);
+            CFdbMessage::autoReply(msg_ref, NFdbBase::FDB_ST_AUTO_REPLY_OK, "Automatically reply to request.");
+        }
+        break;
+        case FDB_CALLBACK_ON_ONLINE:
+        {
+        }
+        break;
+        case FDB_CALLBACK_ON_OFFLINE:
+        {
+        }
+        break;
+        case FDB_CALLBACK_ON_REPLY:
+        {
+            onReply(msg_ref);
+        }
+        break;
+        case FDB_CALLBACK_ON_STATUS:
+        {
+            auto fdb_msg = castToMessage<CFdbMessage *>(msg_ref);
+            int32_t error_code;
+            std::string description;
+            if (!fdb_msg->decodeStatus(error_code, description))
+            {
+                return;
+            }
+            onStatus(msg_ref, error_code, description.c_str());
+        }
+        break;
+        case FDB_CALLBACK_ON_SUBSCRIBE:
+        {
+            onSubscribe(msg_ref);
+            CFdbMessage::autoReply(msg_ref, NFdbBase::FDB_ST_AUTO_REPLY_OK, "Automatically reply to subscribe request.");
+        }
+        break;
+        default:
+        break;
+    }
+}
+
+class CPrepareDestroyJob : public CMethodJob<CFdbBaseObject>
+{
+public:
+    CPrepareDestroyJob(CFdbBaseObject *object)
+        : CMethodJob<CFdbBaseObject>(object, &CFdbBaseObject::callPrepareDestroy, JOB_FORCE_RUN)
+    {
+    }
+};
+
+void CFdbBaseObject::callPrepareDestroy(CBaseWorker *worker, CMethodJob<CFdbBaseObject> *job, CBaseJob::Ptr &ref)
+{
+    enableMigrate(false);
+    autoRemove(false);
+    FDB_CONTEXT->getSharedSubscription()->remove(this);
+}
+
+void CFdbBaseObject::prepareDestroy()
+{
+    /*
+     * Why not just call callPrepareDestroy()? Supposing the following case:
+     * CFdbContext is executing the following logic:
+     * 1. check if migration flag is set;
+     * 2. if set, migrate callback to worker thread.
+     * between 1 and 2, call callPrepareDestroy() followed by flush(). It might
+     * be possible that the job to flush is in front of the job for migration.
+     */
+    CFdbContext::getInstance()->sendSyncEndeavor(new CPrepareDestroyJob(this), 0, true);
+    if (mWorker)
+    {
+        // Make sure no pending remote callback is queued
+        mWorker->flush();
+    }
+}
+
@@ -16,36 +16,247 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <locale.h>
 #include <common_base/CFdbCJsonMsgBuilder.h>
 #define FDB_LOG_TAG "FDB_TEST_CLIENT"
 #include <common_base/fdb_log_trace.h>
 #include <common_base/cJSON/cJSON.h>
 
+#define FDB_JSON_NUMBER_SIZE 26
+
+// print cJSON in the same way as cJSON_PrintUnformatted(); count only if no buffer
+class CFdbJsonPrinter
+{
+public:
+    CFdbJsonPrinter(char *buffer = 0)
+        : mBuffer(buffer)
+        , mPos(0)
+    {}
+    bool print(const cJSON *item);
+    int32_t size() const
+    {
+        return mPos;
+    }
+    void terminate()
+    {
+        put('\0');
+    }
+
+private:
+    char *mBuffer;
+    int32_t mPos;
+
+    void put(char c)
+    {
+        if (mBuffer)
+        {
+            mBuffer[mPos] = c;
+        }
+        ++mPos;
+    }
+    void put(const char *str, int32_t size)
+    {
+        if (mBuffer)
+        {
+            memcpy(mBuffer + mPos, str, size);
+        }
+        mPos += size;
+    }
+    bool printNumber(double d);
+    void printString(const char *str);
+};
+
+bool CFdbJsonPrinter::printNumber(double d)
+{
+    char number[FDB_JSON_NUMBER_SIZE];
+    int32_t len;
+    // This checks for NaN and Infinity
+    if ((d * 0) != 0)
+    {
+        len = sprintf(number, "null");
+    }
+    else
+    {
+        // Try 15 decimal places of precision to avoid nonsignificant nonzero digits
+        len = snprintf(number, sizeof(number), "%1.15g", d);
+        double test;
+        if ((sscanf(number, "%lg", &test) != 1) || (test != d))
+        {
+            len = snprintf(number, sizeof(number), "%1.17g", d);
+        }
+    }
+    if ((len < 0) || (len > (int32_t)(sizeof(number) - 1)))
+    {
+        return false;
+    }
+    // replace locale dependent decimal point with '.'
+    char decimal_point = localeconv()->decimal_point[0];
+    if (decimal_point != '.')
+    {
+        for (int32_t i = 0; i < len; ++i)
+        {
+            if (number[i] == decimal_point)
+            {
+                number[i] = '.';
+            }
+        }
+    }
+    put(number, len);
+    return true;
+}
+
+void CFdbJsonPrinter::printString(const char *str)
+{
+    put('\"');
+    if (str)
+    {
+        const char *plain = str;
+        for (const char *p = str; *p; ++p)
+        {
+            unsigned char c = (unsigned char)*p;
+            if ((c > 31) && (c != '\"') && (c != '\\'))
+            {
+                continue;
+            }
+            put(plain, (int32_t)(p - plain));
+            plain = p + 1;
+            put('\\');
+            switch (c)
+            {
+                case '\\':
+                    put('\\');
+                break;
+                case '\"':
+                    put('\"');
+                break;
+                case '\b':
+                    put('b');
+                break;
+                case '\f':
+                    put('f');
+                break;
+                case '\n':
+                    put('n');
+                break;
+                case '\r':
+                    put('r');
+                break;
+                case '\t':
+                    put('t');
+                break;
+                default:
+                {
+                    char code[8];
+                    int32_t len = snprintf(code, sizeof(code), "u%04x", c);
+                    put(code, len);
+                }
+                break;
+            }
+        }
+        put(plain, (int32_t)strlen(plain));
+    }
+    put('\"');
+}
+
+bool CFdbJsonPrinter::print(const cJSON *item)
+{
+    if (!item)
+    {
+        return false;
+    }
+
+    switch (item->type & 0xFF)
+    {
+        case cJSON_NULL:
+            put("null", 4);
+        break;
+        case cJSON_False:
+            put("false", 5);
+        break;
+        case cJSON_True:
+            put("true", 4);
+        break;
+        case cJSON_Number:
+            return printNumber(item->valuedouble);
+        case cJSON_Raw:
+            if (!item->valuestring)
+            {
+                return false;
+            }
+            put(item->valuestring, (int32_t)strlen(item->valuestring));
+        break;
+        case cJSON_String:
+            printString(item->valuestring);
+        break;
+        case cJSON_Array:
+            put('[');
+            for (const cJSON *child = item->child; child; child = child->next)
+            {
+                if (!print(child))
+                {
+                    return false;
+                }
+                if (child->next)
+                {
+                    put(',');
+                }
+            }
+            put(']');
+        break;
+        case cJSON_Object:
+            put('{');
+            for (const cJSON *child = item->child; child; child = child->next)
+            {
+                printString(child->string);
+                put(':');
+                if (!print(child))
+                {
+                    return false;
+                }
+                if (child->next)
+                {
+                    put(',');
+                }
+            }
+            put('}');
+        break;
+        default:
+            return false;
+    }
+    return true;
+}
+
 CFdbCJsonMsgBuilder::CFdbCJsonMsgBuilder(const cJSON *message)
     : mMessage(message)
-    , mJson(0)
     , mSize(0)
 {
 }
 
 int32_t CFdbCJsonMsgBuilder::build()
 {
-    mJson = cJSON_PrintUnformatted(mMessage);
-    mSize = (int32_t)strlen(mJson) + 1; // take EOS into consideration
+    CFdbJsonPrinter printer;
+    if (!printer.print(mMessage))
+    {
+        return -1;
+    }
+    printer.terminate(); // take EOS into consideration
+    mSize = printer.size();
     return mSize;
 }
 
 bool CFdbCJsonMsgBuilder::toBuffer(uint8_t *buffer, int32_t size)
 {
-    int32_t s = size;
-    if (size > mSize)
+    if (size < mSize)
     {
-        s = mSize;
+        return false;
     }
-    if (mJson)
+    CFdbJsonPrinter printer((char *)buffer);
+    if (!printer.print(mMessage))
     {
-        strncpy((char *)buffer, mJson, s);
+        return false;
     }
+    printer.terminate();
     return true;
 }
 
@@ -59,10 +270,6 @@ bool CFdbCJsonMsgBuilder::toString(std::string &msg_txt) const
 
 CFdbCJsonMsgBuilder::~CFdbCJsonMsgBuilder()
 {
-    if (mJson)
-    {
-        cJSON_free((void *)mJson);
-    }
 }
 
 CFdbCJsonMsgParser::CFdbCJsonMsgParser()
@@ -96,3 +303,431 @@ bool CFdbCJsonMsgParser::parse(const uint8_t *buffer, int32_t size)
     return mMessage != 0;
 }
 
+
+const char *CFdbJsonFieldParser::skipSpace(const char *pos, const char *end)
+{
+    while ((pos < end) && ((unsigned char)*pos <= ' '))
+    {
+        ++pos;
+    }
+    return pos;
+}
+
+const char *CFdbJsonFieldParser::scanValue(const char *pos, const char *end, CFdbJsonValue &value)
+{
+    value.mType = CFdbJsonValue::JSON_INVALID;
+    pos = skipSpace(pos, end);
+    if (pos >= end)
+    {
+        return 0;
+    }
+
+    const char *start = pos;
+    switch (*pos)
+    {
+        case '\"':
+            for (++pos; pos < end; ++pos)
+            {
+                if (*pos == '\\')
+                {
+                    ++pos;
+                }
+                else if (*pos == '\"')
+                {
+                    value.mType = CFdbJsonValue::JSON_STRING;
+                    value.mText = start + 1;
+                    value.mSize = (int32_t)(pos - start - 1);
+                    return pos + 1;
+                }
+            }
+            return 0;
+        case '{':
+        case '[':
+        {
+            int32_t depth = 0;
+            for (; pos < end; ++pos)
+            {
+                char c = *pos;
+                if (c == '\"')
+                {
+                    for (++pos; (pos < end) && (*pos != '\"'); ++pos)
+                    {
+                        if (*pos == '\\')
+                        {
+                            ++pos;
+                        }
+                    }
+                }
+                else if ((c == '{') || (c == '['))
+                {
+                    ++depth;
+                }
+                else if ((c == '}') || (c == ']'))
+                {
+                    if (--depth == 0)
+                    {
+                        value.mType = (*start == '{') ? CFdbJsonValue::JSON_OBJECT :
+                                                        CFdbJsonValue::JSON_ARRAY;
+                        value.mText = start;
+                        value.mSize = (int32_t)(pos - start + 1);
+                        return pos + 1;
+                    }
+                }
+            }
+            return 0;
+        }
+        case 't':
+            if (((end - pos) >= 4) && !strncmp(pos, "true", 4))
+            {
+                value.mType = CFdbJsonValue::JSON_TRUE;
+                pos += 4;
+            }
+        break;
+        case 'f':
+            if (((end - pos) >= 5) && !strncmp(pos, "false", 5))
+            {
+                value.mType = CFdbJsonValue::JSON_FALSE;
+                pos += 5;
+            }
+        break;
+        case 'n':
+            if (((end - pos) >= 4) && !strncmp(pos, "null", 4))
+            {
+                value.mType = CFdbJsonValue::JSON_NULL;
+                pos += 4;
+            }
+        break;
+        default:
+            while ((pos < end) && (((*pos >= '0') && (*pos <= '9')) || strchr("+-.eE", *pos)))
+            {
+                ++pos;
+            }
+            if (pos > start)
+            {
+                value.mType = CFdbJsonValue::JSON_NUMBER;
+            }
+        break;
+    }
+
+    if (value.mType == CFdbJsonValue::JSON_INVALID)
+    {
+        return 0;
+    }
+    value.mText = start;
+    value.mSize = (int32_t)(pos - start);
+    return pos;
+}
+
+CFdbJsonFieldParser::CFdbJsonFieldParser()
+    : mBegin(0)
+    , mEnd(0)
+{
+}
+
+bool CFdbJsonFieldParser::parse(const uint8_t *buffer, int32_t size)
+{
+    mBegin = mEnd = 0;
+    if (!buffer || (size <= 0))
+    {
+        return false;
+    }
+    const char *begin = (const char *)buffer;
+    const char *end = (const char *)memchr(begin, '\0', size);
+    if (!end)
+    {
+        end = begin + size;
+    }
+    CFdbJsonValue object;
+    if (!scanValue(begin, end, object) || (object.mType != CFdbJsonValue::JSON_OBJECT))
+    {
+        return false;
+    }
+    mBegin = object.mText;
+    mEnd = object.mText + object.mSize;
+    return true;
+}
+
+CFdbJsonFieldParser::CIterator::CIterator(const CFdbJsonFieldParser &parser)
+    : mPos(parser.mBegin ? parser.mBegin + 1 : 0)
+    , mEnd(parser.mEnd ? parser.mEnd - 1 : 0)
+    , mFirst(true)
+{
+}
+
+bool CFdbJsonFieldParser::CIterator::next(CFdbJsonValue &key, CFdbJsonValue &value)
+{
+    if (!mPos)
+    {
+        return false;
+    }
+    mPos = skipSpace(mPos, mEnd);
+    if (!mFirst)
+    {
+        if ((mPos >= mEnd) || (*mPos != ','))
+        {
+            mPos = 0;
+            return false;
+        }
+        ++mPos;
+    }
+    mFirst = false;
+
+    mPos = scanValue(mPos, mEnd, key);
+    if (!mPos || (key.mType != CFdbJsonValue::JSON_STRING))
+    {
+        mPos = 0;
+        return false;
+    }
+    mPos = skipSpace(mPos, mEnd);
+    if ((mPos >= mEnd) || (*mPos != ':'))
+    {
+        mPos = 0;
+        return false;
+    }
+    mPos = scanValue(mPos + 1, mEnd, value);
+    return !!mPos;
+}
+
+bool CFdbJsonFieldParser::find(const char *key, CFdbJsonValue &value) const
+{
+    CIterator it(*this);
+    CFdbJsonValue member_key;
+    while (it.next(member_key, value))
+    {
+        if (member_key.equals(key))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CFdbJsonFieldParser::getInt(const char *key, int64_t &value) const
+{
+    CFdbJsonValue json_value;
+    return find(key, json_value) && json_value.toInt(value);
+}
+
+bool CFdbJsonFieldParser::getDouble(const char *key, double &value) const
+{
+    CFdbJsonValue json_value;
+    return find(key, json_value) && json_value.toDouble(value);
+}
+
+bool CFdbJsonFieldParser::getBool(const char *key, bool &value) const
+{
+    CFdbJsonValue json_value;
+    return find(key, json_value) && json_value.toBool(value);
+}
+
+bool CFdbJsonFieldParser::getString(const char *key, std::string &value) const
+{
+    CFdbJsonValue json_value;
+    return find(key, json_value) && json_value.toString(value);
+}
+
+bool CFdbJsonFieldParser::getObject(const char *key, CFdbJsonFieldParser &object) const
+{
+    CFdbJsonValue json_value;
+    if (!find(key, json_value) || (json_value.type() != CFdbJsonValue::JSON_OBJECT))
+    {
+        return false;
+    }
+    object.mBegin = json_value.text();
+    object.mEnd = json_value.text() + json_value.size();
+    return true;
+}
+
+bool CFdbJsonValue::toDouble(double &value) const
+{
+    char number[FDB_JSON_NUMBER_SIZE * 2];
+    if ((mType != JSON_NUMBER) || (mSize >= (int32_t)sizeof(number)))
+    {
+        return false;
+    }
+    memcpy(number, mText, mSize);
+    number[mSize] = '\0';
+    char *end = 0;
+    value = strtod(number, &end);
+    return end == (number + mSize);
+}
+
+bool CFdbJsonValue::toInt(int64_t &value) const
+{
+    char number[FDB_JSON_NUMBER_SIZE * 2];
+    if ((mType != JSON_NUMBER) || (mSize >= (int32_t)sizeof(number)))
+    {
+        return false;
+    }
+    memcpy(number, mText, mSize);
+    number[mSize] = '\0';
+    char *end = 0;
+    value = strtoll(number, &end, 10);
+    if (end == (number + mSize))
+    {
+        return true;
+    }
+    // such as 1e3 or 2.0
+    double d;
+    if (!toDouble(d))
+    {
+        return false;
+    }
+    value = (int64_t)d;
+    return true;
+}
+
+bool CFdbJsonValue::toBool(bool &value) const
+{
+    if (mType == JSON_TRUE)
+    {
+        value = true;
+    }
+    else if (mType == JSON_FALSE)
+    {
+        value = false;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static int32_t fdb_json_hex4(const char *p)
+{
+    int32_t code = 0;
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        char c = p[i];
+        code <<= 4;
+        if ((c >= '0') && (c <= '9'))
+        {
+            code |= c - '0';
+        }
+        else if ((c >= 'a') && (c <= 'f'))
+        {
+            code |= c - 'a' + 10;
+        }
+        else if ((c >= 'A') && (c <= 'F'))
+        {
+            code |= c - 'A' + 10;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    return code;
+}
+
+static void fdb_json_put_utf8(std::string &str, uint32_t code)
+{
+    if (code < 0x80)
+    {
+        str.push_back((char)code);
+    }
+    else if (code < 0x800)
+    {
+        str.push_back((char)(0xC0 | (code >> 6)));
+        str.push_back((char)(0x80 | (code & 0x3F)));
+    }
+    else if (code < 0x10000)
+    {
+        str.push_back((char)(0xE0 | (code >> 12)));
+        str.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+        str.push_back((char)(0x80 | (code & 0x3F)));
+    }
+    else
+    {
+        str.push_back((char)(0xF0 | (code >> 18)));
+        str.push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+        str.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+        str.push_back((char)(0x80 | (code & 0x3F)));
+    }
+}
+
+bool CFdbJsonValue::toString(std::string &value) const
+{
+    if (mType != JSON_STRING)
+    {
+        return false;
+    }
+    value.clear();
+    value.reserve(mSize);
+    const char *end = mText + mSize;
+    for (const char *p = mText; p < end; ++p)
+    {
+        if (*p != '\\')
+        {
+            value.push_back(*p);
+            continue;
+        }
+        if (++p >= end)
+        {
+            return false;
+        }
+        switch (*p)
+        {
+            case 'b':
+                value.push_back('\b');
+            break;
+            case 'f':
+                value.push_back('\f');
+            break;
+            case 'n':
+                value.push_back('\n');
+            break;
+            case 'r':
+                value.push_back('\r');
+            break;
+            case 't':
+                value.push_back('\t');
+            break;
+            case 'u':
+            {
+                if ((end - p) < 5)
+                {
+                    return false;
+                }
+                int32_t code = fdb_json_hex4(p + 1);
+                if (code < 0)
+                {
+                    return false;
+                }
+                p += 4;
+                // surrogate pair
+                if ((code >= 0xD800) && (code <= 0xDBFF) && ((end - p) >= 7) &&
+                    (p[1] == '\\') && (p[2] == 'u'))
+                {
+                    int32_t low = fdb_json_hex4(p + 3);
+                    if ((low >= 0xDC00) && (low <= 0xDFFF))
+                    {
+                        code = 0x10000 + (((code & 0x3FF) << 10) | (low & 0x3FF));
+                        p += 6;
+                    }
+                }
+                fdb_json_put_utf8(value, (uint32_t)code);
+            }
+            break;
+            default:
+                value.push_back(*p);
+            break;
+        }
+    }
+    return true;
+}
+
+bool CFdbJsonValue::equals(const char *str) const
+{
+    if (mType != JSON_STRING)
+    {
+        return false;
+    }
+    if (!memchr(mText, '\\', mSize))
+    {
+        return !strncmp(mText, str, mSize) && (str[mSize] == '\0');
+    }
+    std::string value;
+    return toString(value) && (value == str);
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <common_base/CFdbContentFilter.h>
+#include <common_base/CFdbFlatMsgBuilder.h>
+
+template <typename T>
+static bool fdbCompare(T field, T value, uint8_t op)
+{
+    switch (op)
+    {
+        case CFdbContentFilter::OP_EQ:
+            return field == value;
+        case CFdbContentFilter::OP_NE:
+            return field != value;
+        case CFdbContentFilter::OP_LT:
+            return field < value;
+        case CFdbContentFilter::OP_LE:
+            return field <= value;
+        case CFdbContentFilter::OP_GT:
+            return field > value;
+        case CFdbContentFilter::OP_GE:
+            return field >= value;
+        default:
+            return false;
+    }
+}
+
+int32_t CFdbContentFilter::typeSize() const
+{
+    switch (mType)
+    {
+        case TYPE_INT8:
+        case TYPE_UINT8:
+        case TYPE_BOOL:
+            return 1;
+        case TYPE_INT16:
+        case TYPE_UINT16:
+            return 2;
+        case TYPE_INT32:
+        case TYPE_UINT32:
+        case TYPE_FLOAT:
+            return 4;
+        case TYPE_INT64:
+        case TYPE_UINT64:
+        case TYPE_DOUBLE:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+bool CFdbContentFilter::match(const uint8_t *payload, int32_t size) const
+{
+    if (!payload || (size <= 0))
+    {
+        return false;
+    }
+
+    uint32_t offset = mLocation;
+    if (mLayout == LAYOUT_FLAT)
+    {
+        if (size < FDB_FLAT_HEAD_SIZE)
+        {
+            return false;
+        }
+        if (mLocation >= fdbLoadScalar<uint16_t>(payload))
+        {
+            return false;
+        }
+        offset = FDB_FLAT_HEAD_SIZE + mLocation * FDB_FLAT_SLOT_SIZE;
+    }
+    else if (mLayout != LAYOUT_RAW)
+    {
+        return false;
+    }
+
+    auto width = typeSize();
+    if (!width || (offset > (uint32_t)size) || (((uint32_t)size - offset) < (uint32_t)width))
+    {
+        return false;
+    }
+
+    auto p = payload + offset;
+    switch (mType)
+    {
+        case TYPE_INT8:
+            return fdbCompare<int64_t>(fdbLoadScalar<int8_t>(p), mIntValue, mOperator);
+        case TYPE_UINT8:
+        case TYPE_BOOL:
+            return fdbCompare<int64_t>(fdbLoadScalar<uint8_t>(p), mIntValue, mOperator);
+        case TYPE_INT16:
+            return fdbCompare<int64_t>(fdbLoadScalar<int16_t>(p), mIntValue, mOperator);
+        case TYPE_UINT16:
+            return fdbCompare<int64_t>(fdbLoadScalar<uint16_t>(p), mIntValue, mOperator);
+        case TYPE_INT32:
+            return fdbCompare<int64_t>(fdbLoadScalar<int32_t>(p), mIntValue, mOperator);
+        case TYPE_UINT32:
+            return fdbCompare<int64_t>(fdbLoadScalar<uint32_t>(p), mIntValue, mOperator);
+        case TYPE_INT64:
+            return fdbCompare<int64_t>(fdbLoadScalar<int64_t>(p), mIntValue, mOperator);
+        case TYPE_UINT64:
+            return fdbCompare<uint64_t>(fdbLoadScalar<uint64_t>(p), (uint64_t)mIntValue, mOperator);
+        case TYPE_FLOAT:
+            return fdbCompare<double>(fdbLoadScalar<float>(p), mFloatValue, mOperator);
+        case TYPE_DOUBLE:
+            return fdbCompare<double>(fdbLoadScalar<double>(p), mFloatValue, mOperator);
+        default:
+            return false;
+    }
+}
+
+void CFdbContentFilter::toKey(std::string &key) const
+{
+    uint8_t buffer[3 + sizeof(mLocation) + sizeof(int64_t)];
+    buffer[0] = mLayout;
+    buffer[1] = mType;
+    buffer[2] = mOperator;
+    memcpy(buffer + 3, &mLocation, sizeof(mLocation));
+    if (isFloat())
+    {
+        memcpy(buffer + 3 + sizeof(mLocation), &mFloatValue, sizeof(mFloatValue));
+    }
+    else
+    {
+        memcpy(buffer + 3 + sizeof(mLocation), &mIntValue, sizeof(mIntValue));
+    }
+    key.assign((const char *)buffer, sizeof(buffer));
+}
+
+void CFdbContentFilter::serialize(CFdbSimpleSerializer &serializer) const
+{
+    serializer << mLayout << mType << mOperator << mLocation;
+    if (isFloat())
+    {
+        serializer << mFloatValue;
+    }
+    else
+    {
+        serializer << mIntValue;
+    }
+}
+
+void CFdbContentFilter::deserialize(CFdbSimpleDeserializer &deserializer)
+{
+    deserializer >> mLayout >> mType >> mOperator >> mLocation;
+    if (isFloat())
+    {
+        deserializer >> mFloatValue;
+    }
+    else
+    {
+        deserializer >> mIntValue;
+    }
+}
+
+void CFdbContentFilter::toString(std::ostringstream &stream) const
+{
+    static const char *op_names[] = {"==", "!=", "<", "<=", ">", ">="};
+    stream << ((mLayout == LAYOUT_FLAT) ? "slot : " : "offset : ") << mLocation
+           << ", type : " << (uint32_t)mType
+           << ", op : " << ((mOperator <= OP_GE) ? op_names[mOperator] : "?")
+           << ", value : ";
+    if (isFloat())
+    {
+        stream << mFloatValue;
+    }
+    else
+    {
+        stream << mIntValue;
+    }
+}
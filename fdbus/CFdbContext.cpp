@@ -18,8 +18,14 @@
 #include <common_base/CFdbSession.h>
 #include <common_base/CIntraNameProxy.h>
 #include <common_base/CLogProducer.h>
+#include <common_base/CFdbSharedSubscription.h>
 #include <utils/Log.h>
 #include <iostream>
+#include <algorithm>
+
+// free slots to keep before reusing one, to delay reusing handles
+#define FDB_ENDPOINT_REUSE_DEPTH    16
+#define FDB_SESSION_REUSE_DEPTH     256
 
 // template<> FdbSessionId_t CFdbContext::tSessionContainer::mUniqueEntryAllocator = 0;
 
@@ -27,14 +33,22 @@ CFdbContext *CFdbContext::mInstance = 0;
 
 CFdbContext::CFdbContext()
     : CBaseWorker("CFdbContext")
+    , mEndpointContainer(FDB_ENDPOINT_REUSE_DEPTH)
+    , mSessionContainer(FDB_SESSION_REUSE_DEPTH)
     , mNameProxy(0)
     , mLogger(0)
+    , mSharedSubscription(new CFdbSharedSubscription())
     , mEnableNameProxy(true)
     , mEnableLogger(true)
 {
 
 }
 
+CFdbContext::~CFdbContext()
+{
+    delete mSharedSubscription;
+}
+
 bool CFdbContext::start(uint32_t flag)
 {
     return CBaseWorker::start(FDB_WORKER_ENABLE_FD_LOOP | flag);
@@ -82,12 +96,12 @@ bool CFdbContext::destroy()
         delete logger;
     }
 
-    if (!mEndpointContainer.getContainer().empty())
+    if (!mEndpointContainer.empty())
     {
         std::cout << "CFdbContext: Unable to destroy context since there are active endpoint!" << std::endl;
         return false;
     }
-    if (!mSessionContainer.getContainer().empty())
+    if (!mSessionContainer.empty())
     {
         std::cout << "CFdbContext: Unable to destroy context since there are active sessions!\n" << std::endl;
         return false;
@@ -101,39 +115,32 @@ bool CFdbContext::destroy()
 
 CBaseEndpoint *CFdbContext::getEndpoint(FdbEndpointId_t endpoint_id)
 {
-    CBaseEndpoint *endpoint = 0;
-    mEndpointContainer.retrieveEntry(endpoint_id, endpoint);
-    return endpoint;
+    return mEndpointContainer.retrieve(endpoint_id);
 }
 
 void CFdbContext::registerSession(CFdbSession *session)
 {
-    auto sid = mSessionContainer.allocateEntityId();
+    auto sid = mSessionContainer.insert(session);
+    if (!fdbValidFdbId(sid))
+    {
+        LOG_E("CFdbContext: too many sessions!\n");
+    }
     session->sid(sid);
-    mSessionContainer.insertEntry(sid, session);
 }
 
 CFdbSession *CFdbContext::getSession(FdbSessionId_t session_id)
 {
-    CFdbSession *session = 0;
-    mSessionContainer.retrieveEntry(session_id, session);
-    return session;
+    return mSessionContainer.retrieve(session_id);
 }
 
 void CFdbContext::unregisterSession(FdbSessionId_t session_id)
 {
-    CFdbSession *session = 0;
-    auto it = mSessionContainer.retrieveEntry(session_id, session);
-    if (session)
-    {
-        mSessionContainer.deleteEntry(it);
-    }
+    mSessionContainer.remove(session_id);
 }
 
 void CFdbContext::deleteSession(FdbSessionId_t session_id)
 {
-    CFdbSession *session = 0;
-    (void)mSessionContainer.retrieveEntry(session_id, session);
+    auto session = mSessionContainer.retrieve(session_id);
     if (session)
     {
         delete session;
@@ -142,12 +149,10 @@ void CFdbContext::deleteSession(FdbSessionId_t session_id)
 
 void CFdbContext::deleteSession(CFdbSessionContainer *container)
 {
-    auto &session_tbl = mSessionContainer.getContainer();
-    for (auto it = session_tbl.begin(); it != session_tbl.end();)
+    for (uint32_t i = 0; i < mSessionContainer.slots(); ++i)
     {
-        CFdbSession *session = it->second;
-        ++it;
-        if (session->container() == container)
+        auto session = mSessionContainer.entryAt(i);
+        if (session && (session->container() == container))
         {
             delete session;
         }
@@ -159,9 +164,17 @@ FdbEndpointId_t CFdbContext::registerEndpoint(CBaseEndpoint *endpoint)
     auto id = endpoint->epid();
     if (!fdbValidFdbId(id))
     {
-        id = mEndpointContainer.allocateEntityId();
+        id = mEndpointContainer.insert(endpoint);
+        if (!fdbValidFdbId(id))
+        {
+            LOG_E("CFdbContext: too many endpoints!\n");
+            return id;
+        }
         endpoint->epid(id);
-        mEndpointContainer.insertEntry(id, endpoint);
+        if (!endpoint->nsName().empty())
+        {
+            mEndpointNameTable[endpoint->nsName()].push_back(endpoint);
+        }
         endpoint->enableMigrate(true);
     }
     return id;
@@ -169,13 +182,41 @@ FdbEndpointId_t CFdbContext::registerEndpoint(CBaseEndpoint *endpoint)
 
 void CFdbContext::unregisterEndpoint(CBaseEndpoint *endpoint)
 {
-    CBaseEndpoint *self = 0;
-    auto it = mEndpointContainer.retrieveEntry(endpoint->epid(), self);
-    if (self)
+    if (mEndpointContainer.retrieve(endpoint->epid()) == endpoint)
     {
+        removeEndpointName(endpoint, endpoint->nsName());
         endpoint->enableMigrate(false);
+        mEndpointContainer.remove(endpoint->epid());
         endpoint->epid(FDB_INVALID_ID);
-        mEndpointContainer.deleteEntry(it);
+    }
+}
+
+void CFdbContext::removeEndpointName(CBaseEndpoint *endpoint, const std::string &name)
+{
+    auto it = mEndpointNameTable.find(name);
+    if (it == mEndpointNameTable.end())
+    {
+        return;
+    }
+    auto &ep_tbl = it->second;
+    ep_tbl.erase(std::remove(ep_tbl.begin(), ep_tbl.end(), endpoint), ep_tbl.end());
+    if (ep_tbl.empty())
+    {
+        mEndpointNameTable.erase(it);
+    }
+}
+
+void CFdbContext::renameEndpoint(CBaseEndpoint *endpoint, const std::string &old_name)
+{
+    if (mEndpointContainer.retrieve(endpoint->epid()) != endpoint)
+    {
+        // not registered yet: indexed on registration
+        return;
+    }
+    removeEndpointName(endpoint, old_name);
+    if (!endpoint->nsName().empty())
+    {
+        mEndpointNameTable[endpoint->nsName()].push_back(endpoint);
     }
 }
 
@@ -183,32 +224,18 @@ void CFdbContext::findEndpoint(const char *name
                                , std::vector<CBaseEndpoint *> &ep_tbl
                                , bool is_server)
 {
-    auto &container = mEndpointContainer.getContainer();
-    for (auto it = container.begin(); it != container.end(); ++it)
+    auto it = mEndpointNameTable.find(name);
+    if (it == mEndpointNameTable.end())
     {
-        auto endpoint = it->second;
-        auto found = false;
-
-        if (is_server)
-        {
-            if (endpoint->role() == FDB_OBJECT_ROLE_SERVER)
-            {
-                found = true;
-            }
-        }
-        else if (endpoint->role() == FDB_OBJECT_ROLE_CLIENT)
-        {
-            found = true;
-        }
-
-        if (!found)
-        {
-            continue;
-        }
-
-        if (!endpoint->nsName().compare(name))
+        return;
+    }
+    auto role = is_server ? FDB_OBJECT_ROLE_SERVER : FDB_OBJECT_ROLE_CLIENT;
+    auto &endpoints = it->second;
+    for (auto it_ep = endpoints.begin(); it_ep != endpoints.end(); ++it_ep)
+    {
+        if ((*it_ep)->role() == role)
         {
-            ep_tbl.push_back(endpoint);
+            ep_tbl.push_back(*it_ep);
         }
     }
 }
@@ -220,11 +247,13 @@ CIntraNameProxy *CFdbContext::getNameProxy()
 
 void CFdbContext::reconnectOnNsConnected()
 {
-    auto &container = mEndpointContainer.getContainer();
-    for (auto it = container.begin(); it != container.end(); ++it)
+    for (uint32_t i = 0; i < mEndpointContainer.slots(); ++i)
     {
-        auto endpoint = it->second;
-        endpoint->requestServiceAddress();
+        auto endpoint = mEndpointContainer.entryAt(i);
+        if (endpoint)
+        {
+            endpoint->requestServiceAddress();
+        }
     }
 }
 
@@ -30,25 +30,6 @@
 #define FDB_MSG_TX_NO_REPLY     (1 << 1)
 #define FDB_MAX_STATUS_SIZE     1024
 
-class CMessageTimer : public CBaseLoopTimer
-{
-public:
-    CMessageTimer(int32_t interval)
-        : CBaseLoopTimer(interval, false)
-        , mSession(0)
-        , mMsgSn(FDB_INVALID_ID)
-    {}
-protected:
-    void run()
-    {
-        mSession->terminateMessage(mMsgSn, NFdbBase::FDB_ST_TIMEOUT, "Message is destroyed due to timeout.");
-    }
-private:
-    CFdbSession *mSession;
-    FdbMsgSn_t mMsgSn;
-    friend class CFdbMessage;
-};
-
 CFdbMessage::CFdbMessage(FdbMsgCode_t code)
     : mType(FDB_MT_REQUEST)
     , mCode(code)
@@ -60,9 +41,10 @@ CFdbMessage::CFdbMessage(FdbMsgCode_t code)
     , mOid(FDB_INVALID_ID)
     , mBuffer(0)
     , mFlag(0)
-    , mTimer(0)
+    , mTimeout(0)
     , mMigrateObject(0)
     , mMigrateFlag(0)
+    , mEventVersion(0)
 {
 }
 
@@ -75,9 +57,10 @@ CFdbMessage::CFdbMessage(FdbMsgCode_t code, CFdbBaseObject *obj, FdbSessionId_t
     , mOffset(0)
     , mBuffer(0)
     , mFlag(0)
-    , mTimer(0)
+    , mTimeout(0)
     , mMigrateObject(0)
     , mMigrateFlag(0)
+    , mEventVersion(0)
 {
     setDestination(obj, alt_receiver);
 }
@@ -93,9 +76,10 @@ CFdbMessage::CFdbMessage(FdbMsgCode_t code, CFdbMessage *msg, const char *filter
     , mOid(msg->mOid)
     , mBuffer(0)
     , mFlag(0)
-    , mTimer(0)
+    , mTimeout(0)
     , mMigrateObject(0)
     , mMigrateFlag(0)
+    , mEventVersion(0)
 {
     if (filter)
     {
@@ -120,14 +104,19 @@ CFdbMessage::CFdbMessage(NFdbBase::CFdbMessageHeader &head
     , mOid(head.object_id())
     , mBuffer(buffer)
     , mFlag((head.flag() & MSG_GLOBAL_FLAG_MASK) | MSG_FLAG_EXTERNAL_BUFFER)
-    , mTimer(0)
+    , mTimeout(0)
     , mMigrateObject(0)
     , mMigrateFlag(0)
+    , mEventVersion(0)
 {
     if (head.has_broadcast_filter())
     {
         mFilter = head.broadcast_filter().c_str();
     }
+    if (head.has_event_version())
+    {
+        mEventVersion = head.event_version();
+    }
 };
 
 CFdbMessage::CFdbMessage(FdbMsgCode_t code
@@ -143,9 +132,10 @@ CFdbMessage::CFdbMessage(FdbMsgCode_t code
     , mOffset(0)
     , mBuffer(0)
     , mFlag(0)
-    , mTimer(0)
+    , mTimeout(0)
     , mMigrateObject(0)
     , mMigrateFlag(0)
+    , mEventVersion(0)
 {
     setDestination(obj, FDB_INVALID_ID);
     if (filter)
@@ -171,11 +161,6 @@ CFdbMessage::CFdbMessage(FdbMsgCode_t code
 
 CFdbMessage::~CFdbMessage()
 {
-    if (mTimer)
-    {
-        delete mTimer;
-        mTimer = 0;
-    }
     releaseBuffer();
     //LOG_I("Message %d is destroyed!\n", (int32_t)mSn);
 }
@@ -375,7 +360,7 @@ bool CFdbMessage::submit(CBaseJob::Ptr &msg_ref
         }
         if (timeout > 0)
         {
-            mTimer = new CMessageTimer(timeout);
+            mTimeout = timeout;
         }
     }
 
@@ -529,6 +514,10 @@ bool CFdbMessage::buildHeader(CFdbSession *session)
     {
         msg_hdr.set_broadcast_filter(filter);
     }
+    if (mEventVersion)
+    {
+        msg_hdr.set_event_version(mEventVersion);
+    }
 
     CFdbParcelableBuilder builder(msg_hdr);
     int32_t head_size = builder.build();
@@ -564,6 +553,11 @@ void CFdbMessage::freeRawBuffer()
     }
 }
 
+std::function<void(uint8_t *)> CFdbMessage::rawBufferDeleter()
+{
+    return std::default_delete<uint8_t[]>();
+}
+
 bool CFdbMessage::allocCopyRawBuffer(const void *src, int32_t payload_size)
 {
     int32_t total_size = maxReservedSize() + payload_size;
@@ -633,9 +627,92 @@ bool CFdbMessage::serialize(const void *buffer, int32_t size, const CFdbBaseObje
     return allocCopyRawBuffer(buffer, mPayloadSize);
 }
 
+bool CFdbMessage::serialize(const std::shared_ptr<uint8_t> &buffer, int32_t size,
+                            const CFdbBaseObject *object)
+{
+    if (!buffer)
+    {
+        return serialize((const void *)0, size, object);
+    }
+    mOffset = 0;
+    mHeadSize = mMaxHeadSize;
+
+    if (object)
+    {
+        checkLogEnabled(object);
+    }
+
+    releaseBuffer();
+    mSharedBuffer = buffer;
+    mBuffer = buffer.get();
+    mFlag |= MSG_FLAG_SHARED_BUFFER;
+    mPayloadSize = size;
+    return true;
+}
+
+std::shared_ptr<uint8_t> CFdbMessage::shareBuffer()
+{
+    if (!(mFlag & MSG_FLAG_SHARED_BUFFER) && mBuffer)
+    {
+        // freed the same way as releaseBuffer() would
+        if (mFlag & MSG_FLAG_EXTERNAL_BUFFER)
+        {
+            mSharedBuffer.reset(mBuffer, rawBufferDeleter());
+        }
+        else
+        {
+            mSharedBuffer.reset(mBuffer, std::default_delete<uint8_t[]>());
+        }
+        mFlag |= MSG_FLAG_SHARED_BUFFER;
+    }
+    return mSharedBuffer;
+}
+
+bool CFdbMessage::sharePayload(const std::shared_ptr<uint8_t> &buffer, int32_t offset, int32_t size)
+{
+    if (!buffer || (offset < mPrefixSize))
+    {
+        return false;
+    }
+    releaseBuffer();
+    mSharedBuffer = buffer;
+    mBuffer = buffer.get();
+    mFlag |= MSG_FLAG_SHARED_BUFFER;
+    mHeadSize = 0;
+    mOffset = offset - mPrefixSize;
+    mPayloadSize = size;
+    return true;
+}
+
+void *CFdbMessage::ownBuffer()
+{
+    void *buf = mBuffer;
+    if (mFlag & MSG_FLAG_SHARED_BUFFER)
+    {
+        // still referred by others: give a copy
+        buf = 0;
+        if (mBuffer)
+        {
+            int32_t size = getExtraDataOffset();
+            buf = new uint8_t[size];
+            memcpy(buf, mBuffer, size);
+        }
+        mSharedBuffer.reset();
+        mFlag &= ~MSG_FLAG_SHARED_BUFFER;
+    }
+    mBuffer = 0;
+    return buf;
+}
+
 void CFdbMessage::releaseBuffer()
 {
-    if (mFlag & MSG_FLAG_EXTERNAL_BUFFER)
+    if (mFlag & MSG_FLAG_SHARED_BUFFER)
+    {
+        mSharedBuffer.reset();
+        mBuffer = 0;
+        mFlag &= ~MSG_FLAG_SHARED_BUFFER;
+    }
+    else if (mFlag & MSG_FLAG_EXTERNAL_BUFFER)
     {
         freeRawBuffer();
     }
@@ -661,6 +738,14 @@ void CFdbMessage::doRequest(Ptr &ref)
     bool success = true;
     const char *reason;
     auto session = getSession();
+    if (session && ((mFlag & MSG_FLAG_GET_EVENT) || (mType == FDB_MT_SUBSCRIBE_REQ)))
+    {
+        auto object = session->container()->owner()->getObject(this, false);
+        if (object && object->doLocalRequest(ref, session))
+        {
+            return;
+        }
+    }
     if (session)
     {
         if (mFlag & MSG_FLAG_NOREPLY_EXPECTED)
@@ -670,12 +755,9 @@ void CFdbMessage::doRequest(Ptr &ref)
         }
         else
         {
-            if (session->sendMessage(ref) && mTimer)
+            if (session->sendMessage(ref) && (mTimeout > 0))
             {
-                mTimer->mSession = session;
-                //TODO: store ref rather than sn for performance
-                mTimer->mMsgSn = mSn;
-                mTimer->attach(CFdbContext::getInstance());
+                session->addDeadline(mSn, mTimeout);
             }
         }
     }
@@ -0,0 +1,558 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <common_base/CFdbPropertyStore.h>
+#include <utils/Log.h>
+#include <string.h>
+#include <stdio.h>
+#include <atomic>
+#ifndef __WIN32__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+#define FDB_PROPERTY_STORE_MAGIC    0x50424446 // "FDBP"
+#define FDB_PROPERTY_STORE_LAYOUT   1
+// readers give up (and fall back to IPC) if the writer keeps the slot busy
+#define FDB_PROPERTY_READ_RETRY     1000
+#define FDB_PROPERTY_ALIGN(_size)   (((_size) + 63) & ~63)
+
+enum EFdbPropertyState
+{
+    FDB_PROPERTY_ABSENT = 0,
+    FDB_PROPERTY_VALID = 1,
+    FDB_PROPERTY_TOO_LARGE = 2
+};
+
+/*
+ * Layout of the store: head followed by mSlots slots; each slot is a
+ * CPropertySlot followed by mSlotSize bytes of payload, 64-byte aligned.
+ * The shared memory is zero filled when created, which is the initial
+ * state of all fields.
+ */
+struct CPropertyStoreHead
+{
+    uint32_t mMagic;
+    uint32_t mLayout;
+    uint32_t mSlots;
+    uint32_t mSlotSize;
+    std::atomic<uint32_t> mClosed;
+};
+
+struct CPropertySlot
+{
+    // odd while being written; 0 if the slot is never taken
+    std::atomic<uint32_t> mSeq;
+    int32_t mCode;
+    uint32_t mState;
+    uint32_t mSize;
+    uint64_t mVersion;
+    uint32_t mTopicLen;
+    char mTopic[FDB_PROPERTY_TOPIC_SIZE];
+};
+
+#define FDB_PROPERTY_HEAD_SIZE FDB_PROPERTY_ALIGN(sizeof(CPropertyStoreHead))
+
+static uint32_t fdbPropertyHash(FdbMsgCode_t code, const char *topic, uint32_t topic_len)
+{
+    // FNV-1a: readers and writer in different processes must agree
+    uint32_t hash = 2166136261u;
+    auto p = (const uint8_t *)&code;
+    for (uint32_t i = 0; i < sizeof(code); ++i)
+    {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    for (uint32_t i = 0; i < topic_len; ++i)
+    {
+        hash = (hash ^ (uint8_t)topic[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static std::string fdbPropertyPath(const char *name)
+{
+    std::string path = FDB_CFG_PROPERTY_STORE_PATH "/fdb-prop-";
+    for (auto p = name; *p; ++p)
+    {
+        path += (*p == '/') ? '_' : *p;
+    }
+    return path;
+}
+
+#if defined(FDB_CFG_PROPERTY_STORE_MEMFD) && !defined(__WIN32__)
+/*
+ * The store is a memfd instead of a file at the path, which then only
+ * holds "/proc/<pid>/fd/<fd>" of the memfd in the server. Besides the
+ * mode of that file, opening the memfd through /proc takes the right to
+ * read memory of the server.
+ */
+static int fdbCreateMemFd(const char *name)
+{
+#ifdef SYS_memfd_create
+    return (int)syscall(SYS_memfd_create, name, 1 /* MFD_CLOEXEC */);
+#else
+    return -1;
+#endif
+}
+
+static bool fdbWriteLocator(const std::string &path, int fd)
+{
+    char locator[64];
+    auto len = snprintf(locator, sizeof(locator), "/proc/%d/fd/%d", (int)getpid(), fd);
+    int locator_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, FDB_CFG_PROPERTY_STORE_MODE);
+    if (locator_fd < 0)
+    {
+        return false;
+    }
+    bool ok = write(locator_fd, locator, len) == len;
+    ::close(locator_fd);
+    return ok;
+}
+
+static bool fdbReadLocator(const std::string &path, std::string &locator)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    char buffer[64];
+    auto len = read(fd, buffer, sizeof(buffer) - 1);
+    ::close(fd);
+    if (len <= 0)
+    {
+        return false;
+    }
+    locator.assign(buffer, len);
+    return true;
+}
+#endif
+
+CFdbPropertyStore::CFdbPropertyStore()
+    : mBase(0)
+    , mMapSize(0)
+    , mSlots(0)
+    , mSlotSize(0)
+    , mStride(0)
+    , mWritable(false)
+    , mMemFd(-1)
+{
+}
+
+CFdbPropertyStore::~CFdbPropertyStore()
+{
+    close();
+}
+
+uint8_t *CFdbPropertyStore::slot(uint32_t index) const
+{
+    return mBase + FDB_PROPERTY_HEAD_SIZE + index * mStride;
+}
+
+bool CFdbPropertyStore::create(const char *name, uint32_t slots, uint32_t slot_size)
+{
+#ifdef __WIN32__
+    return false;
+#else
+    close();
+    if (!name || !slots)
+    {
+        return false;
+    }
+    auto stride = (uint64_t)FDB_PROPERTY_ALIGN((uint64_t)sizeof(CPropertySlot) + slot_size);
+    auto map_size = (uint64_t)FDB_PROPERTY_HEAD_SIZE + (uint64_t)slots * stride;
+    if (map_size > (uint32_t)~0)
+    {
+        LOG_E("CFdbPropertyStore: %u slots of %u bytes are too large!\n", slots, slot_size);
+        return false;
+    }
+    auto path = fdbPropertyPath(name);
+    // readers of the previous store keep their mapping until they reopen
+    unlink(path.c_str());
+#ifdef FDB_CFG_PROPERTY_STORE_MEMFD
+    int fd = fdbCreateMemFd(path.c_str() + strlen(FDB_CFG_PROPERTY_STORE_PATH "/"));
+#else
+    // not readable beyond FDB_CFG_PROPERTY_STORE_MODE: see onEventAuthentication()
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, FDB_CFG_PROPERTY_STORE_MODE);
+#endif
+    if (fd < 0)
+    {
+        LOG_E("CFdbPropertyStore: unable to create %s!\n", path.c_str());
+        return false;
+    }
+    void *base = MAP_FAILED;
+    if (!ftruncate(fd, map_size))
+    {
+        base = mmap(0, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+#ifdef FDB_CFG_PROPERTY_STORE_MEMFD
+    // the memfd is found through the fd: keep it open
+    if ((base != MAP_FAILED) && !fdbWriteLocator(path, fd))
+    {
+        munmap(base, map_size);
+        base = MAP_FAILED;
+    }
+    if (base == MAP_FAILED)
+    {
+        ::close(fd);
+    }
+    else
+    {
+        mMemFd = fd;
+    }
+#else
+    ::close(fd);
+#endif
+    if (base == MAP_FAILED)
+    {
+        LOG_E("CFdbPropertyStore: unable to map %s!\n", path.c_str());
+        unlink(path.c_str());
+        return false;
+    }
+
+    mBase = (uint8_t *)base;
+    mMapSize = (uint32_t)map_size;
+    mSlots = slots;
+    mSlotSize = slot_size;
+    mStride = (uint32_t)stride;
+    mWritable = true;
+    mPath = path;
+
+    auto head = (CPropertyStoreHead *)mBase;
+    head->mLayout = FDB_PROPERTY_STORE_LAYOUT;
+    head->mSlots = slots;
+    head->mSlotSize = slot_size;
+    std::atomic_thread_fence(std::memory_order_release);
+    head->mMagic = FDB_PROPERTY_STORE_MAGIC;
+    return true;
+#endif
+}
+
+bool CFdbPropertyStore::open(const char *name)
+{
+#ifdef __WIN32__
+    return false;
+#else
+    close();
+    if (!name)
+    {
+        return false;
+    }
+    auto path = fdbPropertyPath(name);
+#ifdef FDB_CFG_PROPERTY_STORE_MEMFD
+    std::string locator;
+    if (!fdbReadLocator(path, locator))
+    {
+        return false;
+    }
+    int fd = ::open(locator.c_str(), O_RDONLY);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+#endif
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (!fstat(fd, &st) && ((size_t)st.st_size >= FDB_PROPERTY_HEAD_SIZE) &&
+        ((uint64_t)st.st_size <= (uint32_t)~0))
+    {
+        base = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (base == MAP_FAILED)
+    {
+        return false;
+    }
+
+    auto head = (const CPropertyStoreHead *)base;
+    bool valid = false;
+    if (head->mMagic == FDB_PROPERTY_STORE_MAGIC)
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto stride = (uint64_t)FDB_PROPERTY_ALIGN((uint64_t)sizeof(CPropertySlot) + head->mSlotSize);
+        valid = (head->mLayout == FDB_PROPERTY_STORE_LAYOUT) && head->mSlots &&
+                ((uint64_t)FDB_PROPERTY_HEAD_SIZE + (uint64_t)head->mSlots * stride <= (uint64_t)st.st_size);
+        if (valid)
+        {
+            mSlots = head->mSlots;
+            mSlotSize = head->mSlotSize;
+            mStride = (uint32_t)stride;
+        }
+    }
+    if (!valid)
+    {
+        munmap(base, st.st_size);
+        return false;
+    }
+    mBase = (uint8_t *)base;
+    mMapSize = (uint32_t)st.st_size;
+    mWritable = false;
+    mPath = path;
+    return true;
+#endif
+}
+
+void CFdbPropertyStore::close()
+{
+#ifndef __WIN32__
+    if (!mBase)
+    {
+        return;
+    }
+    if (mWritable)
+    {
+        // tell readers still mapping it to fall back
+        ((CPropertyStoreHead *)mBase)->mClosed.store(1, std::memory_order_release);
+        unlink(mPath.c_str());
+    }
+    munmap(mBase, mMapSize);
+    if (mMemFd >= 0)
+    {
+        ::close(mMemFd);
+        mMemFd = -1;
+    }
+    mBase = 0;
+    mMapSize = 0;
+    mWritable = false;
+    mPath.clear();
+#endif
+}
+
+/*
+ * Only called by the writer, so the slot can't change in between. With
+ * @claim, a slot of removed event met while probing is reused if the
+ * event is not found, so that the store doesn't fill up with removed
+ * events.
+ */
+int32_t CFdbPropertyStore::findSlot(FdbMsgCode_t code, const char *topic, uint32_t topic_len,
+                                    bool claim)
+{
+    auto hash = fdbPropertyHash(code, topic, topic_len);
+    int32_t absent = -1;
+    for (uint32_t i = 0; i < mSlots; ++i)
+    {
+        auto index = (hash + i) % mSlots;
+        auto s = (CPropertySlot *)slot(index);
+        if (!s->mSeq.load(std::memory_order_relaxed))
+        {
+            if (!claim)
+            {
+                return -1;
+            }
+            return (absent < 0) ? (int32_t)index : absent;
+        }
+        if ((s->mCode == code) && (s->mTopicLen == topic_len) && !memcmp(s->mTopic, topic, topic_len))
+        {
+            return (int32_t)index;
+        }
+        if ((absent < 0) && (s->mState == FDB_PROPERTY_ABSENT))
+        {
+            absent = (int32_t)index;
+        }
+    }
+    return claim ? absent : -1;
+}
+
+bool CFdbPropertyStore::write(FdbMsgCode_t code, const char *topic, const void *payload,
+                              int32_t size, uint64_t version)
+{
+    if (!mBase || !mWritable)
+    {
+        return false;
+    }
+    if (!topic)
+    {
+        topic = "";
+    }
+    auto topic_len = (uint32_t)strlen(topic);
+    if (topic_len > FDB_PROPERTY_TOPIC_SIZE)
+    {
+        return false;
+    }
+    auto index = findSlot(code, topic, topic_len, true);
+    if (index < 0)
+    {
+        LOG_W("CFdbPropertyStore: %s is full; event %d topic %s is not stored.\n",
+              mPath.c_str(), code, topic);
+        return false;
+    }
+
+    auto s = (CPropertySlot *)slot(index);
+    auto seq = s->mSeq.load(std::memory_order_relaxed);
+    s->mSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    if (!seq || (s->mState == FDB_PROPERTY_ABSENT))
+    {
+        // new or reused slot
+        s->mCode = code;
+        s->mTopicLen = topic_len;
+        memcpy(s->mTopic, topic, topic_len);
+    }
+    if ((size < 0) || ((uint32_t)size > mSlotSize))
+    {
+        s->mState = FDB_PROPERTY_TOO_LARGE;
+        s->mSize = 0;
+    }
+    else
+    {
+        s->mState = FDB_PROPERTY_VALID;
+        s->mSize = (uint32_t)size;
+        if (size && payload)
+        {
+            memcpy((uint8_t *)s + sizeof(CPropertySlot), payload, size);
+        }
+    }
+    s->mVersion = version;
+    s->mSeq.store(seq + 2, std::memory_order_release);
+    return s->mState == FDB_PROPERTY_VALID;
+}
+
+void CFdbPropertyStore::remove(FdbMsgCode_t code, const char *topic)
+{
+    if (!mBase || !mWritable)
+    {
+        return;
+    }
+    if (!topic)
+    {
+        topic = "";
+    }
+    auto topic_len = (uint32_t)strlen(topic);
+    if (topic_len > FDB_PROPERTY_TOPIC_SIZE)
+    {
+        return;
+    }
+    auto index = findSlot(code, topic, topic_len, false);
+    if (index < 0)
+    {
+        return;
+    }
+    // the slot is left taken so that probing is not broken; reused by write()
+    auto s = (CPropertySlot *)slot(index);
+    auto seq = s->mSeq.load(std::memory_order_relaxed);
+    s->mSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s->mState = FDB_PROPERTY_ABSENT;
+    s->mSize = 0;
+    s->mSeq.store(seq + 2, std::memory_order_release);
+}
+
+bool CFdbPropertyStore::read(FdbMsgCode_t code, const char *topic, void *buffer, int32_t &size,
+                             uint64_t *version) const
+{
+    auto capacity = size;
+    size = 0;
+    if (!mBase)
+    {
+        return false;
+    }
+    if (((const CPropertyStoreHead *)mBase)->mClosed.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    if (!topic)
+    {
+        topic = "";
+    }
+    auto topic_len = (uint32_t)strlen(topic);
+    if (topic_len > FDB_PROPERTY_TOPIC_SIZE)
+    {
+        return false;
+    }
+
+    auto hash = fdbPropertyHash(code, topic, topic_len);
+    for (uint32_t i = 0; i < mSlots; ++i)
+    {
+        auto s = (const CPropertySlot *)slot((hash + i) % mSlots);
+        int32_t retry = FDB_PROPERTY_READ_RETRY;
+        while (true)
+        {
+            auto seq = s->mSeq.load(std::memory_order_acquire);
+            if (!seq)
+            {
+                // never taken: end of probing
+                return false;
+            }
+            if (seq & 1)
+            {
+                if (--retry <= 0)
+                {
+                    return false;
+                }
+                continue;
+            }
+            bool match = (s->mCode == code) && (s->mTopicLen == topic_len) &&
+                         !memcmp(s->mTopic, topic, topic_len);
+            bool found = false;
+            uint32_t value_size = 0;
+            uint64_t value_version = 0;
+            if (match)
+            {
+                found = s->mState == FDB_PROPERTY_VALID;
+                // might be torn: never copy beyond the slot
+                value_size = s->mSize;
+                value_version = s->mVersion;
+                if (found && (value_size <= mSlotSize) && (value_size <= (uint32_t)capacity) && buffer)
+                {
+                    memcpy(buffer, (const uint8_t *)s + sizeof(CPropertySlot), value_size);
+                }
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s->mSeq.load(std::memory_order_relaxed) != seq)
+            {
+                if (--retry <= 0)
+                {
+                    return false;
+                }
+                continue;
+            }
+            if (!match)
+            {
+                break;
+            }
+            if (!found)
+            {
+                return false;
+            }
+            size = (int32_t)value_size;
+            if (version)
+            {
+                *version = value_version;
+            }
+            return (value_size <= (uint32_t)capacity) && (buffer || !value_size);
+        }
+    }
+    return false;
+}
+
+bool CFdbPropertyStore::read(FdbMsgCode_t code, const char *topic, std::vector<uint8_t> &value,
+                             uint64_t *version) const
+{
+    value.resize(mSlotSize);
+    int32_t size = (int32_t)value.size();
+    if (!read(code, topic, value.data(), size, version))
+    {
+        value.clear();
+        return false;
+    }
+    value.resize(size);
+    return true;
+}
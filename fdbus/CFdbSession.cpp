@@ -21,11 +21,21 @@
 #include <common_base/CLogProducer.h>
 #include <utils/Log.h>
 #include <common_base/CFdbIfMessageHeader.h>
+#include <algorithm>
+
+// heap is compacted when it holds this many more deadlines than pending requests
+#define FDB_DEADLINE_SLACK      64
 
 #define FDB_SEND_RETRIES (1024 * 10)
 #define FDB_RECV_RETRIES 256
 #define FDB_SEND_DELAY 1
 #define FDB_SEND_MAX_RECURSIVE 128
+// a demoted peer is written at most this many bytes every interval (ms)
+#define FDB_DEMOTED_SEND_QUOTA (64 * 1024)
+#define FDB_DEMOTED_SEND_INTERVAL 20
+// whatever the policy is, a peer is kicked off once the queue exceeds
+// the limit this many times
+#define FDB_OUTBOUND_HARD_LIMIT_FACTOR 4
 
 CFdbSession::CFdbSession(FdbSessionId_t sid, CFdbSessionContainer *container, CSocketImp *socket)
     : CBaseFdWatch(socket->getFd(), POLLIN | POLLHUP | POLLERR)
@@ -34,20 +44,41 @@ CFdbSession::CFdbSession(FdbSessionId_t sid, CFdbSessionContainer *container, CS
     , mSocket(socket)
     , mSecurityLevel(FDB_SECURITY_LEVEL_NONE)
     , mRecursiveDepth(0)
+    , mDeadlineTimer(0)
+    , mDeadlineDue(0)
+    , mDemotedTimer(0)
+    , mOutputHeld(false)
 {
+    memset(&mOutboundStats, 0, sizeof(mOutboundStats));
 }
 
 CFdbSession::~CFdbSession()
 {
-    auto &sn_generator = mPendingMsgTable.getContainer();
-    while (!sn_generator.empty())
+    if (mDeadlineTimer)
+    {
+        delete mDeadlineTimer;
+        mDeadlineTimer = 0;
+    }
+    mDeadlines.clear();
+    if (mDemotedTimer)
+    {
+        delete mDemotedTimer;
+        mDemotedTimer = 0;
+    }
+
+    CBaseJob::Ptr job;
+    while (mPendingMsgTable.pop(job))
     {
-        auto it = sn_generator.begin();
-        terminateMessage(it->second, NFdbBase::FDB_ST_PEER_VANISH,
+        terminateMessage(job, NFdbBase::FDB_ST_PEER_VANISH,
                          "Message is destroyed due to broken connection.");
-        mPendingMsgTable.deleteEntry(it);
     }
 
+    for (auto it = mOutboundQueue.begin(); it != mOutboundQueue.end(); ++it)
+    {
+        delete[] it->mBuffer;
+    }
+    mOutboundQueue.clear();
+
     mContainer->owner()->deleteConnectedSession(this);
     mContainer->owner()->unsubscribeSession(this);
     CFdbContext::getInstance()->unregisterSession(mSid);
@@ -69,6 +100,20 @@ bool CFdbSession::sendMessage(const uint8_t *buffer, int32_t size)
         return false;
     }
 
+    if (!mOutboundQueue.empty())
+    {
+        // keep the order with messages already queued; a demoted peer is
+        // only written from its own lane
+        if (!mRecursiveDepth && !demoted() && !flushOutbound(0))
+        {
+            return false;
+        }
+        if (!mOutboundQueue.empty())
+        {
+            return queueMessage(buffer, size, 0, 0);
+        }
+    }
+
     int32_t retries = FDB_SEND_RETRIES;
     mRecursiveDepth++;
     while (1)
@@ -114,7 +159,9 @@ bool CFdbSession::sendMessage(CFdbMessage *msg)
     {
         return false;
     }
-    if (sendMessage(msg->getRawBuffer(), msg->getRawDataSize()))
+    bool sent = (msg->type() == FDB_MT_BROADCAST) ? sendBroadcast(msg) :
+                    sendMessage(msg->getRawBuffer(), msg->getRawDataSize());
+    if (sent)
     {
         if (msg->isLogEnabled())
         {
@@ -129,6 +176,272 @@ bool CFdbSession::sendMessage(CFdbMessage *msg)
     return false;
 }
 
+/*
+ * Broadcast never blocks: whatever the socket can't take is queued and
+ * sent from onOutput() so that a slow subscriber doesn't hold up other
+ * subscribers and the context.
+ */
+bool CFdbSession::sendBroadcast(CFdbMessage *msg)
+{
+    auto buffer = msg->getRawBuffer();
+    auto size = msg->getRawDataSize();
+    if (fatalError() || !buffer)
+    {
+        return false;
+    }
+
+    int32_t sent = 0;
+    // can't write in the middle of a message being sent by sendMessage()
+    if (mOutboundQueue.empty() && !mRecursiveDepth && !demoted())
+    {
+        sent = mSocket->send(buffer, size);
+        if (sent < 0)
+        {
+            return false;
+        }
+        if (sent >= size)
+        {
+            return true;
+        }
+    }
+    return queueMessage(buffer, size, sent, msg);
+}
+
+bool CFdbSession::queueMessage(const uint8_t *buffer, int32_t size, int32_t sent, CFdbMessage *msg)
+{
+    // a snapshot carries many events: never dropped or conflated
+    if (msg && (msg->mFlag & MSG_FLAG_SNAPSHOT))
+    {
+        msg = 0;
+    }
+    if (msg && !sent && mOutboundStats.mSlow &&
+        (mContainer->owner()->slowPeerPolicy() == FDB_SLOW_CONFLATE) &&
+        conflate(buffer, size, msg))
+    {
+        return true;
+    }
+
+    COutboundItem item;
+    item.mBuffer = new uint8_t[size];
+    memcpy(item.mBuffer, buffer, size);
+    item.mSize = size;
+    item.mSent = sent;
+    item.mTime = sysdep_getsystemtime_milli();
+    item.mBroadcast = !!msg;
+    if (msg)
+    {
+        item.mCode = msg->code();
+        item.mObjId = msg->objectId();
+        item.mTopic = msg->topic();
+    }
+    else
+    {
+        item.mCode = FDB_INVALID_ID;
+        item.mObjId = FDB_INVALID_ID;
+    }
+    if (mOutboundQueue.empty())
+    {
+        flags(POLLIN | POLLOUT | POLLHUP | POLLERR);
+    }
+    mOutboundQueue.push_back(item);
+    mOutboundStats.mQueuedBytes += size - sent;
+    if (mOutboundStats.mQueuedBytes > mOutboundStats.mPeakBytes)
+    {
+        mOutboundStats.mPeakBytes = mOutboundStats.mQueuedBytes;
+    }
+    return checkSlow();
+}
+
+bool CFdbSession::conflate(const uint8_t *buffer, int32_t size, CFdbMessage *msg)
+{
+    // the message partially sent can't be touched
+    for (auto it = mOutboundQueue.rbegin(); it != mOutboundQueue.rend(); ++it)
+    {
+        if (!it->mBroadcast || it->mSent || (it->mCode != msg->code()) ||
+            (it->mObjId != msg->objectId()) || it->mTopic.compare(msg->topic()))
+        {
+            continue;
+        }
+        mOutboundStats.mQueuedBytes -= it->mSize;
+        delete[] it->mBuffer;
+        it->mBuffer = new uint8_t[size];
+        memcpy(it->mBuffer, buffer, size);
+        it->mSize = size;
+        mOutboundStats.mQueuedBytes += size;
+        mOutboundStats.mConflated++;
+        return true;
+    }
+    return false;
+}
+
+void CFdbSession::dropOldest(uint32_t max_bytes, uint32_t max_age, uint64_t now)
+{
+    auto it = mOutboundQueue.begin();
+    while (it != mOutboundQueue.end())
+    {
+        if (!(max_bytes && (mOutboundStats.mQueuedBytes > max_bytes)) &&
+            !(max_age && ((now - it->mTime) > max_age)))
+        {
+            break;
+        }
+        if (!it->mBroadcast || it->mSent)
+        {
+            ++it;
+            continue;
+        }
+        mOutboundStats.mQueuedBytes -= it->mSize;
+        mOutboundStats.mDropped++;
+        delete[] it->mBuffer;
+        it = mOutboundQueue.erase(it);
+    }
+}
+
+bool CFdbSession::checkSlow()
+{
+    if (mOutboundQueue.empty())
+    {
+        return true;
+    }
+    auto endpoint = mContainer->owner();
+    auto max_bytes = endpoint->slowPeerMaxBytes();
+    auto max_age = endpoint->slowPeerMaxAge();
+    auto now = sysdep_getsystemtime_milli();
+    auto age = now - mOutboundQueue.front().mTime;
+    if (!(max_bytes && (mOutboundStats.mQueuedBytes > max_bytes)) &&
+        !(max_age && (age > max_age)))
+    {
+        return true;
+    }
+
+    if (!mOutboundStats.mSlow)
+    {
+        mOutboundStats.mSlow = true;
+        mOutboundStats.mSlowCount++;
+        LOG_W("CFdbSession: Session %d (%s) is slow: %u bytes queued, oldest for %u ms.\n",
+              mSid, mSenderName.c_str(), mOutboundStats.mQueuedBytes, (uint32_t)age);
+    }
+
+    switch (endpoint->slowPeerPolicy())
+    {
+        case FDB_SLOW_DISCONNECT:
+            LOG_E("CFdbSession: Session %d (%s) is kicked off for being slow!\n",
+                  mSid, mSenderName.c_str());
+            fatalError(true);
+            return false;
+        case FDB_SLOW_DROP_OLDEST:
+            dropOldest(max_bytes, max_age, now);
+            break;
+        case FDB_SLOW_CONFLATE:
+            // conflated broadcast carries the latest value: don't drop it for age
+            dropOldest(max_bytes, 0, now);
+            break;
+        default:
+            break;
+    }
+
+    if (max_bytes && (mOutboundStats.mQueuedBytes / FDB_OUTBOUND_HARD_LIMIT_FACTOR > max_bytes))
+    {
+        LOG_E("CFdbSession: Session %d (%s) is kicked off for %u bytes queued!\n",
+              mSid, mSenderName.c_str(), mOutboundStats.mQueuedBytes);
+        fatalError(true);
+        return false;
+    }
+    return true;
+}
+
+bool CFdbSession::demoted()
+{
+    return mOutboundStats.mSlow &&
+           (mContainer->owner()->slowPeerPolicy() == FDB_SLOW_DEMOTE);
+}
+
+/*
+ * Write queued messages until the socket is full or @quota (0 for no
+ * limit) bytes are written.
+ */
+bool CFdbSession::flushOutbound(int32_t quota)
+{
+    int32_t written = 0;
+    while (!mOutboundQueue.empty())
+    {
+        auto &item = mOutboundQueue.front();
+        int32_t cnt = mSocket->send(item.mBuffer + item.mSent, item.mSize - item.mSent);
+        if (cnt < 0)
+        {
+            return false;
+        }
+        item.mSent += cnt;
+        mOutboundStats.mQueuedBytes -= cnt;
+        written += cnt;
+        if (item.mSent < item.mSize)
+        {
+            break;
+        }
+        delete[] item.mBuffer;
+        mOutboundQueue.pop_front();
+        if (quota && (written >= quota))
+        {
+            break;
+        }
+    }
+
+    if (mOutboundQueue.empty())
+    {
+        flags(POLLIN | POLLHUP | POLLERR);
+        mOutputHeld = false;
+        if (mOutboundStats.mSlow)
+        {
+            mOutboundStats.mSlow = false;
+            LOG_I("CFdbSession: Session %d (%s) catches up.\n", mSid, mSenderName.c_str());
+        }
+    }
+    return true;
+}
+
+void CFdbSession::onOutput(bool &io_error)
+{
+    auto demoted_lane = demoted();
+    if (!flushOutbound(demoted_lane ? FDB_DEMOTED_SEND_QUOTA : 0))
+    {
+        io_error = true;
+        return;
+    }
+    if (!checkSlow() || !demoted_lane || mOutboundQueue.empty())
+    {
+        return;
+    }
+    /*
+     * Low priority lane: after its quota a demoted peer stops polling for
+     * POLLOUT and waits for the timer, so that it gets a bounded share of
+     * the context however fast its socket drains.
+     */
+    flags(POLLIN | POLLHUP | POLLERR);
+    mOutputHeld = true;
+    if (!mDemotedTimer)
+    {
+        mDemotedTimer = new CDemotedTimer(this);
+        mDemotedTimer->attach(FDB_CONTEXT, false);
+    }
+    mDemotedTimer->enableOneShot(FDB_DEMOTED_SEND_INTERVAL);
+}
+
+void CFdbSession::onDemotedTimer(CMethodLoopTimer<CFdbSession> *timer)
+{
+    if (mOutputHeld && !mOutboundQueue.empty())
+    {
+        flags(POLLIN | POLLOUT | POLLHUP | POLLERR);
+    }
+    mOutputHeld = false;
+}
+
+void CFdbSession::getOutboundStats(CFdbOutboundStats &stats)
+{
+    stats = mOutboundStats;
+    stats.mQueuedMsgs = (uint32_t)mOutboundQueue.size();
+    stats.mOldestAge = mOutboundQueue.empty() ? 0 :
+                (uint32_t)(sysdep_getsystemtime_milli() - mOutboundQueue.front().mTime);
+}
+
 bool CFdbSession::sendMessage(CBaseJob::Ptr &ref)
 {
     auto msg = castToMessage<CFdbMessage *>(ref);
@@ -136,11 +449,11 @@ bool CFdbSession::sendMessage(CBaseJob::Ptr &ref)
     {
         return false;
     }
-    msg->sn(mPendingMsgTable.allocateEntityId());
+    msg->sn(mPendingMsgTable.allocateSn());
     if (sendMessage(msg))
     {
         msg->replaceBuffer(0); // free buffer to save memory
-        mPendingMsgTable.insertEntry(msg->sn(), ref);
+        mPendingMsgTable.insert(msg->sn(), ref);
         return true;
     }
     else
@@ -319,19 +632,24 @@ void CFdbSession::doRequest(NFdbBase::CFdbMessageHeader &head,
 void CFdbSession::doResponse(NFdbBase::CFdbMessageHeader &head,
                              CFdbMessage::CFdbMsgPrefix &prefix, uint8_t *buffer)
 {
-    bool found;
-    PendingMsgTable_t::EntryContainer_t::iterator it;
-    CBaseJob::Ptr &msg_ref = mPendingMsgTable.retrieveEntry(head.serial_number(), it, found);
-    if (found)
+    auto sn = head.serial_number();
+    auto pending = mPendingMsgTable.retrieve(sn);
+    if (pending)
     {
+        /*
+         * The table might change during callbacks: hold the message and
+         * remove it from the table before terminate() so that reference
+         * count is the same as before for sync waiter.
+         */
+        CBaseJob::Ptr msg_ref = *pending;
         auto msg = castToMessage<CFdbMessage *>(msg_ref);
         auto object_id = head.object_id();
         if (msg->objectId() != object_id)
         {
             LOG_E("CFdbSession: object id of response %d does not match that in request: %d\n",
                     object_id, msg->objectId());
+            mPendingMsgTable.remove(sn);
             terminateMessage(msg_ref, NFdbBase::FDB_ST_OBJECT_NOT_FOUND, "Object ID does not match.");
-            mPendingMsgTable.deleteEntry(it);
             delete[] buffer;
             return;
         }
@@ -388,8 +706,8 @@ void CFdbSession::doResponse(NFdbBase::CFdbMessageHeader &head,
             delete[] buffer;
         }
 
+        mPendingMsgTable.remove(sn);
         msg_ref->terminate(msg_ref);
-        mPendingMsgTable.deleteEntry(it);
     }
 }
 
@@ -446,11 +764,13 @@ void CFdbSession::doSubscribeReq(NFdbBase::CFdbMessageHeader &head,
                     {
                         type = sub_item->type();
                     }
-                    object->subscribe(this, code, object_id, filter, type);
+                    object->subscribe(this, code, object_id, filter, type, sub_item->pattern(),
+                                      sub_item->has_content_filter() ? &sub_item->content_filter() : 0,
+                                      sub_item->policy(), sub_item->interval(), sub_item->delta());
                 }
                 else
                 {
-                    object->unsubscribe(this, code, object_id, filter);
+                    object->unsubscribe(this, code, object_id, filter, sub_item->pattern());
                     LOG_E("CFdbSession: Session %d: Unable to subscribe obj: %d, id: %d, filter: %s. Fail in security check!\n",
                            mSid, object_id, code, filter);
                     if (ret >= 0)
@@ -461,7 +781,7 @@ void CFdbSession::doSubscribeReq(NFdbBase::CFdbMessageHeader &head,
             }
             else
             {
-                object->unsubscribe(this, code, object_id, filter);
+                object->unsubscribe(this, code, object_id, filter, sub_item->pattern());
                 unsubscribe_object = false;
             }
         }
@@ -547,13 +867,12 @@ void CFdbSession::terminateMessage(CBaseJob::Ptr &job, int32_t status, const cha
 
 void CFdbSession::terminateMessage(FdbMsgSn_t msg_sn, int32_t status, const char *reason)
 {
-    bool found;
-    PendingMsgTable_t::EntryContainer_t::iterator it;
-    CBaseJob::Ptr &job = mPendingMsgTable.retrieveEntry(msg_sn, it, found);
-    if (found)
+    auto pending = mPendingMsgTable.retrieve(msg_sn);
+    if (pending)
     {
+        CBaseJob::Ptr job = *pending;
+        mPendingMsgTable.remove(msg_sn);
         terminateMessage(job, status, reason);
-        mPendingMsgTable.deleteEntry(it);
     }
 }
 
@@ -566,11 +885,84 @@ void CFdbSession::getSessionInfo(CFdbSessionInfo &info)
 
 CFdbMessage *CFdbSession::peepPendingMessage(FdbMsgSn_t sn)
 {
-    bool found;
-    
-    PendingMsgTable_t::EntryContainer_t::iterator it;
-    CBaseJob::Ptr &job = mPendingMsgTable.retrieveEntry(sn, it, found);
-    return found ? castToMessage<CFdbMessage *>(job) : 0;
+    auto pending = mPendingMsgTable.retrieve(sn);
+    return pending ? castToMessage<CFdbMessage *>(*pending) : 0;
+}
+
+void CFdbSession::addDeadline(FdbMsgSn_t sn, int32_t timeout)
+{
+    if (mDeadlines.size() > (2 * mPendingMsgTable.size() + FDB_DEADLINE_SLACK))
+    {
+        // drop deadlines of requests already replied
+        auto &table = mPendingMsgTable;
+        mDeadlines.erase(std::remove_if(mDeadlines.begin(), mDeadlines.end(),
+                                        [&table](const CDeadline &deadline)
+                                        {
+                                            return !table.retrieve(deadline.mSn);
+                                        }),
+                         mDeadlines.end());
+        std::make_heap(mDeadlines.begin(), mDeadlines.end());
+    }
+
+    auto now = sysdep_getsystemtime_milli();
+    CDeadline deadline;
+    deadline.mDue = now + timeout;
+    deadline.mSn = sn;
+    mDeadlines.push_back(deadline);
+    std::push_heap(mDeadlines.begin(), mDeadlines.end());
+    dropRepliedDeadlines();
+    if (!mDeadlines.empty())
+    {
+        scheduleDeadline(now, mDeadlines.front().mDue);
+    }
+}
+
+// pop deadlines of replied requests from the head so the timer isn't armed for them
+void CFdbSession::dropRepliedDeadlines()
+{
+    while (!mDeadlines.empty() && !mPendingMsgTable.retrieve(mDeadlines.front().mSn))
+    {
+        std::pop_heap(mDeadlines.begin(), mDeadlines.end());
+        mDeadlines.pop_back();
+    }
+}
+
+void CFdbSession::scheduleDeadline(uint64_t now, uint64_t due)
+{
+    if (mDeadlineDue && (mDeadlineDue <= due))
+    {
+        return;
+    }
+    if (!mDeadlineTimer)
+    {
+        mDeadlineTimer = new CDeadlineTimer(this);
+        mDeadlineTimer->attach(FDB_CONTEXT, false);
+    }
+    mDeadlineDue = due;
+    // interval of 0 is ignored by the timer
+    mDeadlineTimer->enableOneShot((due > now) ? (int32_t)(due - now) : 1);
+}
+
+void CFdbSession::onDeadlineTimer(CMethodLoopTimer<CFdbSession> *timer)
+{
+    mDeadlineDue = 0;
+    auto now = sysdep_getsystemtime_milli();
+    std::vector<FdbMsgSn_t> expired;
+    while (!mDeadlines.empty() && (mDeadlines.front().mDue <= now))
+    {
+        expired.push_back(mDeadlines.front().mSn);
+        std::pop_heap(mDeadlines.begin(), mDeadlines.end());
+        mDeadlines.pop_back();
+    }
+    dropRepliedDeadlines();
+    if (!mDeadlines.empty())
+    {
+        scheduleDeadline(now, mDeadlines.front().mDue);
+    }
+    for (auto it = expired.begin(); it != expired.end(); ++it)
+    {
+        terminateMessage(*it, NFdbBase::FDB_ST_TIMEOUT, "Message is destroyed due to timeout.");
+    }
 }
 
 void CFdbSession::securityLevel(int32_t level)
@@ -0,0 +1,363 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <common_base/CFdbSharedSubscription.h>
+#include <common_base/CFdbBaseObject.h>
+#include <common_base/CFdbSession.h>
+#include <common_base/CFdbSessionContainer.h>
+#include <common_base/CFdbSubscribeIndex.h>
+#include <common_base/CFdbMessage.h>
+#include <utils/Log.h>
+#include <string.h>
+
+bool CFdbSharedSubscription::onSubscribe(CFdbBaseObject *object, CFdbSession *session,
+                                         CFdbMessage *msg)
+{
+    if (msg->code() != FDB_CODE_SUBSCRIBE)
+    {
+        return true;
+    }
+    CFdbSocketInfo info;
+    info.mAddress = 0;
+    session->container()->getSocketInfo(info);
+    if (!info.mAddress)
+    {
+        return true;
+    }
+    auto remote = info.mAddress->mUrl + "#" + std::to_string(object->objId());
+    mObjectTable[object] = remote;
+    // left by remove() even if prepareDestroy() is not called
+    object->mFlag |= FDB_OBJ_SHARED_SUBSCRIBED;
+    auto &events = mRemoteTable[remote];
+
+    CFdbMsgSubscribeList wire_list;
+    bool shared = false;
+    const CFdbMsgSubscribeItem *sub_item;
+    FDB_BEGIN_FOREACH_SIGNAL(msg, sub_item)
+    {
+        auto code = sub_item->msg_code();
+        auto filter = std::make_pair(sub_item->has_filter() ? sub_item->filter() : std::string(),
+                                     sub_item->pattern());
+        auto &entry = events[code][filter];
+        if (!entry.mOwner || (entry.mOwner == object))
+        {
+            entry.mOwner = object;
+            entry.mItem = *sub_item;
+            *wire_list.add_subscribe_tbl() = *sub_item;
+        }
+        else if (sameOptions(entry.mItem, *sub_item) && !entry.mLastEventsDropped)
+        {
+            // replay last values just as server does for a new subscriber
+            entry.mFollowers.insert(object);
+            for (auto it = entry.mLastEvents.begin(); it != entry.mLastEvents.end(); ++it)
+            {
+                deliver(object, it->first.first, it->first.second, it->second, 0);
+            }
+            shared = true;
+        }
+        else
+        {
+            // can't share with different options or replay: subscribe from server
+            entry.mFollowers.erase(object);
+            *wire_list.add_subscribe_tbl() = *sub_item;
+        }
+    }
+    FDB_END_FOREACH_SIGNAL()
+
+    if (!shared)
+    {
+        return true;
+    }
+    if (!wire_list.subscribe_tbl().size())
+    {
+        // an empty list would mean something else to server
+        return false;
+    }
+    // only items not shared go to server
+    CFdbParcelableBuilder builder(wire_list);
+    if (!msg->serialize(builder, object))
+    {
+        LOG_E("CFdbSharedSubscription: unable to rebuild subscribe request!\n");
+    }
+    return true;
+}
+
+void CFdbSharedSubscription::onUnsubscribe(CFdbBaseObject *object, CFdbMessage *msg)
+{
+    auto it_object = mObjectTable.find(object);
+    if (it_object == mObjectTable.end())
+    {
+        return;
+    }
+    auto it_remote = mRemoteTable.find(it_object->second);
+    if (it_remote == mRemoteTable.end())
+    {
+        return;
+    }
+    bool empty = true;
+    const CFdbMsgSubscribeItem *sub_item;
+    FDB_BEGIN_FOREACH_SIGNAL(msg, sub_item)
+    {
+        empty = false;
+        auto filter = std::make_pair(sub_item->has_filter() ? sub_item->filter() : std::string(),
+                                     sub_item->pattern());
+        leave(it_remote->second, object, sub_item->msg_code(), filter);
+    }
+    FDB_END_FOREACH_SIGNAL()
+
+    if (empty)
+    {
+        // unsubscribe all
+        remove(object);
+    }
+    else if (it_remote->second.empty())
+    {
+        mRemoteTable.erase(it_remote);
+    }
+}
+
+void CFdbSharedSubscription::forward(CFdbBaseObject *owner, CBaseJob::Ptr &msg_ref)
+{
+    auto it_object = mObjectTable.find(owner);
+    if (it_object == mObjectTable.end())
+    {
+        return;
+    }
+    auto it_remote = mRemoteTable.find(it_object->second);
+    if (it_remote == mRemoteTable.end())
+    {
+        return;
+    }
+    auto msg = castToMessage<CFdbMessage *>(msg_ref);
+    auto &events = it_remote->second;
+    auto &topic = msg->topic();
+    // the server replays only cached events to new subscribers
+    bool cached = !!msg->eventVersion();
+    std::set<CFdbBaseObject *> followers;
+    CLastEvent event;
+    bool shared = false;
+    FdbMsgCode_t codes[] = {msg->code(), fdbMakeGroup(msg->code())};
+    for (uint32_t i = 0; i < sizeof(codes) / sizeof(codes[0]); ++i)
+    {
+        auto it_code = events.find(codes[i]);
+        if (it_code == events.end())
+        {
+            continue;
+        }
+        auto &entries = it_code->second;
+        for (auto it_entry = entries.begin(); it_entry != entries.end(); ++it_entry)
+        {
+            auto &entry = it_entry->second;
+            if ((entry.mOwner != owner) || !match(it_entry->first, topic))
+            {
+                continue;
+            }
+            bool keep = cached && !entry.mLastEventsDropped;
+            if (!keep && entry.mFollowers.empty())
+            {
+                continue;
+            }
+            if (!shared)
+            {
+                // the message might be part of a snapshot: copy the payload only
+                auto size = msg->getPayloadSize();
+                auto buffer = new uint8_t[CFdbMessage::maxReservedSize() + size];
+                if (size)
+                {
+                    memcpy(buffer + CFdbMessage::maxReservedSize(), msg->getPayloadBuffer(), size);
+                }
+                event.mBuffer.reset(buffer, std::default_delete<uint8_t[]>());
+                event.mOffset = CFdbMessage::maxReservedSize();
+                event.mSize = size;
+                event.mVersion = msg->eventVersion();
+                shared = true;
+            }
+            if (keep)
+            {
+                auto key = std::make_pair(msg->code(), topic);
+                if ((entry.mLastEvents.size() >= FDB_SHARED_SUBSCRIPTION_MAX_LAST_EVENTS) &&
+                    (entry.mLastEvents.find(key) == entry.mLastEvents.end()))
+                {
+                    entry.mLastEvents.clear();
+                    entry.mLastEventsDropped = true;
+                }
+                else
+                {
+                    entry.mLastEvents[key] = event;
+                }
+            }
+            followers.insert(entry.mFollowers.begin(), entry.mFollowers.end());
+        }
+    }
+    for (auto it = followers.begin(); it != followers.end(); ++it)
+    {
+        deliver(*it, msg->code(), topic, event, msg->mFlag);
+    }
+}
+
+void CFdbSharedSubscription::remove(CFdbBaseObject *object)
+{
+    object->mFlag &= ~FDB_OBJ_SHARED_SUBSCRIBED;
+    auto it_object = mObjectTable.find(object);
+    if (it_object == mObjectTable.end())
+    {
+        return;
+    }
+    auto it_remote = mRemoteTable.find(it_object->second);
+    mObjectTable.erase(it_object);
+    if (it_remote == mRemoteTable.end())
+    {
+        return;
+    }
+    auto &events = it_remote->second;
+    for (auto it_code = events.begin(); it_code != events.end();)
+    {
+        auto &entries = it_code->second;
+        for (auto it_entry = entries.begin(); it_entry != entries.end();)
+        {
+            auto &entry = it_entry->second;
+            if (entry.mOwner == object)
+            {
+                handOver(entry);
+            }
+            else
+            {
+                entry.mFollowers.erase(object);
+            }
+            if (entry.mOwner)
+            {
+                ++it_entry;
+            }
+            else
+            {
+                it_entry = entries.erase(it_entry);
+            }
+        }
+        if (entries.empty())
+        {
+            it_code = events.erase(it_code);
+        }
+        else
+        {
+            ++it_code;
+        }
+    }
+    if (events.empty())
+    {
+        mRemoteTable.erase(it_remote);
+    }
+}
+
+bool CFdbSharedSubscription::sameOptions(const CFdbMsgSubscribeItem &item1,
+                                         const CFdbMsgSubscribeItem &item2)
+{
+    auto type1 = item1.has_type() ? item1.type() : FDB_SUB_TYPE_NORMAL;
+    auto type2 = item2.has_type() ? item2.type() : FDB_SUB_TYPE_NORMAL;
+    if ((type1 != type2) || (item1.policy() != item2.policy()) ||
+        (item1.interval() != item2.interval()) ||
+        (item1.has_content_filter() != item2.has_content_filter()))
+    {
+        return false;
+    }
+    if (item1.has_content_filter())
+    {
+        std::string key1;
+        std::string key2;
+        item1.content_filter().toKey(key1);
+        item2.content_filter().toKey(key2);
+        return key1 == key2;
+    }
+    return true;
+}
+
+bool CFdbSharedSubscription::match(const std::pair<std::string, bool> &filter,
+                                   const std::string &topic)
+{
+    if (filter.second)
+    {
+        return CFdbSubscribeIndex::matchTopic(filter.first.c_str(), topic.c_str());
+    }
+    // "" represents any topic
+    return filter.first.empty() || (filter.first == topic);
+}
+
+void CFdbSharedSubscription::deliver(CFdbBaseObject *object, FdbMsgCode_t code,
+                                     const std::string &topic, const CLastEvent &event,
+                                     uint32_t flag)
+{
+    auto msg = new CFdbMessage(code, object, topic.c_str());
+    // full payload is rebuilt by the owner already
+    msg->mFlag |= flag & MSG_GLOBAL_FLAG_MASK & ~(MSG_FLAG_DELTA | MSG_FLAG_SNAPSHOT);
+    if (event.mBuffer)
+    {
+        msg->sharePayload(event.mBuffer, event.mOffset, event.mSize);
+    }
+    msg->eventVersion(event.mVersion);
+    CBaseJob::Ptr msg_ref(msg);
+    object->doSharedBroadcast(msg_ref);
+}
+
+void CFdbSharedSubscription::handOver(CEntry &entry)
+{
+    entry.mOwner = 0;
+    if (entry.mFollowers.empty())
+    {
+        return;
+    }
+    auto owner = *entry.mFollowers.begin();
+    entry.mFollowers.erase(entry.mFollowers.begin());
+    entry.mOwner = owner;
+    CFdbMsgSubscribeList msg_list;
+    *msg_list.add_subscribe_tbl() = entry.mItem;
+    if (!owner->subscribe(msg_list))
+    {
+        LOG_E("CFdbSharedSubscription: unable to hand over event %d topic %s!\n",
+              entry.mItem.msg_code(), entry.mItem.filter().c_str());
+    }
+}
+
+void CFdbSharedSubscription::leave(CodeTable_t &events, CFdbBaseObject *object, FdbMsgCode_t code,
+                                   const std::pair<std::string, bool> &filter)
+{
+    auto it_code = events.find(code);
+    if (it_code == events.end())
+    {
+        return;
+    }
+    auto &entries = it_code->second;
+    auto it_entry = entries.find(filter);
+    if (it_entry == entries.end())
+    {
+        return;
+    }
+    auto &entry = it_entry->second;
+    if (entry.mOwner == object)
+    {
+        handOver(entry);
+    }
+    else
+    {
+        entry.mFollowers.erase(object);
+    }
+    if (!entry.mOwner)
+    {
+        entries.erase(it_entry);
+        if (entries.empty())
+        {
+            events.erase(it_code);
+        }
+    }
+}
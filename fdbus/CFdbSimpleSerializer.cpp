@@ -79,6 +79,14 @@ void CFdbSimpleSerializer::reset()
     }
 }
 
+uint8_t *CFdbSimpleSerializer::reserve(int32_t size)
+{
+    addMemory(size);
+    uint8_t *p = mBuffer + mPos;
+    mPos += size;
+    return p;
+}
+
 void CFdbSimpleSerializer::addString(const char *string, fdb_string_len_t str_len)
 {
     fdb_string_len_t l = str_len + 1;
@@ -141,9 +149,9 @@ void CFdbSimpleSerializer::addBasicType(const uint8_t *p_data, int32_t size)
 void CFdbSimpleSerializer::addRawData(const uint8_t *p_data, int32_t size)
 {
     addMemory(size);
-    for (int32_t i = 0; i < size; ++i)
+    if (size)
     {
-        mBuffer[mPos + i] = p_data[i];
+        memcpy(mBuffer + mPos, p_data, size);
     }
     mPos += size;
 }
@@ -232,3 +240,19 @@ bool CFdbSimpleDeserializer::retrieveRawData(uint8_t *p_data, int32_t size)
     return true;
 }
 
+const uint8_t *CFdbSimpleDeserializer::retrieveView(int32_t size)
+{
+    if (mError)
+    {
+        return 0;
+    }
+    if ((size < 0) || (mSize && ((mPos + size) > mSize)))
+    {
+        mError = true;
+        return 0;
+    }
+
+    const uint8_t *data = mBuffer + mPos;
+    mPos += size;
+    return data;
+}
@@ -0,0 +1,557 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <common_base/CFdbSubscribeIndex.h>
+
+CFdbSubscribeIndex::CFdbSubscribeIndex()
+    : mStamp(0)
+    , mBusy(0)
+{
+}
+
+CFdbSubscribeIndex::~CFdbSubscribeIndex()
+{
+    // including dead targets not purged yet
+    for (auto it_entry = mCodeTable.begin(); it_entry != mCodeTable.end(); ++it_entry)
+    {
+        auto &sessions = it_entry->second.mSessionTable;
+        for (auto it_objects = sessions.begin(); it_objects != sessions.end(); ++it_objects)
+        {
+            auto &objects = it_objects->second;
+            for (auto it_subscriber = objects.begin(); it_subscriber != objects.end(); ++it_subscriber)
+            {
+                auto &targets = it_subscriber->second.mTargets;
+                for (auto it_target = targets.begin(); it_target != targets.end(); ++it_target)
+                {
+                    delete it_target->second.mDelivery;
+                }
+                auto &patterns = it_subscriber->second.mPatterns;
+                for (auto it_target = patterns.begin(); it_target != patterns.end(); ++it_target)
+                {
+                    delete it_target->second.mDelivery;
+                }
+            }
+        }
+    }
+}
+
+CFdbSubscribeIndex::CTopicNode::~CTopicNode()
+{
+    for (auto it = mChildren.begin(); it != mChildren.end(); ++it)
+    {
+        delete it->second;
+    }
+    delete mAnyChild;
+}
+
+void CFdbSubscribeIndex::subscribe(FdbMsgCode_t code, CFdbSession *session, FdbObjectId_t obj_id,
+                                   const char *topic, CFdbSubscribeType type, bool pattern,
+                                   const CFdbContentFilter *content,
+                                   CFdbDeliveryPolicy policy, uint32_t interval, bool delta)
+{
+    if (!topic)
+    {
+        topic = "";
+    }
+
+    auto &entry = mCodeTable[code];
+    auto &objects = entry.mSessionTable[session];
+    auto it_subscriber = objects.find(obj_id);
+    if (it_subscriber == objects.end())
+    {
+        it_subscriber = objects.insert(std::make_pair(obj_id, CSubscriber())).first;
+        auto &subscriber = it_subscriber->second;
+        subscriber.mCode = code;
+        subscriber.mSession = session;
+        subscriber.mObjId = obj_id;
+        subscriber.mStamp = 0;
+        indexSubscriber(&subscriber);
+    }
+    auto &subscriber = it_subscriber->second;
+
+    auto &subscribed = pattern ? subscriber.mPatterns : subscriber.mTargets;
+    auto it_target = subscribed.find(topic);
+    if (it_target != subscribed.end())
+    {
+        // already subscribed (or removed during broadcasting): just update
+        auto &target = it_target->second;
+        target.mType = type;
+        target.mDead = false;
+        setFilter(target, content);
+        setDelivery(target, policy, interval, delta);
+        return;
+    }
+
+    it_target = subscribed.insert(std::make_pair(std::string(topic), CTarget())).first;
+    auto &target = it_target->second;
+    target.mSubscriber = &subscriber;
+    target.mTopic = &it_target->first;
+    target.mType = type;
+    target.mDead = false;
+    target.mPendingPurge = false;
+    target.mPattern = pattern;
+    target.mNode = 0;
+    target.mFilter = 0;
+    setFilter(target, content);
+    target.mDelivery = 0;
+    setDelivery(target, policy, interval, delta);
+
+    auto &targets = pattern ? addPattern(&entry.mPatternTree, topic, target.mNode)
+                            : ((topic[0] == '\0') ? entry.mWildcardList : entry.mTopicTable[topic]);
+    target.mList = &targets;
+    target.mPos = (uint32_t)targets.size();
+    targets.push_back(&target);
+}
+
+void CFdbSubscribeIndex::unsubscribe(FdbMsgCode_t code, CFdbSession *session,
+                                     FdbObjectId_t obj_id, const char *topic, bool pattern)
+{
+    auto it_entry = mCodeTable.find(code);
+    if (it_entry == mCodeTable.end())
+    {
+        return;
+    }
+    auto &sessions = it_entry->second.mSessionTable;
+    auto it_objects = sessions.find(session);
+    if (it_objects == sessions.end())
+    {
+        return;
+    }
+    auto &objects = it_objects->second;
+    auto it_subscriber = objects.find(obj_id);
+    if (it_subscriber == objects.end())
+    {
+        return;
+    }
+
+    auto &subscriber = it_subscriber->second;
+    if (topic)
+    {
+        auto &subscribed = pattern ? subscriber.mPatterns : subscriber.mTargets;
+        auto it_target = subscribed.find(topic);
+        if (it_target != subscribed.end())
+        {
+            removeTarget(&it_target->second);
+        }
+    }
+    else
+    {
+        removeSubscriber(subscriber);
+    }
+}
+
+void CFdbSubscribeIndex::unsubscribe(CFdbSession *session)
+{
+    auto it = mSessionIndex.find(session);
+    if (it != mSessionIndex.end())
+    {
+        removeSubscribers(it->second);
+    }
+}
+
+void CFdbSubscribeIndex::unsubscribe(FdbObjectId_t obj_id)
+{
+    auto it = mObjectIndex.find(obj_id);
+    if (it != mObjectIndex.end())
+    {
+        removeSubscribers(it->second);
+    }
+}
+
+CFdbSubscribeIndex::CTarget *CFdbSubscribeIndex::findTarget(FdbMsgCode_t code, CFdbSession *session,
+                                                            FdbObjectId_t obj_id, const char *topic,
+                                                            const uint8_t *payload, int32_t size)
+{
+    auto it_entry = mCodeTable.find(code);
+    if (it_entry == mCodeTable.end())
+    {
+        return 0;
+    }
+    auto &sessions = it_entry->second.mSessionTable;
+    auto it_objects = sessions.find(session);
+    if (it_objects == sessions.end())
+    {
+        return 0;
+    }
+    auto &objects = it_objects->second;
+    auto it_subscriber = objects.find(obj_id);
+    if (it_subscriber == objects.end())
+    {
+        return 0;
+    }
+
+    if (!topic)
+    {
+        topic = "";
+    }
+    CMatch match(newStamp(), payload, size);
+    auto &targets = it_subscriber->second.mTargets;
+    auto it_target = targets.find(topic);
+    if ((it_target != targets.end()) && deliverable(&it_target->second, match))
+    {
+        return &it_target->second;
+    }
+    auto &patterns = it_subscriber->second.mPatterns;
+    for (it_target = patterns.begin(); it_target != patterns.end(); ++it_target)
+    {
+        if (matchTopic(it_target->first.c_str(), topic) && deliverable(&it_target->second, match))
+        {
+            return &it_target->second;
+        }
+    }
+    if (topic[0] != '\0')
+    {
+        // If filter doesn't match, check who registers filter "". It represents any filter.
+        it_target = targets.find("");
+        if ((it_target != targets.end()) && deliverable(&it_target->second, match))
+        {
+            return &it_target->second;
+        }
+    }
+    return 0;
+}
+
+void CFdbSubscribeIndex::removeSubscriber(CSubscriber &subscriber)
+{
+    // the subscriber is gone when the last target is deleted
+    std::vector<CTarget *> targets;
+    for (auto it = subscriber.mTargets.begin(); it != subscriber.mTargets.end(); ++it)
+    {
+        targets.push_back(&it->second);
+    }
+    for (auto it = subscriber.mPatterns.begin(); it != subscriber.mPatterns.end(); ++it)
+    {
+        targets.push_back(&it->second);
+    }
+    for (auto it = targets.begin(); it != targets.end(); ++it)
+    {
+        removeTarget(*it);
+    }
+}
+
+void CFdbSubscribeIndex::removeSubscribers(SubscriberSet_t &subscribers)
+{
+    // the set is modified when the subscribers are deleted: take a copy
+    std::vector<CSubscriber *> to_remove(subscribers.begin(), subscribers.end());
+    for (auto it = to_remove.begin(); it != to_remove.end(); ++it)
+    {
+        removeSubscriber(**it);
+    }
+}
+
+void CFdbSubscribeIndex::indexSubscriber(CSubscriber *subscriber)
+{
+    mSessionIndex[subscriber->mSession].insert(subscriber);
+    mObjectIndex[subscriber->mObjId].insert(subscriber);
+}
+
+void CFdbSubscribeIndex::unindexSubscriber(CSubscriber *subscriber)
+{
+    auto it_session = mSessionIndex.find(subscriber->mSession);
+    if (it_session != mSessionIndex.end())
+    {
+        it_session->second.erase(subscriber);
+        if (it_session->second.empty())
+        {
+            mSessionIndex.erase(it_session);
+        }
+    }
+    auto it_object = mObjectIndex.find(subscriber->mObjId);
+    if (it_object != mObjectIndex.end())
+    {
+        it_object->second.erase(subscriber);
+        if (it_object->second.empty())
+        {
+            mObjectIndex.erase(it_object);
+        }
+    }
+}
+
+void CFdbSubscribeIndex::removeTarget(CTarget *target)
+{
+    if (mBusy)
+    {
+        target->mDead = true;
+        if (!target->mPendingPurge)
+        {
+            target->mPendingPurge = true;
+            mGarbage.push_back(target);
+        }
+        return;
+    }
+    deleteTarget(target);
+}
+
+void CFdbSubscribeIndex::deleteTarget(CTarget *target)
+{
+    auto subscriber = target->mSubscriber;
+    auto code = subscriber->mCode;
+    auto session = subscriber->mSession;
+    auto obj_id = subscriber->mObjId;
+    std::string topic = *target->mTopic;
+
+    auto it_entry = mCodeTable.find(code);
+    if (it_entry == mCodeTable.end())
+    {
+        return;
+    }
+    auto &entry = it_entry->second;
+
+    // swap with the last one and remove from the list
+    auto &targets = *target->mList;
+    auto last = targets.back();
+    targets[target->mPos] = last;
+    last->mPos = target->mPos;
+    targets.pop_back();
+    setFilter(*target, 0);
+    setDelivery(*target, FDB_DELIVER_FULL, 0);
+    if (target->mPattern)
+    {
+        prunePattern(target->mNode);
+        subscriber->mPatterns.erase(topic);
+    }
+    else
+    {
+        if (targets.empty() && !topic.empty())
+        {
+            entry.mTopicTable.erase(topic);
+        }
+        subscriber->mTargets.erase(topic);
+    }
+    if (!subscriber->mTargets.empty() || !subscriber->mPatterns.empty())
+    {
+        return;
+    }
+    unindexSubscriber(subscriber);
+    auto it_objects = entry.mSessionTable.find(session);
+    auto &objects = it_objects->second;
+    objects.erase(obj_id);
+    if (!objects.empty())
+    {
+        return;
+    }
+    entry.mSessionTable.erase(it_objects);
+    if (entry.mSessionTable.empty())
+    {
+        mCodeTable.erase(it_entry);
+    }
+}
+
+void CFdbSubscribeIndex::purge()
+{
+    if (mBusy || mGarbage.empty())
+    {
+        return;
+    }
+    std::vector<CTarget *> garbage;
+    garbage.swap(mGarbage);
+    for (auto it = garbage.begin(); it != garbage.end(); ++it)
+    {
+        auto target = *it;
+        target->mPendingPurge = false;
+        if (target->mDead)
+        {
+            deleteTarget(target);
+        }
+    }
+}
+
+CFdbSubscribeIndex::TargetList_t &CFdbSubscribeIndex::addPattern(CTopicNode *root, const char *pattern,
+                                                                 CTopicNode *&node)
+{
+    node = root;
+    while (true)
+    {
+        auto end = strchr(pattern, '/');
+        auto len = end ? (uint32_t)(end - pattern) : (uint32_t)strlen(pattern);
+        if (!end && (len == 1) && (pattern[0] == '#'))
+        {
+            return node->mTailTargets;
+        }
+
+        CTopicNode *child;
+        if ((len == 1) && (pattern[0] == '*'))
+        {
+            if (!node->mAnyChild)
+            {
+                node->mAnyChild = new CTopicNode(node, pattern, len);
+            }
+            child = node->mAnyChild;
+        }
+        else
+        {
+            auto &the_child = node->mChildren[std::string(pattern, len)];
+            if (!the_child)
+            {
+                the_child = new CTopicNode(node, pattern, len);
+            }
+            child = the_child;
+        }
+        node = child;
+
+        if (!end)
+        {
+            return node->mTargets;
+        }
+        pattern = end + 1;
+    }
+}
+
+void CFdbSubscribeIndex::prunePattern(CTopicNode *node)
+{
+    while (node->mParent && node->empty())
+    {
+        auto parent = node->mParent;
+        if (parent->mAnyChild == node)
+        {
+            parent->mAnyChild = 0;
+        }
+        else
+        {
+            parent->mChildren.erase(node->mSegment);
+        }
+        delete node;
+        node = parent;
+    }
+}
+
+bool CFdbSubscribeIndex::matchTopic(const char *pattern, const char *topic)
+{
+    while (true)
+    {
+        auto p_end = strchr(pattern, '/');
+        auto p_len = p_end ? (size_t)(p_end - pattern) : strlen(pattern);
+        if (!p_end && (p_len == 1) && (pattern[0] == '#'))
+        {
+            return true;
+        }
+        auto t_end = strchr(topic, '/');
+        auto t_len = t_end ? (size_t)(t_end - topic) : strlen(topic);
+        if (!((p_len == 1) && (pattern[0] == '*')) &&
+            ((p_len != t_len) || memcmp(pattern, topic, p_len)))
+        {
+            return false;
+        }
+        if (!p_end || !t_end)
+        {
+            if (!p_end && !t_end)
+            {
+                return true;
+            }
+            // "a/#" also matches "a"
+            return p_end && !strcmp(p_end + 1, "#");
+        }
+        pattern = p_end + 1;
+        topic = t_end + 1;
+    }
+}
+
+void CFdbSubscribeIndex::setFilter(CTarget &target, const CFdbContentFilter *content)
+{
+    CFilter *filter = 0;
+    if (content)
+    {
+        std::string key;
+        content->toKey(key);
+        auto it_filter = mFilterTable.find(key);
+        if (it_filter == mFilterTable.end())
+        {
+            it_filter = mFilterTable.insert(std::make_pair(key, CFilter())).first;
+            filter = &it_filter->second;
+            filter->mContent = *content;
+            filter->mKey = &it_filter->first;
+            filter->mRef = 0;
+            filter->mStamp = 0;
+            filter->mMatched = false;
+        }
+        filter = &it_filter->second;
+        filter->mRef++;
+    }
+
+    if (target.mFilter && (--target.mFilter->mRef == 0))
+    {
+        mFilterTable.erase(mFilterTable.find(*target.mFilter->mKey));
+    }
+    target.mFilter = filter;
+}
+
+void CFdbSubscribeIndex::setDelivery(CTarget &target, CFdbDeliveryPolicy policy, uint32_t interval,
+                                     bool delta)
+{
+    if ((policy == FDB_DELIVER_FULL) && !delta)
+    {
+        if (target.mDelivery)
+        {
+            mPendingTargets.erase(&target);
+            clearStates(*target.mDelivery);
+            delete target.mDelivery;
+            target.mDelivery = 0;
+        }
+        return;
+    }
+
+    if (!target.mDelivery)
+    {
+        target.mDelivery = new CDelivery();
+    }
+    else if (target.mDelivery->mPolicy != policy)
+    {
+        // conflated broadcasts are dropped
+        mPendingTargets.erase(&target);
+        clearStates(*target.mDelivery);
+    }
+    target.mDelivery->mPolicy = policy;
+    target.mDelivery->mInterval = interval;
+    target.mDelivery->mDelta = delta;
+}
+
+void CFdbSubscribeIndex::clearStates(CDelivery &delivery)
+{
+    for (auto it = delivery.mStates.begin(); it != delivery.mStates.end(); ++it)
+    {
+        auto it_topic = mTopicPool.find(*it->first.mTopic);
+        if (--it_topic->second == 0)
+        {
+            mTopicPool.erase(it_topic);
+        }
+    }
+    delivery.mStates.clear();
+}
+
+CFdbSubscribeIndex::CDeliveryState &CFdbSubscribeIndex::deliveryState(CTarget &target,
+                                                                       FdbMsgCode_t code,
+                                                                       const std::string &topic)
+{
+    auto &states = target.mDelivery->mStates;
+    auto it_topic = mTopicPool.find(topic);
+    if (it_topic == mTopicPool.end())
+    {
+        it_topic = mTopicPool.insert(std::make_pair(topic, 0)).first;
+    }
+    else
+    {
+        auto it_state = states.find(CStateKey(code, &it_topic->first));
+        if (it_state != states.end())
+        {
+            return it_state->second;
+        }
+    }
+    it_topic->second++;
+    auto &state = states[CStateKey(code, &it_topic->first)];
+    state.mCode = code;
+    state.mTopic = &it_topic->first;
+    return state;
+}
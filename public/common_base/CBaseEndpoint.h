@@ -19,6 +19,7 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include "common_defs.h"
 #include "CEntityContainer.h"
 #include "CFdbBaseObject.h"
@@ -66,6 +67,31 @@ public:
 
     void prepareDestroy();
 
+    /*
+     * Configure handling of slow peers. A peer becomes slow once more
+     * than @max_bytes are waiting in its outbound queue or the oldest
+     * queued message is older than @max_age ms (0 disables the check).
+     * Broadcasts to a slow peer are then handled according to @policy.
+     */
+    void setSlowPeerPolicy(CFdbSlowPolicy policy, uint32_t max_bytes, uint32_t max_age = 0)
+    {
+        mSlowPolicy = policy;
+        mSlowMaxBytes = max_bytes;
+        mSlowMaxAge = max_age;
+    }
+    CFdbSlowPolicy slowPeerPolicy() const
+    {
+        return mSlowPolicy;
+    }
+    uint32_t slowPeerMaxBytes() const
+    {
+        return mSlowMaxBytes;
+    }
+    uint32_t slowPeerMaxAge() const
+    {
+        return mSlowMaxAge;
+    }
+
 protected:
     std::string mNsName;
 
@@ -86,6 +112,7 @@ protected:
 
 private:
     typedef CEntityContainer<FdbObjectId_t, CFdbBaseObject *> tObjectContainer;
+    typedef std::unordered_map<FdbObjectId_t, CFdbBaseObject *> tObjectIndex;
     
     CFdbSession *preferredPeer();
     void checkAutoRemove();
@@ -108,11 +135,17 @@ private:
     void updateSecurityLevel();
 
     tObjectContainer mObjectContainer;
+    // to dispatch messages: objects by id and server objects by class
+    tObjectIndex mObjectIdIndex;
+    tObjectIndex mServerClassIndex;
 
     uint32_t mSessionCnt;
     FdbObjectId_t mSnAllocator;
     CFdbToken::tTokenList mTokens;
     FdbEndpointId_t mEpid;
+    CFdbSlowPolicy mSlowPolicy;
+    uint32_t mSlowMaxBytes;
+    uint32_t mSlowMaxAge;
 
     friend class CFdbSession;
     friend class CFdbMessage;
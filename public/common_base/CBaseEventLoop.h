@@ -17,7 +17,7 @@
 #ifndef _CBASEEVENTLOOP_H_
 #define _CBASEEVENTLOOP_H_
 
-#include <list>
+#include <vector>
 #include <set>
 #include <mutex>
 
@@ -51,19 +51,36 @@ public:
 
 protected:
     int32_t getMostRecentTime();
+    // expiration of the earliest enabled timer; false if no timer is enabled
+    bool getMostRecentExpiration(uint64_t &expiration);
     void processTimers();
     std::mutex mMutex;
     
 #define LOOP_DEFAULT_INTERVAL       20
+#define LOOP_TIMER_HEAP_ARITY       4
 private:
-    typedef std::list< CSysLoopTimer *> tLoopTimerList;
+    typedef std::vector< CSysLoopTimer *> tLoopTimerList;
     typedef std::set<CSysLoopTimer *> tTimerTbl;
 
-    tLoopTimerList mTimerList;
-    tLoopTimerList mTimerWorkingList;
+    tTimerTbl mTimerList;
+    /*
+     * Enabled timers in a 4-ary min-heap ordered by expiration; each timer
+     * knows its position so that it is removed without searching.
+     */
+    tLoopTimerList mTimerHeap;
+    // storage reused by processTimers() for expired timers
+    tLoopTimerList mExpiredTimers;
+    uint64_t mTimerSequence;
     tTimerTbl mTimerBlackList;
     int32_t mTimerRecursiveCnt;
 
+    void pushTimer(CSysLoopTimer *timer);
+    void eraseTimer(CSysLoopTimer *timer);
+    void placeTimer(uint32_t index, CSysLoopTimer *timer);
+    void siftUp(uint32_t index);
+    void siftDown(uint32_t index);
+    static bool timerBefore(CSysLoopTimer *timer1, CSysLoopTimer *timer2);
+
     bool timerDestroyed(CSysLoopTimer *timer);
     void addTimerToBlacklist(CSysLoopTimer *timer);
     void uninstallTimers();
@@ -79,6 +79,7 @@ protected:
     void onSidebandInvoke(CBaseJob::Ptr &msg_ref);
     bool onMessageAuthentication(CFdbMessage *msg, CFdbSession *session);
     bool onEventAuthentication(CFdbMessage *msg, CFdbSession *session);
+    int32_t eventSecurityLevel(FdbMsgCode_t code);
 
     bool publishNoQueue(FdbMsgCode_t code, const char *topic, const void *buffer,
                         int32_t size, CFdbSession *session);
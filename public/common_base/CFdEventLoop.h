@@ -26,6 +26,7 @@
 
 class CSysFdWatch;
 class CNotifyFdWatch;
+class CTimerFdWatch;
 class CFdEventLoop : public CBaseEventLoop
 {
 public:
@@ -54,6 +55,14 @@ private:
     CNotifyFdWatch *mNotifyWatch;
     CEventFd mEventFd;
     bool mRebuildPollFd;
+    /*
+     * timerfd armed to the earliest timer (Linux only), so that poll()
+     * waits without timeout and timers don't depend on rounding of poll
+     * timeout; timeout of poll() is used if it is not available.
+     */
+    CTimerFdWatch *mTimerWatch;
+    uint64_t mArmedExpiration;
+    bool mTimerArmed;
     
     bool watchDestroyed(CSysFdWatch *watch);
     void addWatchToBlacklist(CSysFdWatch *watch);
@@ -68,6 +77,7 @@ private:
     bool registerWatch(CSysFdWatch *watch, bool enable);
     bool enableWatch(CSysFdWatch *watch, bool enable);
     bool addWatchToList(tCFdWatchList &wlist, CSysFdWatch *watch, bool enable);
+    bool armTimerFd();
     void rebuildPollFd()
     {
 	mRebuildPollFd = true;
@@ -75,6 +85,7 @@ private:
 
     friend CSysFdWatch;
     friend CNotifyFdWatch;
+    friend CTimerFdWatch;
 };
 
 #endif
@@ -20,6 +20,11 @@
 #include <common_base/IFdbMsgBuilder.h>
 struct cJSON;
 
+/*
+ * Print cJSON tree (unformatted) straight into message buffer: build()
+ * runs a sizing pass without printing, and toBuffer() prints into the
+ * buffer allocated for the message. No temporary string is allocated.
+ */
 class CFdbCJsonMsgBuilder : public IFdbMsgBuilder
 {
 public:
@@ -31,7 +36,6 @@ public:
     
 private:
     const cJSON *mMessage;
-    const char *mJson;
     int32_t mSize;
 };
 
@@ -48,4 +52,106 @@ private:
     cJSON *mMessage;
 };
 
+// a JSON value located inside the payload by CFdbJsonFieldParser
+class CFdbJsonValue
+{
+public:
+    enum eType
+    {
+        JSON_INVALID,
+        JSON_NULL,
+        JSON_FALSE,
+        JSON_TRUE,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT
+    };
+
+    CFdbJsonValue()
+        : mType(JSON_INVALID)
+        , mText(0)
+        , mSize(0)
+    {}
+
+    eType type() const
+    {
+        return mType;
+    }
+    /*
+     * Text of the value in payload. For string, it is the content between
+     * quotes with escape sequences kept as they are; for others it is the
+     * whole value including brackets.
+     */
+    const char *text() const
+    {
+        return mText;
+    }
+    int32_t size() const
+    {
+        return mSize;
+    }
+    bool toInt(int64_t &value) const;
+    bool toDouble(double &value) const;
+    bool toBool(bool &value) const;
+    // unescape string value into @value
+    bool toString(std::string &value) const;
+    // compare string value with @str without unescaping
+    bool equals(const char *str) const;
+
+private:
+    eType mType;
+    const char *mText;
+    int32_t mSize;
+
+    friend class CFdbJsonFieldParser;
+};
+
+/*
+ * Non-allocating reader of JSON object in payload: no DOM is built;
+ * members are scanned in place and only the values asked for are
+ * converted. It is used where only a few known fields should be read
+ * out of JSON payload:
+ *     CFdbJsonFieldParser parser;
+ *     int64_t id;
+ *     if (msg->deserialize(parser) && parser.getInt("id", id)) ...
+ * Or members can be streamed one by one:
+ *     CFdbJsonFieldParser::CIterator it(parser);
+ *     CFdbJsonValue key, value;
+ *     while (it.next(key, value)) ...
+ */
+class CFdbJsonFieldParser : public IFdbMsgParser
+{
+public:
+    class CIterator
+    {
+    public:
+        CIterator(const CFdbJsonFieldParser &parser);
+        // get next member of the object; return false at the end or on error
+        bool next(CFdbJsonValue &key, CFdbJsonValue &value);
+    private:
+        const char *mPos;
+        const char *mEnd;
+        bool mFirst;
+    };
+
+    CFdbJsonFieldParser();
+    bool parse(const uint8_t *buffer, int32_t size);
+    // find top-level member @key of the object
+    bool find(const char *key, CFdbJsonValue &value) const;
+    bool getInt(const char *key, int64_t &value) const;
+    bool getDouble(const char *key, double &value) const;
+    bool getBool(const char *key, bool &value) const;
+    bool getString(const char *key, std::string &value) const;
+    // view of nested object @key
+    bool getObject(const char *key, CFdbJsonFieldParser &object) const;
+
+private:
+    const char *mBegin;
+    const char *mEnd;
+
+    static const char *skipSpace(const char *pos, const char *end);
+    static const char *scanValue(const char *pos, const char *end, CFdbJsonValue &value);
+};
+
 #endif
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CFDBCONTENTFILTER_H__
+#define __CFDBCONTENTFILTER_H__
+
+#include <string>
+#include "CFdbSimpleSerializer.h"
+
+/*
+ * Predicate over a scalar field of broadcast payload, carried by
+ * subscribe request and evaluated by server before sending, so that the
+ * event is only sent to subscribers interested in its value:
+ *     <field> <operator> <value>
+ * Field is located either at byte offset of payload (for leading scalars
+ * of simple-serializer payload, or any fixed layout), or at slot of flat
+ * message (see CFdbFlatMsgBuilder.h). Payload not having the field never
+ * matches.
+ *
+ * Example: only get the event when speed (double at flat slot 1) is
+ * greater than 120:
+ *     CFdbContentFilter::onFlat<double>(1, CFdbContentFilter::OP_GT, 120.0)
+ */
+class CFdbContentFilter : public IFdbParcelable
+{
+public:
+    enum eLayout
+    {
+        LAYOUT_RAW,
+        LAYOUT_FLAT
+    };
+
+    enum eType
+    {
+        TYPE_INT8,
+        TYPE_UINT8,
+        TYPE_INT16,
+        TYPE_UINT16,
+        TYPE_INT32,
+        TYPE_UINT32,
+        TYPE_INT64,
+        TYPE_UINT64,
+        TYPE_FLOAT,
+        TYPE_DOUBLE,
+        TYPE_BOOL
+    };
+
+    enum eOperator
+    {
+        OP_EQ,
+        OP_NE,
+        OP_LT,
+        OP_LE,
+        OP_GT,
+        OP_GE
+    };
+
+    CFdbContentFilter()
+        : mLayout(LAYOUT_RAW)
+        , mType(TYPE_INT32)
+        , mOperator(OP_EQ)
+        , mLocation(0)
+        , mIntValue(0)
+        , mFloatValue(0)
+    {}
+
+    // field of type T at byte offset of payload
+    template <typename T>
+    static CFdbContentFilter onRaw(uint32_t offset, eOperator op, T value)
+    {
+        CFdbContentFilter filter;
+        filter.set(LAYOUT_RAW, offset, op, value);
+        return filter;
+    }
+
+    // field of type T at slot of flat message
+    template <typename T>
+    static CFdbContentFilter onFlat(uint16_t slot, eOperator op, T value)
+    {
+        CFdbContentFilter filter;
+        filter.set(LAYOUT_FLAT, slot, op, value);
+        return filter;
+    }
+
+    bool match(const uint8_t *payload, int32_t size) const;
+
+    // compact binary form; equal predicates have equal keys
+    void toKey(std::string &key) const;
+
+    void serialize(CFdbSimpleSerializer &serializer) const;
+    void deserialize(CFdbSimpleDeserializer &deserializer);
+
+protected:
+    void toString(std::ostringstream &stream) const;
+
+private:
+    uint8_t mLayout;
+    uint8_t mType;
+    uint8_t mOperator;
+    uint32_t mLocation;
+    int64_t mIntValue;
+    double mFloatValue;
+
+    bool isFloat() const
+    {
+        return (mType == TYPE_FLOAT) || (mType == TYPE_DOUBLE);
+    }
+    int32_t typeSize() const;
+
+    template <typename T>
+    void set(eLayout layout, uint32_t location, eOperator op, T value);
+};
+
+template <typename T> struct CFdbContentType;
+#define FDB_CONTENT_TYPE(_T, _type, _is_float) \
+template <> struct CFdbContentType<_T> \
+{ \
+    static const CFdbContentFilter::eType mType = CFdbContentFilter::_type; \
+    static const bool mIsFloat = _is_float; \
+};
+
+FDB_CONTENT_TYPE(int8_t, TYPE_INT8, false)
+FDB_CONTENT_TYPE(uint8_t, TYPE_UINT8, false)
+FDB_CONTENT_TYPE(int16_t, TYPE_INT16, false)
+FDB_CONTENT_TYPE(uint16_t, TYPE_UINT16, false)
+FDB_CONTENT_TYPE(int32_t, TYPE_INT32, false)
+FDB_CONTENT_TYPE(uint32_t, TYPE_UINT32, false)
+FDB_CONTENT_TYPE(int64_t, TYPE_INT64, false)
+FDB_CONTENT_TYPE(uint64_t, TYPE_UINT64, false)
+FDB_CONTENT_TYPE(float, TYPE_FLOAT, true)
+FDB_CONTENT_TYPE(double, TYPE_DOUBLE, true)
+FDB_CONTENT_TYPE(bool, TYPE_BOOL, false)
+
+template <typename T>
+void CFdbContentFilter::set(eLayout layout, uint32_t location, eOperator op, T value)
+{
+    mLayout = (uint8_t)layout;
+    mType = (uint8_t)CFdbContentType<T>::mType;
+    mOperator = (uint8_t)op;
+    mLocation = location;
+    if (CFdbContentType<T>::mIsFloat)
+    {
+        mFloatValue = (double)value;
+    }
+    else
+    {
+        mIntValue = (int64_t)value;
+    }
+}
+
+#endif
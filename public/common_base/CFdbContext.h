@@ -18,8 +18,10 @@
 #define _CFDBCONTEXT_H_
 
 #include <vector>
+#include <string>
+#include <unordered_map>
 #include "common_defs.h"
-#include "CEntityContainer.h"
+#include "CFdbHandleTable.h"
 #include "CBaseWorker.h"
 #include "CMethodJob.h"
 #include "CFdbSessionContainer.h"
@@ -31,6 +33,7 @@ class CBaseServer;
 class CFdbSession;
 class CIntraNameProxy;
 class CLogProducer;
+class CFdbSharedSubscription;
 
 class CFdbContext : public CBaseWorker
 {
@@ -60,29 +63,40 @@ public:
     void deleteSession(CFdbSessionContainer *container);
     FdbEndpointId_t registerEndpoint(CBaseEndpoint *endpoint);
     void unregisterEndpoint(CBaseEndpoint *endpoint);
+    // name of @endpoint is changed from @old_name
+    void renameEndpoint(CBaseEndpoint *endpoint, const std::string &old_name);
     CIntraNameProxy *getNameProxy();
     void reconnectOnNsConnected();
     void enableNameProxy(bool enable);
     void enableLogger(bool enable);
     CLogProducer *getLogger();
+    CFdbSharedSubscription *getSharedSubscription()
+    {
+        return mSharedSubscription;
+    }
 
 protected:
     bool asyncReady();
     
 private:
-    typedef CEntityContainer<FdbEndpointId_t, CBaseEndpoint *> tEndpointContainer;
-    typedef CEntityContainer<FdbSessionId_t, CFdbSession *> tSessionContainer;
+    typedef CFdbHandleTable<FdbEndpointId_t, CBaseEndpoint *, 12> tEndpointContainer;
+    typedef CFdbHandleTable<FdbSessionId_t, CFdbSession *, 20> tSessionContainer;
+    // name server name -> endpoints (both server and client)
+    typedef std::unordered_map<std::string, std::vector<CBaseEndpoint *> > tEndpointNameTable;
 
     tEndpointContainer mEndpointContainer;
     tSessionContainer mSessionContainer;
+    tEndpointNameTable mEndpointNameTable;
     CIntraNameProxy *mNameProxy;
     CLogProducer *mLogger;
+    CFdbSharedSubscription *mSharedSubscription;
 
     bool mEnableNameProxy;
     bool mEnableLogger;
 
     CFdbContext();
-    ~CFdbContext() {}
+    ~CFdbContext();
+    void removeEndpointName(CBaseEndpoint *endpoint, const std::string &name);
 
     static CFdbContext *mInstance;
 };
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CFDBFIXEDPARCELABLE_H__
+#define __CFDBFIXEDPARCELABLE_H__
+
+#include <tuple>
+#include <type_traits>
+#include "IFdbMsgBuilder.h"
+#include "CFdbSimpleSerializer.h"
+
+/*
+ * Parcelable consisting of fixed-size scalars only. Field types are given
+ * as template parameters so that serialized size is a compile-time
+ * constant and encoding/decoding is unrolled into straight-line loads and
+ * stores at constant offsets. Wire format is identical to serializing the
+ * same fields one by one with CFdbSimpleSerializer, so it can be mixed
+ * freely with CFdbSimpleMsgBuilder/CFdbSimpleMsgParser and other
+ * parcelables. Typical usage:
+ *     class CPosition : public CFdbFixedParcelable<int32_t, int32_t, double>
+ *     {
+ *     public:
+ *         int32_t &x() { return field<0>(); }
+ *         int32_t &y() { return field<1>(); }
+ *         double &speed() { return field<2>(); }
+ *     };
+ */
+template <typename T>
+struct CFdbFixedField
+{
+    static_assert(std::is_arithmetic<T>::value, "Only scalar can be fixed field!");
+    static const int32_t mSize = (int32_t)sizeof(T);
+    static void store(uint8_t *p, T data)
+    {
+        fdbStoreScalar<T>(p, data);
+    }
+    static void load(const uint8_t *p, T &data)
+    {
+        data = fdbLoadScalar<T>(p);
+    }
+    static void print(std::ostringstream &stream, T data)
+    {
+        stream << +data;
+    }
+};
+
+// bool is carried as uint8_t as CFdbSimpleSerializer does
+template <>
+struct CFdbFixedField<bool>
+{
+    static const int32_t mSize = 1;
+    static void store(uint8_t *p, bool data)
+    {
+        *p = data ? 1 : 0;
+    }
+    static void load(const uint8_t *p, bool &data)
+    {
+        data = !!*p;
+    }
+    static void print(std::ostringstream &stream, bool data)
+    {
+        stream << (data ? "true" : "false");
+    }
+};
+
+template <typename... Fields>
+struct CFdbFixedLayout;
+
+template <>
+struct CFdbFixedLayout<>
+{
+    static const int32_t mSize = 0;
+};
+
+template <typename F, typename... Rest>
+struct CFdbFixedLayout<F, Rest...>
+{
+    static const int32_t mSize = CFdbFixedField<F>::mSize + CFdbFixedLayout<Rest...>::mSize;
+};
+
+// encode/decode field I at compile-time offset OFFSET, then the rest
+template <int32_t I, int32_t N, int32_t OFFSET, typename Tuple>
+struct CFdbFixedCodec
+{
+    typedef typename std::tuple_element<I, Tuple>::type tField;
+    typedef CFdbFixedCodec<I + 1, N, OFFSET + CFdbFixedField<tField>::mSize, Tuple> tNext;
+
+    static void encode(uint8_t *buffer, const Tuple &fields)
+    {
+        CFdbFixedField<tField>::store(buffer + OFFSET, std::get<I>(fields));
+        tNext::encode(buffer, fields);
+    }
+    static void decode(const uint8_t *buffer, Tuple &fields)
+    {
+        CFdbFixedField<tField>::load(buffer + OFFSET, std::get<I>(fields));
+        tNext::decode(buffer, fields);
+    }
+    static void print(std::ostringstream &stream, const Tuple &fields)
+    {
+        CFdbFixedField<tField>::print(stream, std::get<I>(fields));
+        stream << ",";
+        tNext::print(stream, fields);
+    }
+};
+
+template <int32_t N, int32_t OFFSET, typename Tuple>
+struct CFdbFixedCodec<N, N, OFFSET, Tuple>
+{
+    static void encode(uint8_t *buffer, const Tuple &fields)
+    {}
+    static void decode(const uint8_t *buffer, Tuple &fields)
+    {}
+    static void print(std::ostringstream &stream, const Tuple &fields)
+    {}
+};
+
+template <typename... Fields>
+class CFdbFixedParcelable : public IFdbParcelable
+{
+public:
+    typedef std::tuple<Fields...> tFields;
+    typedef CFdbFixedCodec<0, (int32_t)sizeof...(Fields), 0, tFields> tCodec;
+    // size of serialized data, in bytes
+    static const int32_t mSize = CFdbFixedLayout<Fields...>::mSize;
+
+    CFdbFixedParcelable()
+        : mFields()
+    {}
+
+    CFdbFixedParcelable(const Fields&... fields)
+        : mFields(fields...)
+    {}
+
+    template <int32_t I>
+    typename std::tuple_element<I, tFields>::type &field()
+    {
+        return std::get<I>(mFields);
+    }
+
+    template <int32_t I>
+    const typename std::tuple_element<I, tFields>::type &field() const
+    {
+        return std::get<I>(mFields);
+    }
+
+    // encode into buffer which should be at least mSize bytes
+    void encode(uint8_t *buffer) const
+    {
+        tCodec::encode(buffer, mFields);
+    }
+
+    // decode from buffer which should be at least mSize bytes
+    void decode(const uint8_t *buffer)
+    {
+        tCodec::decode(buffer, mFields);
+    }
+
+    void serialize(CFdbSimpleSerializer &serializer) const
+    {
+        uint8_t *buffer = serializer.reserve(mSize);
+        if (buffer)
+        {
+            encode(buffer);
+        }
+    }
+
+    void deserialize(CFdbSimpleDeserializer &deserializer)
+    {
+        const uint8_t *buffer = deserializer.retrieveView(mSize);
+        if (buffer)
+        {
+            decode(buffer);
+        }
+    }
+
+protected:
+    void toString(std::ostringstream &stream) const
+    {
+        tCodec::print(stream, mFields);
+    }
+
+private:
+    tFields mFields;
+};
+
+/*
+ * Builder and parser of fixed parcelable: size is known without a sizing
+ * pass and data is encoded straight into message buffer.
+ */
+template <typename T>
+class CFdbFixedMsgBuilder : public IFdbMsgBuilder
+{
+public:
+    CFdbFixedMsgBuilder(const T &message)
+        : mMessage(message)
+    {}
+    int32_t build()
+    {
+        return T::mSize;
+    }
+    bool toBuffer(uint8_t *buffer, int32_t size)
+    {
+        if (size < T::mSize)
+        {
+            return false;
+        }
+        mMessage.encode(buffer);
+        return true;
+    }
+    bool toString(std::string &msg_txt) const
+    {
+        std::ostringstream stream;
+        (void)mMessage.format(stream);
+        msg_txt.assign(stream.str());
+        return true;
+    }
+
+private:
+    const T &mMessage;
+};
+
+template <typename T>
+class CFdbFixedMsgParser : public IFdbMsgParser
+{
+public:
+    CFdbFixedMsgParser(T &message)
+        : mMessage(message)
+    {}
+    bool parse(const uint8_t *buffer, int32_t size)
+    {
+        if (!buffer || (size < T::mSize))
+        {
+            return false;
+        }
+        mMessage.decode(buffer);
+        return true;
+    }
+
+private:
+    T &mMessage;
+};
+
+#endif
@@ -0,0 +1,404 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CFDBFLATMSGBUILDER_H__
+#define __CFDBFLATMSGBUILDER_H__
+
+#include <string>
+#include "IFdbMsgBuilder.h"
+#include "CFdbSimpleSerializer.h"
+
+/*
+ * Flat message: fields are read in place from payload of the message
+ * without decoding, and written by the sender straight into the message
+ * buffer. Layout (all in little endian):
+ *
+ *     +--------------------+ 0
+ *     | slot count: u16    |
+ *     | reserved: u16      |
+ *     | total size: u32    |
+ *     +--------------------+ 8
+ *     | slot 0: 8 bytes    |
+ *     | slot 1: 8 bytes    |
+ *     | ...                |
+ *     +--------------------+ 8 + 8 * slot count
+ *     | variable data      |
+ *     +--------------------+ total size
+ *
+ * Field N of a table always occupies slot N. Scalars are stored in the
+ * slot itself; string, byte array and scalar array store offset (u32,
+ * from start of payload) and size (u32, in bytes; excluding '\0' for
+ * string) in the slot and their data in variable area, at offsets that
+ * are multiple of 8. Strings are at most FDB_FLAT_MAX_STRING_SIZE bytes
+ * and always followed by '\0'. Payload of a received message can start at any
+ * address, so fields are always loaded with fdbLoadScalar() and arrays
+ * are accessed in place only when CFdbFlatArray::native() finds them
+ * aligned. New fields must be appended to the end of a table;
+ * reading a slot beyond what the sender has gives default value, so old
+ * and new peers can talk to each other.
+ *
+ * Tables are declared with macro DSL, usually generated by
+ * cmake/fdbflat-gen.cmake from *.fdbflat schema files:
+ *     #define CPosition_FIELDS(SCALAR, STRING, BYTES, ARRAY) \
+ *         SCALAR(int32_t, x, 0) \
+ *         SCALAR(double, speed, 1) \
+ *         STRING(name, 2) \
+ *         ARRAY(float, samples, 3)
+ *     FDB_FLAT_TABLE(CPosition, 4, CPosition_FIELDS)
+ * which defines CPositionBuilder (an IFdbMsgBuilder with set_x(),
+ * set_name()...) and CPositionReader (an IFdbMsgParser with x(), name()...).
+ */
+#define FDB_FLAT_HEAD_SIZE 8
+#define FDB_FLAT_SLOT_SIZE 8
+#define FDB_FLAT_ALIGN(_size) (((_size) + 7) & ~7)
+// string is read as CFdbStringView, whose length is fdb_string_len_t
+#define FDB_FLAT_MAX_STRING_SIZE ((uint32_t)(fdb_string_len_t)~0)
+
+// array of scalars located in payload of flat message
+template <typename T>
+class CFdbFlatArray
+{
+public:
+    CFdbFlatArray(const uint8_t *data = 0, uint32_t size = 0)
+        : mData(data)
+        , mSize(size)
+    {}
+    uint32_t size() const
+    {
+        return mSize;
+    }
+    bool empty() const
+    {
+        return !mSize;
+    }
+    // data might be unaligned: always safe to fetch elements with operator[]
+    T operator[](uint32_t index) const
+    {
+        return fdbLoadScalar<T>(mData + index * sizeof(T));
+    }
+    /*
+     * Return pointer to the array if it can be accessed in place, that is,
+     * the host is little endian and the data is properly aligned. Otherwise
+     * return 0 and elements should be fetched with operator[] or copyTo().
+     */
+    const T *native() const
+    {
+#if FDB_BIG_ENDIAN_HOST
+        return 0;
+#else
+        return ((uintptr_t)mData % sizeof(T)) ? 0 : (const T *)mData;
+#endif
+    }
+    // copy all elements to @data, which holds at least size() elements
+    void copyTo(T *data) const
+    {
+        if (mSize)
+        {
+            CFdbPodTraits<T>::fromWire(data, mData, mSize);
+        }
+    }
+private:
+    const uint8_t *mData;
+    uint32_t mSize;
+};
+
+class CFdbFlatReader : public IFdbMsgParser
+{
+public:
+    CFdbFlatReader()
+        : mBuffer(0)
+        , mSize(0)
+        , mSlots(0)
+    {}
+
+    // validate head only: nothing is decoded
+    bool parse(const uint8_t *buffer, int32_t size)
+    {
+        mBuffer = 0;
+        mSize = 0;
+        mSlots = 0;
+        if (!buffer || (size < FDB_FLAT_HEAD_SIZE))
+        {
+            return false;
+        }
+        uint16_t slots = fdbLoadScalar<uint16_t>(buffer);
+        uint32_t total = fdbLoadScalar<uint32_t>(buffer + 4);
+        if ((total > (uint32_t)size) ||
+            (total < (uint32_t)(FDB_FLAT_HEAD_SIZE + slots * FDB_FLAT_SLOT_SIZE)))
+        {
+            return false;
+        }
+        mBuffer = buffer;
+        mSize = total;
+        mSlots = slots;
+        return true;
+    }
+
+    // whether the sender knows field @index
+    bool has(uint16_t index) const
+    {
+        return index < mSlots;
+    }
+
+    template <typename T>
+    T scalar(uint16_t index, T default_value = T()) const
+    {
+        return has(index) ? fdbLoadScalar<T>(slot(index)) : default_value;
+    }
+
+    CFdbStringView string(uint16_t index) const
+    {
+        const uint8_t *data;
+        uint32_t size;
+        if (!varData(index, 1, data, size) || (size > FDB_FLAT_MAX_STRING_SIZE) || data[size])
+        {
+            return CFdbStringView();
+        }
+        return CFdbStringView((const char *)data, (fdb_string_len_t)size);
+    }
+
+    CFdbByteArrayView bytes(uint16_t index) const
+    {
+        const uint8_t *data;
+        uint32_t size;
+        if (!varData(index, 0, data, size))
+        {
+            return CFdbByteArrayView();
+        }
+        return CFdbByteArrayView(data, (int32_t)size);
+    }
+
+    template <typename T>
+    CFdbFlatArray<T> array(uint16_t index) const
+    {
+        const uint8_t *data;
+        uint32_t size;
+        if (!varData(index, 0, data, size))
+        {
+            return CFdbFlatArray<T>();
+        }
+        return CFdbFlatArray<T>(data, size / (uint32_t)sizeof(T));
+    }
+
+private:
+    const uint8_t *mBuffer;
+    uint32_t mSize;
+    uint16_t mSlots;
+
+    const uint8_t *slot(uint16_t index) const
+    {
+        return mBuffer + FDB_FLAT_HEAD_SIZE + index * FDB_FLAT_SLOT_SIZE;
+    }
+
+    /*
+     * @extra: bytes following data (i.e. '\0' of string). Offset and size
+     * come from the peer: nothing is added up so that nothing can wrap.
+     */
+    bool varData(uint16_t index, uint32_t extra, const uint8_t *&data, uint32_t &size) const
+    {
+        if (!has(index))
+        {
+            return false;
+        }
+        uint32_t offset = fdbLoadScalar<uint32_t>(slot(index));
+        size = fdbLoadScalar<uint32_t>(slot(index) + 4);
+        if (!size || (offset > mSize) || (size > (mSize - offset)) ||
+            (extra > (mSize - offset - size)))
+        {
+            return false;
+        }
+        data = mBuffer + offset;
+        return true;
+    }
+};
+
+template <uint16_t SLOTS>
+class CFdbFlatBuilder : public IFdbMsgBuilder
+{
+public:
+    CFdbFlatBuilder()
+    {
+        memset(mFields, 0, sizeof(mFields));
+    }
+
+    int32_t build()
+    {
+        int32_t size = FDB_FLAT_HEAD_SIZE + SLOTS * FDB_FLAT_SLOT_SIZE;
+        for (uint16_t i = 0; i < SLOTS; ++i)
+        {
+            if (mFields[i].mKind == FIELD_VAR)
+            {
+                size += FDB_FLAT_ALIGN(mFields[i].mSize + mFields[i].mExtra);
+            }
+        }
+        return size;
+    }
+
+    // everything is written in place; nothing is buffered before
+    bool toBuffer(uint8_t *buffer, int32_t size)
+    {
+        if (size < build())
+        {
+            return false;
+        }
+        fdbStoreScalar<uint16_t>(buffer, SLOTS);
+        fdbStoreScalar<uint16_t>(buffer + 2, 0);
+        uint8_t *slot = buffer + FDB_FLAT_HEAD_SIZE;
+        uint32_t offset = FDB_FLAT_HEAD_SIZE + SLOTS * FDB_FLAT_SLOT_SIZE;
+        for (uint16_t i = 0; i < SLOTS; ++i, slot += FDB_FLAT_SLOT_SIZE)
+        {
+            CField &field = mFields[i];
+            if (field.mKind == FIELD_SCALAR)
+            {
+                memcpy(slot, field.mScalar, FDB_FLAT_SLOT_SIZE);
+                continue;
+            }
+            if ((field.mKind == FIELD_NONE) || !field.mSize)
+            {
+                memset(slot, 0, FDB_FLAT_SLOT_SIZE);
+                continue;
+            }
+            fdbStoreScalar<uint32_t>(slot, offset);
+            fdbStoreScalar<uint32_t>(slot + 4, field.mSize);
+            uint8_t *data = buffer + offset;
+            memcpy(data, field.mData, field.mSize);
+#if FDB_BIG_ENDIAN_HOST
+            fdbSwapScalarArray(data, field.mElementSize, field.mSize / field.mElementSize);
+#endif
+            uint32_t aligned = FDB_FLAT_ALIGN(field.mSize + field.mExtra);
+            memset(data + field.mSize, 0, aligned - field.mSize);
+            offset += aligned;
+        }
+        fdbStoreScalar<uint32_t>(buffer + 4, offset);
+        return true;
+    }
+
+protected:
+    template <typename T>
+    void setScalar(uint16_t index, T value)
+    {
+        CField &field = mFields[index];
+        field.mKind = FIELD_SCALAR;
+        memset(field.mScalar, 0, sizeof(field.mScalar));
+        fdbStoreScalar<T>(field.mScalar, value);
+    }
+
+    // data is referred but not copied: it should be alive until message is sent
+    void setVar(uint16_t index, const void *data, uint32_t size, uint32_t element_size, uint32_t extra)
+    {
+        CField &field = mFields[index];
+        field.mKind = FIELD_VAR;
+        field.mData = data;
+        field.mSize = data ? size : 0;
+        field.mElementSize = element_size;
+        field.mExtra = extra;
+    }
+
+    // string longer than FDB_FLAT_MAX_STRING_SIZE is not sent
+    void setString(uint16_t index, const char *str, int32_t len = -1)
+    {
+        uint32_t size = str ? ((len < 0) ? (uint32_t)strlen(str) : (uint32_t)len) : 0;
+        setVar(index, str, (size > FDB_FLAT_MAX_STRING_SIZE) ? 0 : size, 1, 1);
+    }
+
+private:
+    enum eFieldKind
+    {
+        FIELD_NONE,
+        FIELD_SCALAR,
+        FIELD_VAR
+    };
+    struct CField
+    {
+        eFieldKind mKind;
+        uint8_t mScalar[FDB_FLAT_SLOT_SIZE];
+        const void *mData;
+        uint32_t mSize;
+        uint32_t mElementSize;
+        uint32_t mExtra;
+    };
+    CField mFields[SLOTS];
+};
+
+#define FDB_FLAT_READ_SCALAR(_type, _name, _index) \
+    _type _name() const \
+    { \
+        return scalar<_type>(_index); \
+    } \
+    bool has_##_name() const \
+    { \
+        return has(_index); \
+    }
+
+#define FDB_FLAT_READ_STRING(_name, _index) \
+    CFdbStringView _name() const \
+    { \
+        return string(_index); \
+    }
+
+#define FDB_FLAT_READ_BYTES(_name, _index) \
+    CFdbByteArrayView _name() const \
+    { \
+        return bytes(_index); \
+    }
+
+#define FDB_FLAT_READ_ARRAY(_type, _name, _index) \
+    CFdbFlatArray<_type> _name() const \
+    { \
+        return array<_type>(_index); \
+    }
+
+#define FDB_FLAT_WRITE_SCALAR(_type, _name, _index) \
+    void set_##_name(_type value) \
+    { \
+        setScalar<_type>(_index, value); \
+    }
+
+#define FDB_FLAT_WRITE_STRING(_name, _index) \
+    void set_##_name(const char *value, int32_t len = -1) \
+    { \
+        setString(_index, value, len); \
+    } \
+    void set_##_name(const std::string &value) \
+    { \
+        setString(_index, value.c_str(), (int32_t)value.size()); \
+    }
+
+#define FDB_FLAT_WRITE_BYTES(_name, _index) \
+    void set_##_name(const uint8_t *value, int32_t size) \
+    { \
+        setVar(_index, value, (uint32_t)size, 1, 0); \
+    }
+
+#define FDB_FLAT_WRITE_ARRAY(_type, _name, _index) \
+    void set_##_name(const _type *value, uint32_t count) \
+    { \
+        setVar(_index, value, count * (uint32_t)sizeof(_type), (uint32_t)sizeof(_type), 0); \
+    }
+
+#define FDB_FLAT_TABLE(_name, _slots, _fields) \
+class _name##Reader : public CFdbFlatReader \
+{ \
+public: \
+    _fields(FDB_FLAT_READ_SCALAR, FDB_FLAT_READ_STRING, FDB_FLAT_READ_BYTES, FDB_FLAT_READ_ARRAY) \
+}; \
+class _name##Builder : public CFdbFlatBuilder<_slots> \
+{ \
+public: \
+    _fields(FDB_FLAT_WRITE_SCALAR, FDB_FLAT_WRITE_STRING, FDB_FLAT_WRITE_BYTES, FDB_FLAT_WRITE_ARRAY) \
+};
+
+#endif
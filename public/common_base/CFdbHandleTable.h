@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CFDBHANDLETABLE_H__
+#define __CFDBHANDLETABLE_H__
+
+#include <vector>
+#include <deque>
+#include <limits>
+#include "common_defs.h"
+
+/*
+ * Table of pointers indexed by handle: the low @INDEX_BITS bits of a
+ * handle are index of a slot in an array and the remaining bits are
+ * generation of the slot, so that lookup is a bounds check plus one
+ * array access.
+ *
+ * Generation of a slot is increased each time the slot is freed, so a
+ * stale handle (of an entry already removed) doesn't find the entry
+ * taking the slot later. Freed slots are reused in FIFO order and only
+ * after more than @reuse_depth slots are free, which makes it unlikely
+ * that generation of a slot wraps while stale handles are still around.
+ *
+ * Handle never equals to FDB_INVALID_ID, and is never negative for
+ * signed handle type. insert() returns FDB_INVALID_ID if all slots are
+ * taken.
+ */
+template<typename IDX, typename EP, uint32_t INDEX_BITS>
+class CFdbHandleTable
+{
+public:
+    CFdbHandleTable(uint32_t reuse_depth = 0)
+        : mReuseDepth(reuse_depth)
+        , mCount(0)
+    {}
+
+    IDX insert(EP entry)
+    {
+        uint32_t index;
+        if ((mFreeSlots.size() > mReuseDepth) ||
+            (!mFreeSlots.empty() && (mSlots.size() >= mMaxSlots)))
+        {
+            index = mFreeSlots.front();
+            mFreeSlots.pop_front();
+        }
+        else if (mSlots.size() < mMaxSlots)
+        {
+            index = (uint32_t)mSlots.size();
+            mSlots.push_back(CSlot());
+        }
+        else
+        {
+            return (IDX)FDB_INVALID_ID;
+        }
+        auto &slot = mSlots[index];
+        slot.mEntry = entry;
+        ++mCount;
+        return (IDX)((slot.mGeneration << INDEX_BITS) | index);
+    }
+
+    EP retrieve(IDX handle) const
+    {
+        auto slot = findSlot(handle);
+        return slot ? slot->mEntry : 0;
+    }
+
+    bool remove(IDX handle)
+    {
+        auto slot = const_cast<CSlot *>(findSlot(handle));
+        if (!slot)
+        {
+            return false;
+        }
+        slot->mEntry = 0;
+        if (++slot->mGeneration >= mMaxGeneration)
+        {
+            slot->mGeneration = 0;
+        }
+        mFreeSlots.push_back((uint32_t)(handle & mIndexMask));
+        --mCount;
+        return true;
+    }
+
+    uint32_t size() const
+    {
+        return mCount;
+    }
+    bool empty() const
+    {
+        return !mCount;
+    }
+
+    /*
+     * For iteration: entry at slot @index in [0, slots()), or 0 if the
+     * slot is free. Entries can be removed while iterating.
+     */
+    uint32_t slots() const
+    {
+        return (uint32_t)mSlots.size();
+    }
+    EP entryAt(uint32_t index) const
+    {
+        return mSlots[index].mEntry;
+    }
+
+private:
+    struct CSlot
+    {
+        CSlot()
+            : mEntry(0)
+            , mGeneration(0)
+        {}
+        EP mEntry;
+        uint32_t mGeneration;
+    };
+
+    static const uint32_t mIndexMask = (1u << INDEX_BITS) - 1;
+    static const uint32_t mMaxSlots = 1u << INDEX_BITS;
+    // sign bit is not used; all-ones generation is skipped so that
+    // FDB_INVALID_ID is never a handle
+    static const uint32_t mMaxGeneration = (1u << (sizeof(IDX) * 8 - INDEX_BITS -
+                                           (std::numeric_limits<IDX>::is_signed ? 1 : 0))) - 1;
+
+    std::vector<CSlot> mSlots;
+    std::deque<uint32_t> mFreeSlots;
+    uint32_t mReuseDepth;
+    uint32_t mCount;
+
+    const CSlot *findSlot(IDX handle) const
+    {
+        auto value = (uint32_t)handle;
+        auto index = value & mIndexMask;
+        if (index >= mSlots.size())
+        {
+            return 0;
+        }
+        auto &slot = mSlots[index];
+        if (!slot.mEntry || (slot.mGeneration != (value >> INDEX_BITS)))
+        {
+            return 0;
+        }
+        return &slot;
+    }
+};
+
+#endif
@@ -131,6 +131,19 @@ public:
         mReplyTime = reply_time;
         mOptions |= mMaskReplyTime;
     }
+    bool has_event_version() const
+    {
+        return !!(mOptions & mMaskEventVersion);
+    }
+    uint64_t event_version() const
+    {
+        return mEventVersion;
+    }
+    void set_event_version(uint64_t event_version)
+    {
+        mEventVersion = event_version;
+        mOptions |= mMaskEventVersion;
+    }
 
     void serialize(CFdbSimpleSerializer &serializer) const
     {
@@ -153,6 +166,10 @@ public:
         {
             serializer << mReplyTime;
         }
+        if (mOptions & mMaskEventVersion)
+        {
+            serializer << mEventVersion;
+        }
     }
 
     void deserialize(CFdbSimpleDeserializer &deserializer)
@@ -178,6 +195,10 @@ public:
         {
             deserializer >> mReplyTime;
         }
+        if (mOptions & mMaskEventVersion)
+        {
+            deserializer >> mEventVersion;
+        }
     }
     
 private:
@@ -190,10 +211,12 @@ private:
     std::string mFilter;
     uint64_t mSendArriveTime;
     uint64_t mReplyTime;
+    uint64_t mEventVersion;
     uint8_t mOptions;
         static const uint8_t mMaskHeadFilter = 1 << 1;
         static const uint8_t mMaskSenderArriveTime = 1 << 2;
         static const uint8_t mMaskReplyTime = 1 << 3;
+        static const uint8_t mMaskEventVersion = 1 << 4;
     
 };
 
@@ -496,6 +496,15 @@ private:
 class FdbMsgClientInfo : public IFdbParcelable
 {
 public:
+    FdbMsgClientInfo()
+        : mSecurityLevel(0)
+        , mQueuedBytes(0)
+        , mOldestAge(0)
+        , mDropped(0)
+        , mConflated(0)
+        , mSlowCount(0)
+        , mSlow(false)
+    {}
     const std::string &peer_name() const
     {
         return mPeerName;
@@ -520,6 +529,41 @@ public:
     {
         mSecurityLevel = sec_level;
     }
+    // outbound queue of the peer: see CFdbOutboundStats
+    uint32_t queued_bytes() const
+    {
+        return mQueuedBytes;
+    }
+    uint32_t oldest_age() const
+    {
+        return mOldestAge;
+    }
+    uint32_t dropped() const
+    {
+        return mDropped;
+    }
+    uint32_t conflated() const
+    {
+        return mConflated;
+    }
+    uint32_t slow_count() const
+    {
+        return mSlowCount;
+    }
+    bool slow() const
+    {
+        return mSlow;
+    }
+    void set_outbound(uint32_t queued_bytes, uint32_t oldest_age, uint32_t dropped,
+                      uint32_t conflated, uint32_t slow_count, bool slow)
+    {
+        mQueuedBytes = queued_bytes;
+        mOldestAge = oldest_age;
+        mDropped = dropped;
+        mConflated = conflated;
+        mSlowCount = slow_count;
+        mSlow = slow;
+    }
     void serialize(CFdbSimpleSerializer &serializer) const
     {
         serializer << mPeerName
@@ -532,10 +576,39 @@ public:
                      >> mPeerAddress
                      >> mSecurityLevel;
     }
+    /*
+     * Outbound statistics are not part of the item itself, which keeps
+     * the layout older peers expect; FdbMsgClientTable appends them after
+     * the whole table.
+     */
+    void serializeOutbound(CFdbSimpleSerializer &serializer) const
+    {
+        serializer << mQueuedBytes
+                   << mOldestAge
+                   << mDropped
+                   << mConflated
+                   << mSlowCount
+                   << mSlow;
+    }
+    void deserializeOutbound(CFdbSimpleDeserializer &deserializer)
+    {
+        deserializer >> mQueuedBytes
+                     >> mOldestAge
+                     >> mDropped
+                     >> mConflated
+                     >> mSlowCount
+                     >> mSlow;
+    }
 private:
     std::string mPeerName;
     std::string mPeerAddress;
     int32_t mSecurityLevel;
+    uint32_t mQueuedBytes;
+    uint32_t mOldestAge;
+    uint32_t mDropped;
+    uint32_t mConflated;
+    uint32_t mSlowCount;
+    bool mSlow;
 };
 
 class FdbMsgClientTable : public IFdbParcelable
@@ -566,17 +639,54 @@ public:
         return mClientTbl.Add();
     }
 
+    /*
+     * Optional blocks follow the table, each flagged in a presence byte;
+     * older peers stop reading after the table and newer peers reading
+     * an older table find nothing left.
+     */
+    enum
+    {
+        HAS_OUTBOUND = 1 << 0
+    };
+
     void serialize(CFdbSimpleSerializer &serializer) const
     {
         serializer << mEndpointName
                    << mServerName 
                    << mClientTbl;
+        serializer << (uint8_t)HAS_OUTBOUND;
+        auto &clients = mClientTbl.pool();
+        serializer << (fdb_struct_arr_len_t)clients.size();
+        for (auto it = clients.begin(); it != clients.end(); ++it)
+        {
+            it->serializeOutbound(serializer);
+        }
     }
     void deserialize(CFdbSimpleDeserializer &deserializer)
     {
         deserializer >> mEndpointName
                      >> mServerName 
                      >> mClientTbl;
+        if (deserializer.error() || (deserializer.remaining() <= 0))
+        {
+            return;
+        }
+        uint8_t flags = 0;
+        deserializer >> flags;
+        if (flags & HAS_OUTBOUND)
+        {
+            fdb_struct_arr_len_t count = 0;
+            deserializer >> count;
+            auto &clients = mClientTbl.vpool();
+            for (uint32_t i = 0; (i < count) && (i < (uint32_t)clients.size()); ++i)
+            {
+                if (deserializer.error())
+                {
+                    break;
+                }
+                clients[i].deserializeOutbound(deserializer);
+            }
+        }
     }
 private:
     std::string mEndpointName;
@@ -587,6 +697,11 @@ private:
 class FdbMsgEventCacheItem : public IFdbParcelable
 {
 public:
+    FdbMsgEventCacheItem()
+        : mEvent(0)
+        , mSize(0)
+        , mAge(0)
+    {}
     int32_t event() const
     {
         return mEvent;
@@ -611,6 +726,15 @@ public:
     {
         mSize = size;
     }
+    // ms since the event is updated or read last
+    uint32_t age() const
+    {
+        return mAge;
+    }
+    void set_age(uint32_t age)
+    {
+        mAge = age;
+    }
 
     void serialize(CFdbSimpleSerializer &serializer) const
     {
@@ -628,11 +752,21 @@ private:
     int32_t mEvent;
     std::string mTopic;
     int32_t mSize;
+    uint32_t mAge;
 };
 
 class FdbMsgEventCache : public IFdbParcelable
 {
 public:
+    FdbMsgEventCache()
+        : mBytes(0)
+        , mMaxBytes(0)
+        , mTtl(0)
+        , mEvicted(0)
+        , mExpired(0)
+        , mProcessBytes(0)
+        , mProcessMaxBytes(0)
+    {}
     CFdbParcelableArray<FdbMsgEventCacheItem> &cache()
     {
         return mCache;
@@ -641,17 +775,136 @@ public:
     {
         return mCache.Add();
     }
+    uint32_t bytes() const
+    {
+        return mBytes;
+    }
+    void set_bytes(uint32_t bytes)
+    {
+        mBytes = bytes;
+    }
+    uint32_t max_bytes() const
+    {
+        return mMaxBytes;
+    }
+    void set_max_bytes(uint32_t max_bytes)
+    {
+        mMaxBytes = max_bytes;
+    }
+    uint32_t ttl() const
+    {
+        return mTtl;
+    }
+    void set_ttl(uint32_t ttl)
+    {
+        mTtl = ttl;
+    }
+    uint32_t evicted() const
+    {
+        return mEvicted;
+    }
+    void set_evicted(uint32_t evicted)
+    {
+        mEvicted = evicted;
+    }
+    uint32_t expired() const
+    {
+        return mExpired;
+    }
+    void set_expired(uint32_t expired)
+    {
+        mExpired = expired;
+    }
+    uint64_t process_bytes() const
+    {
+        return mProcessBytes;
+    }
+    void set_process_bytes(uint64_t bytes)
+    {
+        mProcessBytes = bytes;
+    }
+    uint64_t process_max_bytes() const
+    {
+        return mProcessMaxBytes;
+    }
+    void set_process_max_bytes(uint64_t max_bytes)
+    {
+        mProcessMaxBytes = max_bytes;
+    }
+    /*
+     * Optional blocks follow the table, each flagged in a presence byte
+     * (see FdbMsgClientTable): ages of the items, then statistics of the
+     * cache.
+     */
+    enum
+    {
+        HAS_AGE = 1 << 0,
+        HAS_STATS = 1 << 1
+    };
+
     void serialize(CFdbSimpleSerializer &serializer) const
     {
-        serializer << mCache; 
+        serializer << mCache;
+        serializer << (uint8_t)(HAS_AGE | HAS_STATS);
+        auto &items = mCache.pool();
+        serializer << (fdb_struct_arr_len_t)items.size();
+        for (auto it = items.begin(); it != items.end(); ++it)
+        {
+            serializer << it->age();
+        }
+        serializer << mBytes
+                   << mMaxBytes
+                   << mTtl
+                   << mEvicted
+                   << mExpired
+                   << mProcessBytes
+                   << mProcessMaxBytes;
     }
     void deserialize(CFdbSimpleDeserializer &deserializer)
     {
-        deserializer >> mCache; 
+        deserializer >> mCache;
+        if (deserializer.error() || (deserializer.remaining() <= 0))
+        {
+            return;
+        }
+        uint8_t flags = 0;
+        deserializer >> flags;
+        if (flags & HAS_AGE)
+        {
+            fdb_struct_arr_len_t count = 0;
+            deserializer >> count;
+            auto &items = mCache.vpool();
+            for (uint32_t i = 0; (i < count) && !deserializer.error(); ++i)
+            {
+                uint32_t age = 0;
+                deserializer >> age;
+                if (i < (uint32_t)items.size())
+                {
+                    items[i].set_age(age);
+                }
+            }
+        }
+        if (flags & HAS_STATS)
+        {
+            deserializer >> mBytes
+                         >> mMaxBytes
+                         >> mTtl
+                         >> mEvicted
+                         >> mExpired
+                         >> mProcessBytes
+                         >> mProcessMaxBytes;
+        }
     }
     
 private:
     CFdbParcelableArray<FdbMsgEventCacheItem> mCache;
+    uint32_t mBytes;
+    uint32_t mMaxBytes;
+    uint32_t mTtl;
+    uint32_t mEvicted;
+    uint32_t mExpired;
+    uint64_t mProcessBytes;
+    uint64_t mProcessMaxBytes;
 };
 
 }
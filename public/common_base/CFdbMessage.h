@@ -18,6 +18,7 @@
 #define _CFDBMESSAGE_H_
 
 #include <string>
+#include <functional>
 #include "common_defs.h"
 #include "CBaseJob.h"
 #include "CBaseLoopTimer.h"
@@ -70,6 +71,38 @@ enum CFdbSubscribeType {
   FDB_SUB_TYPE_ON_REQUEST = 1
 };
 
+/*
+ * How broadcasts are delivered to a subscriber:
+ * FULL: every broadcast is sent;
+ * CONFLATE: at most one broadcast per interval is sent for each event/topic;
+ *     broadcasts in between are conflated: only the latest one is kept and
+ *     sent when the interval expires;
+ * ON_CHANGE: broadcast is sent only if payload differs from the last one.
+ */
+enum CFdbDeliveryPolicy {
+  FDB_DELIVER_FULL = 0,
+  FDB_DELIVER_CONFLATE = 1,
+  FDB_DELIVER_ON_CHANGE = 2
+};
+
+/*
+ * How broadcasts to a slow peer (see CBaseEndpoint::setSlowPeerPolicy())
+ * are handled:
+ * DROP_OLDEST: oldest queued broadcasts are dropped to stay in the limit;
+ * CONFLATE: a queued broadcast of the same code and topic is replaced by
+ *     the newer one; oldest are dropped if still over the limit;
+ * DISCONNECT: the peer is kicked off;
+ * DEMOTE: the peer is moved to a low priority lane until it catches up:
+ *     nothing is written to it in line with sending, only from the event
+ *     loop and at most 64KB every 20ms, so other peers are served between.
+ */
+enum CFdbSlowPolicy {
+  FDB_SLOW_DROP_OLDEST = 0,
+  FDB_SLOW_CONFLATE = 1,
+  FDB_SLOW_DISCONNECT = 2,
+  FDB_SLOW_DEMOTE = 3
+};
+
 enum EFdbSidebandMessage
 {
     FDB_SIDEBAND_AUTH = 0,
@@ -129,7 +162,6 @@ struct CFdbMsgMetadata
 typedef int32_t FdbMessageType_t;
 #define FDB_MSG_TYPE_SYSTEM       0
 
-class CMessageTimer;
 class CFdbSession;
 class CFdbBaseObject;
 class CBaseEndpoint;
@@ -144,6 +176,8 @@ private:
 #define FDB_CODE_SUBSCRIBE          0
 #define FDB_CODE_UNSUBSCRIBE        1
 #define FDB_CODE_UPDATE             2
+// cached events replayed in one frame; see CFdbBaseObject::broadcastCached()
+#define FDB_CODE_SNAPSHOT           3
 
 #define MSG_LOCAL_FLAG_SHIFT        24
 #define MSG_GLOBAL_FLAG_MASK        0xffffff
@@ -156,6 +190,10 @@ private:
 #define MSG_FLAG_INITIAL_RESPONSE   (1 << 6)
 #define MSG_FLAG_GET_EVENT          (1 << 7)
 #define MSG_FLAG_FORCE_UPDATE       (1 << 8)
+// payload is delta against the last cached event; see enableEventDelta()
+#define MSG_FLAG_DELTA              (1 << 9)
+// payload is a list of cached events
+#define MSG_FLAG_SNAPSHOT           (1 << 10)
 
 #define MSG_FLAG_HEAD_OK            (1 << (MSG_LOCAL_FLAG_SHIFT + 0))
 #define MSG_FLAG_ENDPOINT           (1 << (MSG_LOCAL_FLAG_SHIFT + 1))
@@ -163,6 +201,7 @@ private:
 #define MSG_FLAG_ENABLE_LOG         (1 << (MSG_LOCAL_FLAG_SHIFT + 3))
 #define MSG_FLAG_EXTERNAL_BUFFER    (1 << (MSG_LOCAL_FLAG_SHIFT + 4))
 #define MSG_FLAG_MANUAL_UPDATE      (1 << (MSG_LOCAL_FLAG_SHIFT + 6))
+#define MSG_FLAG_SHARED_BUFFER      (1 << (MSG_LOCAL_FLAG_SHIFT + 7))
     
     struct CFdbMsgPrefix
     {
@@ -324,12 +363,7 @@ public:
     /*
      * Own the buffer (so that user should release it manually)
      */
-    void *ownBuffer()
-    {
-        void *buf = mBuffer;
-        mBuffer = 0;
-        return buf;
-    }
+    void *ownBuffer();
 
     /*
      * Release the buffer obtained from ownBuffer().
@@ -383,6 +417,20 @@ public:
         }
     }
 
+    /*
+     * Get version of cached event carried by broadcast; 0 if the server
+     * doesn't cache the event. Pass it with addNotifyItem() when
+     * subscribing again to skip replay of the cached value.
+     */
+    uint64_t eventVersion() const
+    {
+        return mEventVersion;
+    }
+    void eventVersion(uint64_t version)
+    {
+        mEventVersion = version;
+    }
+
     /*
      * Get session ID of the message
      */
@@ -492,6 +540,12 @@ public:
 protected:
     virtual bool allocCopyRawBuffer(const void *src, int32_t payload_size);
     virtual void freeRawBuffer();
+    /*
+     * Free raw buffer once it is shared beyond the message (see
+     * shareBuffer()), when the message might be gone already. Must match
+     * freeRawBuffer() if allocCopyRawBuffer() is overridden.
+     */
+    virtual std::function<void(uint8_t *)> rawBufferDeleter();
     virtual void onAsyncError(Ptr &ref, NFdbBase::FdbMsgStatusCode code, const char *reason) {}
 
 private:
@@ -606,6 +660,16 @@ private:
     bool buildHeader(CFdbSession *session);
     bool serialize(IFdbMsgBuilder &data, const CFdbBaseObject *object = 0);
     bool serialize(const void *buffer, int32_t size, const CFdbBaseObject *object = 0);
+    /*
+     * Refer to payload in @buffer instead of copying it. @buffer should be
+     * allocated as maxReservedSize() + @size bytes with payload at
+     * maxReservedSize(); space before payload is overwritten by head.
+     */
+    bool serialize(const std::shared_ptr<uint8_t> &buffer, int32_t size, const CFdbBaseObject *object = 0);
+    // turn the buffer into a shared one so that it can be referred after the message is gone
+    std::shared_ptr<uint8_t> shareBuffer();
+    // use @size bytes at @offset of @buffer as payload; the message has no head
+    bool sharePayload(const std::shared_ptr<uint8_t> &buffer, int32_t offset, int32_t size);
 
     bool submit(CBaseJob::Ptr &msg_ref
                 , uint32_t tx_flag
@@ -707,8 +771,11 @@ private:
     };
     FdbObjectId_t mOid;
     uint8_t *mBuffer;
+    // owner of mBuffer if MSG_FLAG_SHARED_BUFFER is set
+    std::shared_ptr<uint8_t> mSharedBuffer;
     uint32_t mFlag;
-    CMessageTimer *mTimer;
+    // ms to wait for reply; 0 if no timeout
+    int32_t mTimeout;
     std::string mStringData;
     std::string mFilter;
 
@@ -719,9 +786,11 @@ private:
 
     CFdbBaseObject *mMigrateObject;
     long mMigrateFlag;
+    uint64_t mEventVersion;
 
     friend class CFdbSession;
     friend class CFdbBaseObject;
+    friend class CFdbSharedSubscription;
     friend class CBaseServer;
     friend class CBaseClient;
     friend class CLogProducer;
@@ -22,12 +22,17 @@
 #include "IFdbMsgBuilder.h"
 #include <vector>
 #include <common_base/CFdbSimpleMsgBuilder.h>
+#include <common_base/CFdbContentFilter.h>
 
 class CFdbMsgSubscribeItem : public IFdbParcelable
 {
 public:
     CFdbMsgSubscribeItem()
-        : mOptions(0)
+        : mPolicy(FDB_DELIVER_FULL)
+        , mInterval(0)
+        , mVersion(0)
+        , mOptions(0)
+        , mExtOptions(0)
     {
     }
     int32_t msg_code() const
@@ -64,7 +69,108 @@ public:
         mType = type;
         mOptions |= mMaskType;
     }
+    // filter is a topic pattern with "*" and "#" segments
+    bool pattern() const
+    {
+        return !!(mOptions & mMaskPattern);
+    }
+    void set_pattern(bool pattern)
+    {
+        if (pattern)
+        {
+            mOptions |= mMaskPattern;
+        }
+        else
+        {
+            mOptions &= ~mMaskPattern;
+        }
+    }
+    // event is only sent when payload matches the content filter
+    bool has_content_filter() const
+    {
+        return !!(mExtOptions & mMaskContent);
+    }
+    const CFdbContentFilter &content_filter() const
+    {
+        return mContentFilter;
+    }
+    void set_content_filter(const CFdbContentFilter &content_filter)
+    {
+        mContentFilter = content_filter;
+        mExtOptions |= mMaskContent;
+    }
+    bool has_policy() const
+    {
+        return !!(mExtOptions & mMaskPolicy);
+    }
+    CFdbDeliveryPolicy policy() const
+    {
+        return mPolicy;
+    }
+    // interval in ms for FDB_DELIVER_CONFLATE
+    uint32_t interval() const
+    {
+        return mInterval;
+    }
+    void set_policy(CFdbDeliveryPolicy policy, uint32_t interval = 0)
+    {
+        mPolicy = policy;
+        mInterval = interval;
+        mExtOptions |= mMaskPolicy;
+    }
+    // version of cached event already held by client: not replayed if
+    // the cache has nothing newer
+    bool has_version() const
+    {
+        return !!(mExtOptions & mMaskVersion);
+    }
+    uint64_t version() const
+    {
+        return mVersion;
+    }
+    void set_version(uint64_t version)
+    {
+        mVersion = version;
+        mExtOptions |= mMaskVersion;
+    }
+    // cached event can be sent as delta against the last one sent
+    bool delta() const
+    {
+        return !!(mExtOptions & mMaskDelta);
+    }
+    void set_delta(bool delta)
+    {
+        if (delta)
+        {
+            mExtOptions |= mMaskDelta;
+        }
+        else
+        {
+            mExtOptions &= ~mMaskDelta;
+        }
+    }
+    // cached events can be sent in one snapshot frame on subscribe
+    bool snapshot() const
+    {
+        return !!(mExtOptions & mMaskSnapshot);
+    }
+    void set_snapshot(bool snapshot)
+    {
+        if (snapshot)
+        {
+            mExtOptions |= mMaskSnapshot;
+        }
+        else
+        {
+            mExtOptions &= ~mMaskSnapshot;
+        }
+    }
 
+    /*
+     * Only code, filter, type and pattern are serialized with the item,
+     * in the format old peers know. Other options are carried by
+     * extension (see CFdbMsgTable).
+     */
     void serialize(CFdbSimpleSerializer &serializer) const
     {
         serializer << mCode << mOptions;
@@ -89,22 +195,106 @@ public:
             deserializer >> (uint8_t &)mType;
         }
     }
+
+    bool hasExtension() const
+    {
+        return !!mExtOptions;
+    }
+    /*
+     * Extension is prefixed with its length so that a reader skips
+     * whatever follows the fields it knows; new fields must be appended
+     * to the end.
+     */
+    void serializeExtension(CFdbSimpleSerializer &serializer) const
+    {
+        CFdbSimpleSerializer extension;
+        extension << mExtOptions;
+        if (mExtOptions & mMaskContent)
+        {
+            extension << mContentFilter;
+        }
+        if (mExtOptions & mMaskPolicy)
+        {
+            extension << (uint8_t)mPolicy << mInterval;
+        }
+        if (mExtOptions & mMaskVersion)
+        {
+            extension << mVersion;
+        }
+        serializer << (uint32_t)extension.bufferSize();
+        serializer.addRawData(extension.buffer(), extension.bufferSize());
+    }
+    void deserializeExtension(CFdbSimpleDeserializer &deserializer)
+    {
+        uint32_t size = 0;
+        deserializer >> size;
+        auto data = deserializer.retrieveView((int32_t)size);
+        if (!data || !size)
+        {
+            return;
+        }
+        CFdbSimpleDeserializer extension(data, (int32_t)size);
+        extension >> mExtOptions;
+        if (mExtOptions & mMaskContent)
+        {
+            extension >> mContentFilter;
+        }
+        if (mExtOptions & mMaskPolicy)
+        {
+            uint8_t policy = FDB_DELIVER_FULL;
+            extension >> policy >> mInterval;
+            mPolicy = (CFdbDeliveryPolicy)policy;
+        }
+        if (mExtOptions & mMaskVersion)
+        {
+            extension >> mVersion;
+        }
+        if (extension.error())
+        {
+            mExtOptions = 0;
+        }
+    }
 protected:
     void toString(std::ostringstream &stream) const
     {
         stream << "event : " << mCode
                << ", topic : " << mFilter;
+        if (mExtOptions & mMaskContent)
+        {
+            stream << ", content : ";
+            mContentFilter.format(stream);
+        }
     }
     
 private:
     int32_t mCode;
     std::string mFilter;
     CFdbSubscribeType mType;
+    CFdbContentFilter mContentFilter;
+    CFdbDeliveryPolicy mPolicy;
+    uint32_t mInterval;
+    uint64_t mVersion;
     uint8_t mOptions;
         static const uint8_t mMaskFilter = 1 << 0;
         static const uint8_t mMaskType = 1 << 1;
+        static const uint8_t mMaskPattern = 1 << 2;
+    // options in extension
+    uint8_t mExtOptions;
+        static const uint8_t mMaskContent = 1 << 0;
+        static const uint8_t mMaskPolicy = 1 << 1;
+        static const uint8_t mMaskVersion = 1 << 2;
+        static const uint8_t mMaskDelta = 1 << 3;
+        static const uint8_t mMaskSnapshot = 1 << 4;
 };
 
+/*
+ * Subscribe table. Extensions of the items, if any, follow the table as
+ * a separate block:
+ *     table | item count | extension of item 0 | extension of item 1 ...
+ * Old peers stop reading after the table, so the block is invisible to
+ * them.
+ */
+
 class CFdbMsgTable : public IFdbParcelable
 {
 public:
@@ -120,10 +310,38 @@ public:
     void serialize(CFdbSimpleSerializer &serializer) const
     {
         serializer << mSubscribeTbl;
+        auto &items = mSubscribeTbl.pool();
+        for (auto it = items.begin(); it != items.end(); ++it)
+        {
+            if (it->hasExtension())
+            {
+                serializer << (fdb_struct_arr_len_t)items.size();
+                for (it = items.begin(); it != items.end(); ++it)
+                {
+                    it->serializeExtension(serializer);
+                }
+                break;
+            }
+        }
     }
     void deserialize(CFdbSimpleDeserializer &deserializer)
     {
         deserializer >> mSubscribeTbl;
+        if (deserializer.error() || (deserializer.remaining() <= 0))
+        {
+            return;
+        }
+        fdb_struct_arr_len_t count = 0;
+        deserializer >> count;
+        auto &items = mSubscribeTbl.vpool();
+        for (uint32_t i = 0; (i < count) && (i < (uint32_t)items.size()); ++i)
+        {
+            if (deserializer.error())
+            {
+                break;
+            }
+            items[i].deserializeExtension(deserializer);
+        }
     }
 protected:
     void toString(std::ostringstream &stream) const
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CFDBPENDINGTABLE_H__
+#define __CFDBPENDINGTABLE_H__
+
+#include <vector>
+#include <map>
+#include "common_defs.h"
+
+#define FDB_PENDING_TABLE_MIN_SLOTS     64
+#define FDB_PENDING_TABLE_MAX_SLOTS     (1 << 16)
+
+/*
+ * Table of pending requests keyed by serial number. Serial numbers are
+ * allocated in increasing order, so request with serial number @sn is
+ * kept in slot (@sn mod number of slots) of a ring: as long as fewer
+ * requests than slots are outstanding, insert, lookup and remove are
+ * one array access without allocation.
+ *
+ * When the slot is still taken by an older request the ring grows, up to
+ * FDB_PENDING_TABLE_MAX_SLOTS; beyond that the older request, which
+ * outlives the whole ring, is moved to an overflow map.
+ *
+ * Pointer returned by retrieve() is valid until next insert() or
+ * remove().
+ */
+template<typename T>
+class CFdbPendingTable
+{
+public:
+    CFdbPendingTable()
+        : mSnAllocator(0)
+        , mMask(FDB_PENDING_TABLE_MIN_SLOTS - 1)
+        , mCount(0)
+        , mSlots(FDB_PENDING_TABLE_MIN_SLOTS)
+    {}
+
+    FdbMsgSn_t allocateSn()
+    {
+        return mSnAllocator++;
+    }
+
+    void insert(FdbMsgSn_t sn, const T &entry)
+    {
+        while (true)
+        {
+            auto &slot = mSlots[sn & mMask];
+            if (!slot.mUsed)
+            {
+                slot.mSn = sn;
+                slot.mEntry = entry;
+                slot.mUsed = true;
+                break;
+            }
+            if (slot.mSn == sn)
+            {
+                return;
+            }
+            if (mSlots.size() < FDB_PENDING_TABLE_MAX_SLOTS)
+            {
+                grow();
+            }
+            else
+            {
+                evict(slot);
+            }
+        }
+        ++mCount;
+    }
+
+    T *retrieve(FdbMsgSn_t sn)
+    {
+        auto &slot = mSlots[sn & mMask];
+        if (slot.mUsed && (slot.mSn == sn))
+        {
+            return &slot.mEntry;
+        }
+        if (!mOverflow.empty())
+        {
+            auto it = mOverflow.find(sn);
+            if (it != mOverflow.end())
+            {
+                return &it->second;
+            }
+        }
+        return 0;
+    }
+
+    bool remove(FdbMsgSn_t sn)
+    {
+        auto &slot = mSlots[sn & mMask];
+        if (slot.mUsed && (slot.mSn == sn))
+        {
+            slot.mUsed = false;
+            slot.mEntry = T();
+        }
+        else if (mOverflow.empty() || !mOverflow.erase(sn))
+        {
+            return false;
+        }
+        --mCount;
+        return true;
+    }
+
+    // take out any one request; false if there is none
+    bool pop(T &entry)
+    {
+        if (!mCount)
+        {
+            return false;
+        }
+        if (!mOverflow.empty())
+        {
+            auto it = mOverflow.begin();
+            entry = it->second;
+            mOverflow.erase(it);
+            --mCount;
+            return true;
+        }
+        for (auto it = mSlots.begin(); it != mSlots.end(); ++it)
+        {
+            if (it->mUsed)
+            {
+                entry = it->mEntry;
+                it->mUsed = false;
+                it->mEntry = T();
+                --mCount;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t size() const
+    {
+        return mCount;
+    }
+    bool empty() const
+    {
+        return !mCount;
+    }
+
+private:
+    struct CSlot
+    {
+        CSlot()
+            : mSn(0)
+            , mUsed(false)
+        {}
+        FdbMsgSn_t mSn;
+        bool mUsed;
+        T mEntry;
+    };
+    typedef std::vector<CSlot> SlotTable_t;
+    typedef std::map<FdbMsgSn_t, T> OverflowTable_t;
+
+    FdbMsgSn_t mSnAllocator;
+    FdbMsgSn_t mMask;
+    uint32_t mCount;
+    SlotTable_t mSlots;
+    OverflowTable_t mOverflow;
+
+    void evict(CSlot &slot)
+    {
+        mOverflow[slot.mSn] = slot.mEntry;
+        slot.mUsed = false;
+        slot.mEntry = T();
+    }
+
+    void grow()
+    {
+        SlotTable_t slots(mSlots.size() * 2);
+        mMask = (FdbMsgSn_t)slots.size() - 1;
+        mSlots.swap(slots);
+        for (auto it = slots.begin(); it != slots.end(); ++it)
+        {
+            if (!it->mUsed)
+            {
+                continue;
+            }
+            auto &slot = mSlots[it->mSn & mMask];
+            if (slot.mUsed)
+            {
+                // two requests still collide in the larger ring
+                evict(slot);
+            }
+            slot.mSn = it->mSn;
+            slot.mEntry = it->mEntry;
+            slot.mUsed = true;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CFDBPROPERTYSTORE_H__
+#define __CFDBPROPERTYSTORE_H__
+
+#include <string>
+#include <vector>
+#include "common_defs.h"
+
+#define FDB_PROPERTY_STORE_SLOTS        256
+#define FDB_PROPERTY_STORE_SLOT_SIZE    1024
+// longest topic can be stored; events with longer topic are not stored
+#define FDB_PROPERTY_TOPIC_SIZE         64
+
+/*
+ * Latest value of events in shared memory: written by server (the only
+ * writer) along with its event cache, and read by local clients with a
+ * few loads instead of a get() round trip through the server.
+ *
+ * The store has a fixed number of slots of fixed size; a (code, topic)
+ * takes a slot when it is written first and keeps it until removed, after
+ * which the slot can be taken by another event. Each slot is
+ * protected by a sequence lock: the writer makes the sequence odd while
+ * updating, and readers retry if the sequence is odd or changes while
+ * they copy, so readers never block the writer.
+ *
+ * read() fails if the event is not stored (not published yet, evicted,
+ * topic too long, payload larger than slot or store full) or the server
+ * has closed the store; client should fall back to get() in this case,
+ * and reopen the store when the server comes online again.
+ *
+ * The store is readable by whoever can open it (see
+ * FDB_CFG_PROPERTY_STORE_MODE), bypassing onEventAuthentication(): events
+ * requiring a security level are never stored (see
+ * CFdbBaseObject::eventSecurityLevel()).
+ *
+ * Linux only: create() and open() fail on other platforms.
+ */
+class CFdbPropertyStore
+{
+public:
+    CFdbPropertyStore();
+    ~CFdbPropertyStore();
+
+    // at server: create the store named @name (normally the service name)
+    bool create(const char *name, uint32_t slots = FDB_PROPERTY_STORE_SLOTS,
+                uint32_t slot_size = FDB_PROPERTY_STORE_SLOT_SIZE);
+    // at client: map the store created by server read-only
+    bool open(const char *name);
+    void close();
+    bool isOpen() const
+    {
+        return !!mBase;
+    }
+
+    bool write(FdbMsgCode_t code, const char *topic, const void *payload, int32_t size,
+               uint64_t version);
+    void remove(FdbMsgCode_t code, const char *topic);
+
+    /*
+     * Copy the latest value to @buffer of @size bytes. On return @size is
+     * size of the value; if it is larger than @buffer, false is returned
+     * and the call can be retried with a larger buffer.
+     */
+    bool read(FdbMsgCode_t code, const char *topic, void *buffer, int32_t &size,
+              uint64_t *version = 0) const;
+    bool read(FdbMsgCode_t code, const char *topic, std::vector<uint8_t> &value,
+              uint64_t *version = 0) const;
+
+private:
+    uint8_t *mBase;
+    uint32_t mMapSize;
+    uint32_t mSlots;
+    uint32_t mSlotSize;
+    uint32_t mStride;
+    bool mWritable;
+    std::string mPath;
+    // at server with FDB_CFG_PROPERTY_STORE_MEMFD: the memfd; -1 otherwise
+    int mMemFd;
+
+    uint8_t *slot(uint32_t index) const;
+    int32_t findSlot(FdbMsgCode_t code, const char *topic, uint32_t topic_len, bool claim);
+};
+
+#endif
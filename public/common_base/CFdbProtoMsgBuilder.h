@@ -21,6 +21,7 @@
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/text_format.h>
+#include <google/protobuf/arena.h>
 
 namespace google{namespace protobuf {class MessageLite;}}
 typedef ::google::protobuf::MessageLite CFdbProtoMessage;
@@ -30,31 +31,42 @@ class CFdbProtoMsgBuilder : public IFdbMsgBuilder
 public:
     CFdbProtoMsgBuilder(const CFdbProtoMessage &message)
         : mMessage(message)
+        , mSize(-1)
     {
     }
 
+    /*
+     * Computing size also caches sizes of all sub-messages inside the
+     * message, which are reused by toBuffer() instead of being computed
+     * once more.
+     */
     int32_t build()
     {
-        return mMessage.ByteSize();
+#if GOOGLE_PROTOBUF_VERSION >= 3001000
+        mSize = (int32_t)mMessage.ByteSizeLong();
+#else
+        mSize = mMessage.ByteSize();
+#endif
+        return mSize;
     }
 
     bool toBuffer(uint8_t *buffer, int32_t size)
     {
         try
         {
-            google::protobuf::io::ArrayOutputStream aos(buffer, size);
-            google::protobuf::io::CodedOutputStream coded_output(&aos);
-            if (!mMessage.SerializeToCodedStream(&coded_output))
+            if ((mSize < 0) || (size < mSize))
             {
-                return false;
+                // build() is not called: sizes are not cached yet.
+                return mMessage.SerializeToArray(buffer, size);
             }
+            // serialize straight into the buffer with cached sizes
+            uint8_t *end = mMessage.SerializeWithCachedSizesToArray(buffer);
+            return (end - buffer) == mSize;
         }
         catch (...)
         {
             return false;
         }
-
-        return true;
     }
 
     bool toString(std::string &msg_txt) const
@@ -93,6 +105,7 @@ public:
     
 private:
     const CFdbProtoMessage &mMessage;
+    int32_t mSize;
 };
 
 class CFdbProtoMsgParser : public IFdbMsgParser
@@ -129,4 +142,78 @@ private:
     CFdbProtoMessage &mMessage;
 };
 
+/*
+ * Parser creating message of type T on google::protobuf::Arena so that
+ * sub-messages, strings and repeated fields of complex messages are carved
+ * out of arena blocks instead of being malloc'ed field by field, and are
+ * released all at once with the arena. Either an external arena is given,
+ * or the parser owns one whose first block of INIT_BLOCK bytes is inside
+ * the parser itself (e.g. on stack), so parsing small messages doesn't
+ * touch the heap at all. Message is valid as long as the arena is alive:
+ *     CFdbProtoArenaMsgParser<NFdbExample::NowPlayingDetails> parser;
+ *     if (msg->deserialize(parser)) { use parser.message(); }
+ */
+template <typename T, int32_t INIT_BLOCK = 1024>
+class CFdbProtoArenaMsgParser : public IFdbMsgParser
+{
+public:
+    CFdbProtoArenaMsgParser(google::protobuf::Arena *arena = 0)
+        : mOwnArena(arenaOptions(mInitBlock))
+        , mArena(arena ? arena : &mOwnArena)
+        , mMessage(0)
+    {
+    }
+
+    bool parse(const uint8_t *buffer, int32_t size)
+    {
+        bool ret = true;
+        try
+        {
+            if (!mMessage)
+            {
+                mMessage = google::protobuf::Arena::CreateMessage<T>(mArena);
+            }
+            else
+            {
+                mMessage->Clear();
+            }
+            ret = mMessage->ParseFromArray(buffer, size);
+        }
+        catch (...)
+        {
+            ret = false;
+        }
+
+        return ret;
+    }
+
+    T *message() const
+    {
+        return mMessage;
+    }
+
+    google::protobuf::Arena *arena() const
+    {
+        return mArena;
+    }
+
+private:
+    // should be declared before mOwnArena which refers to it
+    alignas(8) char mInitBlock[INIT_BLOCK];
+    google::protobuf::Arena mOwnArena;
+    google::protobuf::Arena *mArena;
+    T *mMessage;
+
+    static google::protobuf::ArenaOptions arenaOptions(char *init_block)
+    {
+        google::protobuf::ArenaOptions options;
+        options.initial_block = init_block;
+        options.initial_block_size = INIT_BLOCK;
+        return options;
+    }
+
+    CFdbProtoArenaMsgParser(const CFdbProtoArenaMsgParser &);
+    CFdbProtoArenaMsgParser &operator=(const CFdbProtoArenaMsgParser &);
+};
+
 #endif
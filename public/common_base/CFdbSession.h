@@ -18,10 +18,13 @@
 #define _CFDBSESSION_
 
 #include <string>
+#include <deque>
+#include <vector>
 #include "CBaseFdWatch.h"
+#include "CMethodLoopTimer.h"
 #include "common_defs.h"
 #include "CFdbMessage.h"
-#include "CEntityContainer.h"
+#include "CFdbPendingTable.h"
 #include "CSocketImp.h"
 #include "CFdbSessionContainer.h"
 
@@ -32,6 +35,22 @@ struct CFdbSessionInfo
     CFdbSocketConnInfo const *mConn;
 };
 
+/*
+ * Statistics of outbound queue of a session: messages are queued once the
+ * socket is unable to take them and are sent as the peer catches up.
+ */
+struct CFdbOutboundStats
+{
+    uint32_t mQueuedBytes;
+    uint32_t mQueuedMsgs;
+    uint32_t mPeakBytes;
+    uint32_t mOldestAge;    // ms since the oldest message is queued
+    uint32_t mDropped;      // broadcasts dropped for slow peer
+    uint32_t mConflated;    // broadcasts replaced by newer ones
+    uint32_t mSlowCount;    // times the peer becomes slow
+    bool mSlow;
+};
+
 class CFdbSessionContainer;
 namespace NFdbBase {
     class CFdbMessageHeader;
@@ -85,12 +104,68 @@ public:
     void terminateMessage(FdbMsgSn_t msg, int32_t status, const char *reason = 0);
     void getSessionInfo(CFdbSessionInfo &info);
     CFdbMessage *peepPendingMessage(FdbMsgSn_t sn);
+    // terminate pending request @sn with timeout if no reply in @timeout ms
+    void addDeadline(FdbMsgSn_t sn, int32_t timeout);
+    void getOutboundStats(CFdbOutboundStats &stats);
 protected:
     void onInput(bool &io_error);
+    void onOutput(bool &io_error);
     void onError();
     void onHup();
 private:
-    typedef CEntityContainer<FdbMsgSn_t, CBaseJob::Ptr> PendingMsgTable_t;
+    typedef CFdbPendingTable<CBaseJob::Ptr> PendingMsgTable_t;
+    struct COutboundItem
+    {
+        uint8_t *mBuffer;
+        int32_t mSize;
+        int32_t mSent;
+        uint64_t mTime;
+        // only broadcast can be dropped or conflated
+        bool mBroadcast;
+        FdbMsgCode_t mCode;
+        FdbObjectId_t mObjId;
+        std::string mTopic;
+    };
+    typedef std::deque<COutboundItem> OutboundQueue_t;
+    struct CDeadline
+    {
+        uint64_t mDue;
+        FdbMsgSn_t mSn;
+        // for min-heap of std::push_heap()/std::pop_heap()
+        bool operator<(const CDeadline &other) const
+        {
+            return mDue > other.mDue;
+        }
+    };
+    typedef std::vector<CDeadline> DeadlineHeap_t;
+
+    // terminate requests not replied in time
+    class CDeadlineTimer : public CMethodLoopTimer<CFdbSession>
+    {
+    public:
+        CDeadlineTimer(CFdbSession *session)
+            : CMethodLoopTimer<CFdbSession>(0, false, session, &CFdbSession::onDeadlineTimer)
+        {
+        }
+    };
+
+    // let a demoted peer write again
+    class CDemotedTimer : public CMethodLoopTimer<CFdbSession>
+    {
+    public:
+        CDemotedTimer(CFdbSession *session)
+            : CMethodLoopTimer<CFdbSession>(0, false, session, &CFdbSession::onDemotedTimer)
+        {
+        }
+    };
+
+    bool sendBroadcast(CFdbMessage *msg);
+    bool queueMessage(const uint8_t *buffer, int32_t size, int32_t sent, CFdbMessage *msg);
+    bool conflate(const uint8_t *buffer, int32_t size, CFdbMessage *msg);
+    void dropOldest(uint32_t max_bytes, uint32_t max_age, uint64_t now);
+    bool checkSlow();
+    bool flushOutbound(int32_t quota);
+    bool demoted();
 
     void doRequest(NFdbBase::CFdbMessageHeader &head, CFdbMessage::CFdbMsgPrefix &prefix, uint8_t *buffer);
     void doResponse(NFdbBase::CFdbMessageHeader &head, CFdbMessage::CFdbMsgPrefix &prefix, uint8_t *buffer);
@@ -98,6 +173,10 @@ private:
     void doSubscribeReq(NFdbBase::CFdbMessageHeader &head, CFdbMessage::CFdbMsgPrefix &prefix, uint8_t *buffer, bool subscribe);
     void doUpdate(NFdbBase::CFdbMessageHeader &head, CFdbMessage::CFdbMsgPrefix &prefix, uint8_t *buffer);
     void checkLogEnabled(CFdbMessage *msg);
+    void scheduleDeadline(uint64_t now, uint64_t due);
+    void dropRepliedDeadlines();
+    void onDeadlineTimer(CMethodLoopTimer<CFdbSession> *timer);
+    void onDemotedTimer(CMethodLoopTimer<CFdbSession> *timer);
 
     PendingMsgTable_t mPendingMsgTable;
     FdbSessionId_t mSid;
@@ -107,6 +186,20 @@ private:
     std::string mToken;
     std::string mSenderName;
     int32_t mRecursiveDepth;
+    OutboundQueue_t mOutboundQueue;
+    CFdbOutboundStats mOutboundStats;
+    /*
+     * Deadlines of pending requests in a min-heap, with one timer armed for
+     * the earliest. Deadlines of replied requests are not removed at once
+     * but dropped when reaching the head, or when the heap is compacted.
+     */
+    DeadlineHeap_t mDeadlines;
+    CDeadlineTimer *mDeadlineTimer;
+    // when mDeadlineTimer expires; 0 if not running
+    uint64_t mDeadlineDue;
+    CDemotedTimer *mDemotedTimer;
+    // POLLOUT is withheld until mDemotedTimer expires
+    bool mOutputHeld;
 };
 
 #endif
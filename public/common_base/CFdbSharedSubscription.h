@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CFDBSHAREDSUBSCRIPTION_H__
+#define __CFDBSHAREDSUBSCRIPTION_H__
+
+#include <map>
+#include <set>
+#include <string>
+#include <memory>
+#include "common_defs.h"
+#include "CFdbMessage.h"
+#include "CFdbMsgSubscribe.h"
+
+class CFdbBaseObject;
+class CFdbSession;
+
+// most last values kept for an event/topic filter (pattern, "" or group)
+#define FDB_SHARED_SUBSCRIPTION_MAX_LAST_EVENTS 64
+
+/*
+ * Subscriptions of client objects in the process which share subscription
+ * (see CFdbBaseObject::enableSharedSubscription()), aggregated per remote
+ * object (server address and object id), event code and topic.
+ *
+ * The first object subscribing an event/topic is the owner and subscribes
+ * it from server. Other objects subscribing the same event/topic with the
+ * same options (type, delivery policy and content filter) are followers:
+ * the item is removed from their subscribe request and they get a copy,
+ * sharing the same payload buffer, of each event the owner receives. The
+ * last value of each event/topic cached by server is kept so that a
+ * follower gets it on joining just as a new subscriber does from server.
+ * If a filter matches more than FDB_SHARED_SUBSCRIPTION_MAX_LAST_EVENTS
+ * events/topics, the values are dropped and objects joining later
+ * subscribe from server instead.
+ *
+ * When the owner unsubscribes, goes offline or is destroyed, a follower
+ * takes over and subscribes from server itself.
+ *
+ * Only accessed from context thread.
+ */
+class CFdbSharedSubscription
+{
+public:
+    /*
+     * At client: check subscribe/unsubscribe request of @object before it
+     * is sent. onSubscribe() returns false if every item is shared and
+     * nothing is left to send.
+     */
+    bool onSubscribe(CFdbBaseObject *object, CFdbSession *session, CFdbMessage *msg);
+    void onUnsubscribe(CFdbBaseObject *object, CFdbMessage *msg);
+    // forward event received by @owner to followers
+    void forward(CFdbBaseObject *owner, CBaseJob::Ptr &msg_ref);
+    // @object is offline or destroyed
+    void remove(CFdbBaseObject *object);
+
+private:
+    // copy of the payload only: never holds the whole (snapshot) message
+    struct CLastEvent
+    {
+        std::shared_ptr<uint8_t> mBuffer;
+        int32_t mOffset;
+        int32_t mSize;
+        uint64_t mVersion;
+    };
+    // (code, topic) -> last event; a group entry holds events of many codes
+    typedef std::map<std::pair<FdbMsgCode_t, std::string>, CLastEvent> LastEventTable_t;
+
+    struct CEntry
+    {
+        CEntry()
+            : mOwner(0)
+            , mLastEventsDropped(false)
+        {
+        }
+        CFdbBaseObject *mOwner;
+        CFdbMsgSubscribeItem mItem;
+        std::set<CFdbBaseObject *> mFollowers;
+        LastEventTable_t mLastEvents;
+        // too many last values to keep: no more followers
+        bool mLastEventsDropped;
+    };
+    // (topic, is pattern) -> entry
+    typedef std::map<std::pair<std::string, bool>, CEntry> EntryTable_t;
+    typedef std::map<FdbMsgCode_t, EntryTable_t> CodeTable_t;
+    // remote object -> events subscribed
+    typedef std::map<std::string, CodeTable_t> RemoteTable_t;
+    // object -> remote object it is connected to
+    typedef std::map<CFdbBaseObject *, std::string> ObjectTable_t;
+
+    RemoteTable_t mRemoteTable;
+    ObjectTable_t mObjectTable;
+
+    static bool sameOptions(const CFdbMsgSubscribeItem &item1, const CFdbMsgSubscribeItem &item2);
+    static bool match(const std::pair<std::string, bool> &filter, const std::string &topic);
+    void deliver(CFdbBaseObject *object, FdbMsgCode_t code, const std::string &topic,
+                 const CLastEvent &event, uint32_t flag);
+    void handOver(CEntry &entry);
+    void leave(CodeTable_t &events, CFdbBaseObject *object, FdbMsgCode_t code,
+               const std::pair<std::string, bool> &filter);
+};
+
+#endif
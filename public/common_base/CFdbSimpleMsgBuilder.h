@@ -28,6 +28,11 @@ public:
     CFdbBaseSimpleMsgBuilder(T message)
         : mMessage(message)
     {}
+    /*
+     * Serialize once into the internal buffer and copy it out in
+     * toBuffer(): walking the message tree a second time just to get the
+     * size costs more than the copy.
+     */
     int32_t build()
     {
         mSerializer << mMessage;
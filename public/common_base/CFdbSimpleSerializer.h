@@ -16,11 +16,13 @@
 
 #ifndef __CSIMPLESERIALIZER_H__
 #define __CSIMPLESERIALIZER_H__
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <vector>
 #include <string>
 #include <sstream>
+#include <type_traits>
 
 #define FDB_SCRATCH_CACHE_SIZE 2048 
 #define FDB_BYTEARRAY_PRINT_SIZE 16
@@ -28,6 +30,47 @@ typedef uint16_t fdb_string_len_t;
 typedef uint16_t fdb_struct_arr_len_t;
 typedef int32_t fdb_byte_arr_len_t;
 
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define FDB_BIG_ENDIAN_HOST 1
+#else
+#define FDB_BIG_ENDIAN_HOST 0
+#endif
+
+/*
+ * Load scalar of type T stored in wire order (little endian) at @p, which
+ * is not necessarily aligned.
+ */
+template <typename T>
+inline T fdbLoadScalar(const uint8_t *p)
+{
+    T data;
+#if FDB_BIG_ENDIAN_HOST
+    uint8_t *p_data = (uint8_t *)&data;
+    for (int32_t i = 0; i < (int32_t)sizeof(T); ++i)
+    {
+        p_data[i] = p[sizeof(T) - 1 - i];
+    }
+#else
+    memcpy(&data, p, sizeof(T));
+#endif
+    return data;
+}
+
+// store scalar of type T at @p in wire order; @p is not necessarily aligned
+template <typename T>
+inline void fdbStoreScalar(uint8_t *p, T data)
+{
+#if FDB_BIG_ENDIAN_HOST
+    const uint8_t *p_data = (const uint8_t *)&data;
+    for (int32_t i = 0; i < (int32_t)sizeof(T); ++i)
+    {
+        p[i] = p_data[sizeof(T) - 1 - i];
+    }
+#else
+    memcpy(p, &data, sizeof(T));
+#endif
+}
+
 class CFdbSimpleSerializer;
 class CFdbSimpleDeserializer;
 class IFdbParcelable
@@ -71,6 +114,8 @@ public:
     FDB_OPERATOR_IN(uint32_t)
     FDB_OPERATOR_IN(int64_t)
     FDB_OPERATOR_IN(uint64_t)
+    FDB_OPERATOR_IN(float)
+    FDB_OPERATOR_IN(double)
 
     friend CFdbSimpleSerializer& operator<<(CFdbSimpleSerializer &serializer, bool data)
     {
@@ -97,6 +142,11 @@ public:
     void reset();
     void addRawData(const uint8_t *p_data, int32_t size);
     void addString(const char *string, fdb_string_len_t str_len);
+    /*
+     * Reserve @size bytes at current position and return the address to
+     * fill in, so that a block (e.g. POD array) is written in one go.
+     */
+    uint8_t *reserve(int32_t size);
 
 private:
     uint8_t *mBuffer;
@@ -132,6 +182,8 @@ public:
     FDB_OPERATOR_OUT(uint32_t)
     FDB_OPERATOR_OUT(int64_t)
     FDB_OPERATOR_OUT(uint64_t)
+    FDB_OPERATOR_OUT(float)
+    FDB_OPERATOR_OUT(double)
 
     friend CFdbSimpleDeserializer& operator>>(CFdbSimpleDeserializer& deserializer, bool &data)
     {
@@ -164,8 +216,19 @@ public:
     {
         return mBuffer ? mBuffer + mPos : 0;
     }
+
+    // bytes not read yet; -1 if size of the buffer is not given
+    int32_t remaining() const
+    {
+        return mSize ? (mSize - mPos) : -1;
+    }
     
     bool retrieveRawData(uint8_t *p_data, int32_t size);
+    /*
+     * Return address of the next @size bytes inside the buffer and skip
+     * them without copy. Return 0 and set error if data is not enough.
+     */
+    const uint8_t *retrieveView(int32_t size);
 
 private:
     const uint8_t *mBuffer;
@@ -193,6 +256,115 @@ private:
     }
 };
 
+/*
+ * Reverse byte order of @count elements of @size bytes each in place.
+ * Written as plain loops over aligned words so that compiler can
+ * vectorize them.
+ */
+template <typename W>
+inline void fdbSwapWords(uint8_t *data, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        W word;
+        memcpy(&word, data + i * sizeof(W), sizeof(W));
+        W swapped = 0;
+        for (uint32_t j = 0; j < sizeof(W); ++j)
+        {
+            swapped = (W)((swapped << 8) | ((word >> (j * 8)) & 0xff));
+        }
+        memcpy(data + i * sizeof(W), &swapped, sizeof(W));
+    }
+}
+
+inline void fdbSwapScalarArray(uint8_t *data, uint32_t size, uint32_t count)
+{
+    switch (size)
+    {
+        case 2:
+            fdbSwapWords<uint16_t>(data, count);
+        break;
+        case 4:
+            fdbSwapWords<uint32_t>(data, count);
+        break;
+        case 8:
+            fdbSwapWords<uint64_t>(data, count);
+        break;
+        default:
+        break;
+    }
+}
+
+/*
+ * Tell whether elements of CFdbParcelableArray<T> can be copied in bulk
+ * instead of being serialized one by one, and how to convert between
+ * host and wire (little endian) order. Arithmetic types are covered;
+ * custom POD structures can opt in with FDB_DECLARE_POD_STRUCT(), which
+ * requires that:
+ * - the structure is trivially copyable and not an IFdbParcelable;
+ * - there is no padding inside (e.g. declared packed) since the memory
+ *   image is sent as it is;
+ * - it has a method 'void swapBytes()' reversing byte order of each member,
+ *   which is called only on big endian hosts;
+ * - it has a method 'std::ostringstream &format(std::ostringstream &) const'
+ *   for logging.
+ */
+template <typename T>
+struct CFdbPodTraits
+{
+    static const bool mBulk = std::is_arithmetic<T>::value && !std::is_same<T, bool>::value;
+    static void toWire(uint8_t *wire, const T *data, uint32_t count)
+    {
+        memcpy(wire, data, count * sizeof(T));
+#if FDB_BIG_ENDIAN_HOST
+        fdbSwapScalarArray(wire, (uint32_t)sizeof(T), count);
+#endif
+    }
+    static void fromWire(T *data, const uint8_t *wire, uint32_t count)
+    {
+        memcpy(data, wire, count * sizeof(T));
+#if FDB_BIG_ENDIAN_HOST
+        fdbSwapScalarArray((uint8_t *)data, (uint32_t)sizeof(T), count);
+#endif
+    }
+};
+
+#if FDB_BIG_ENDIAN_HOST
+#define FDB_POD_STRUCT_TO_WIRE(_T, _wire, _data, _count) \
+    for (uint32_t i = 0; i < (_count); ++i) \
+    { \
+        _T element = (_data)[i]; \
+        element.swapBytes(); \
+        memcpy((_wire) + i * sizeof(_T), &element, sizeof(_T)); \
+    }
+#define FDB_POD_STRUCT_FROM_WIRE(_T, _data, _wire, _count) \
+    memcpy(_data, _wire, (_count) * sizeof(_T)); \
+    for (uint32_t i = 0; i < (_count); ++i) \
+    { \
+        (_data)[i].swapBytes(); \
+    }
+#else
+#define FDB_POD_STRUCT_TO_WIRE(_T, _wire, _data, _count) \
+    memcpy(_wire, _data, (_count) * sizeof(_T));
+#define FDB_POD_STRUCT_FROM_WIRE(_T, _data, _wire, _count) \
+    memcpy(_data, _wire, (_count) * sizeof(_T));
+#endif
+
+#define FDB_DECLARE_POD_STRUCT(_T) \
+template <> \
+struct CFdbPodTraits<_T> \
+{ \
+    static const bool mBulk = true; \
+    static void toWire(uint8_t *wire, const _T *data, uint32_t count) \
+    { \
+        FDB_POD_STRUCT_TO_WIRE(_T, wire, data, count) \
+    } \
+    static void fromWire(_T *data, const uint8_t *wire, uint32_t count) \
+    { \
+        FDB_POD_STRUCT_FROM_WIRE(_T, data, wire, count) \
+    } \
+};
+
 // for array of bool
 class abool : public IFdbParcelable
 {
@@ -287,11 +459,7 @@ public:
     
     void serialize(CFdbSimpleSerializer &serializer) const
     {
-        serializer << (fdb_struct_arr_len_t)mPool.size();
-        for (typename tPool::const_iterator it = mPool.begin(); it != mPool.end(); ++it)
-        {
-            serializer << *it;
-        }
+        doSerialize(serializer, std::integral_constant<bool, CFdbPodTraits<T>::mBulk>());
     }
 
     void deserialize(CFdbSimpleDeserializer &deserializer)
@@ -300,7 +468,32 @@ public:
         {
             return;
         }
-        
+        doDeserialize(deserializer, std::integral_constant<bool, CFdbPodTraits<T>::mBulk>());
+    }
+
+    std::ostringstream &format(std::ostringstream &stream) const
+    {
+        stream << "[";
+        toString(stream);
+        stream << "]";
+        return stream;
+    }
+
+protected:
+    tPool mPool;
+
+private:
+    void doSerialize(CFdbSimpleSerializer &serializer, std::false_type) const
+    {
+        serializer << (fdb_struct_arr_len_t)mPool.size();
+        for (typename tPool::const_iterator it = mPool.begin(); it != mPool.end(); ++it)
+        {
+            serializer << *it;
+        }
+    }
+
+    void doDeserialize(CFdbSimpleDeserializer &deserializer, std::false_type)
+    {
         fdb_struct_arr_len_t size = 0;
         deserializer >> size;
         mPool.resize(size);
@@ -315,16 +508,37 @@ public:
         }
     }
 
-    std::ostringstream &format(std::ostringstream &stream) const
+    // bulk copy of POD elements: one bounds check and one copy for all
+    void doSerialize(CFdbSimpleSerializer &serializer, std::true_type) const
     {
-        stream << "[";
-        toString(stream);
-        stream << "]";
-        return stream;
+        uint32_t count = (uint32_t)mPool.size();
+        serializer << (fdb_struct_arr_len_t)count;
+        uint8_t *wire = serializer.reserve((int32_t)(count * sizeof(T)));
+        if (wire && count)
+        {
+            CFdbPodTraits<T>::toWire(wire, &mPool[0], count);
+        }
     }
 
-protected:
-    tPool mPool;
+    void doDeserialize(CFdbSimpleDeserializer &deserializer, std::true_type)
+    {
+        fdb_struct_arr_len_t count = 0;
+        deserializer >> count;
+        if (deserializer.error())
+        {
+            return;
+        }
+        const uint8_t *wire = deserializer.retrieveView((int32_t)(count * sizeof(T)));
+        if (!wire)
+        {
+            return;
+        }
+        mPool.resize(count);
+        if (count)
+        {
+            CFdbPodTraits<T>::fromWire(&mPool[0], wire, count);
+        }
+    }
 };
 
 template<typename T>
@@ -390,6 +604,8 @@ CFDBPARCELABLEARRAY(int32_t)
 CFDBPARCELABLEARRAY(uint32_t)
 CFDBPARCELABLEARRAY(int64_t)
 CFDBPARCELABLEARRAY(uint64_t)
+CFDBPARCELABLEARRAY(float)
+CFDBPARCELABLEARRAY(double)
 
 template<>
 class CFdbParcelableArray<std::string> : public CFdbRepeatedParcelable<std::string>
@@ -615,5 +831,378 @@ private:
     uint8_t *mVBuffer;
 };
 
+/*
+ * View types below refer to memory of the buffer being deserialized
+ * instead of copying from it; they are valid only as long as the buffer
+ * (usually payload of CFdbMessage) is alive. Wire format is the same as
+ * std::string, CFdbByteArrayExt and CFdbParcelableArray respectively so
+ * that they can replace their counterparts in a parcelable used for
+ * receiving only, and parsing of large tables allocates nothing.
+ */
+class CFdbStringView : public IFdbParcelable
+{
+public:
+    CFdbStringView(const char *data = 0, fdb_string_len_t size = 0)
+        : mData(data)
+        , mSize(size)
+    {}
+
+    // string is always terminated with '\0'
+    const char *data() const
+    {
+        return mData ? mData : "";
+    }
+
+    const char *c_str() const
+    {
+        return data();
+    }
+
+    fdb_string_len_t size() const
+    {
+        return mSize;
+    }
+
+    bool empty() const
+    {
+        return !mSize;
+    }
+
+    bool operator==(const char *str) const
+    {
+        return !strcmp(data(), str);
+    }
+
+    std::string toStdString() const
+    {
+        return std::string(data(), mSize);
+    }
+
+    void serialize(CFdbSimpleSerializer &serializer) const
+    {
+        serializer.addString(data(), mSize);
+    }
+
+    void deserialize(CFdbSimpleDeserializer &deserializer)
+    {
+        mData = 0;
+        mSize = 0;
+        fdb_string_len_t len = 0;
+        deserializer >> len;
+        if (deserializer.error() || !len)
+        {
+            return;
+        }
+        const char *data = (const char *)deserializer.retrieveView(len);
+        if (!data)
+        {
+            return;
+        }
+        if (data[len - 1] != '\0')
+        {
+            deserializer.error(true);
+            return;
+        }
+        mData = data;
+        mSize = (fdb_string_len_t)(len - 1);
+    }
+
+    std::ostringstream &format(std::ostringstream &stream) const
+    {
+        toString(stream);
+        return stream;
+    }
+
+protected:
+    void toString(std::ostringstream &stream) const
+    {
+        stream << data();
+    }
+
+private:
+    const char *mData;
+    fdb_string_len_t mSize;
+};
+
+class CFdbByteArrayView : public IFdbParcelable
+{
+public:
+    CFdbByteArrayView(const uint8_t *buffer = 0, int32_t size = 0)
+        : mBuffer(buffer)
+        , mSize(size)
+    {}
+
+    const uint8_t *buffer() const
+    {
+        return mBuffer;
+    }
+
+    int32_t size() const
+    {
+        return mSize;
+    }
+
+    void serialize(CFdbSimpleSerializer &serializer) const
+    {
+        serializer << (fdb_byte_arr_len_t)mSize;
+        if (mSize)
+        {
+            serializer.addRawData(mBuffer, mSize);
+        }
+    }
+
+    void deserialize(CFdbSimpleDeserializer &deserializer)
+    {
+        mBuffer = 0;
+        mSize = 0;
+        fdb_byte_arr_len_t size = 0;
+        deserializer >> size;
+        if (deserializer.error() || !size)
+        {
+            return;
+        }
+        if (size < 0)
+        {
+            deserializer.error(true);
+            return;
+        }
+        mBuffer = deserializer.retrieveView(size);
+        if (mBuffer)
+        {
+            mSize = size;
+        }
+    }
+
+    std::ostringstream &format(std::ostringstream &stream) const
+    {
+        int32_t psize = mSize;
+        if (psize > FDB_BYTEARRAY_PRINT_SIZE)
+        {
+            stream << mSize << "[";
+            psize = FDB_BYTEARRAY_PRINT_SIZE;
+        }
+        else
+        {
+            stream << "[";
+        }
+        for (int32_t i = 0; i < psize; ++i)
+        {
+            stream << (unsigned)mBuffer[i] << ",";
+        }
+        stream << "]";
+        return stream;
+    }
+
+private:
+    const uint8_t *mBuffer;
+    int32_t mSize;
+};
+
+// span of scalars (int8_t ... uint64_t) as array of CFdbParcelableArray<T>
+template <typename T>
+class CFdbScalarArrayView : public IFdbParcelable
+{
+public:
+    CFdbScalarArrayView()
+        : mData(0)
+        , mSize(0)
+    {}
+
+    uint32_t size() const
+    {
+        return mSize;
+    }
+
+    bool empty() const
+    {
+        return !mSize;
+    }
+
+    // data might be unaligned: always fetch elements with operator[]
+    T operator[](uint32_t index) const
+    {
+        return fdbLoadScalar<T>(mData + index * sizeof(T));
+    }
+
+    // raw wire data of the array, in little endian
+    const uint8_t *data() const
+    {
+        return mData;
+    }
+
+    /*
+     * Return pointer to the array if it can be accessed in place, that is,
+     * the host is little endian and the data is properly aligned. Otherwise
+     * return 0 and elements should be fetched with operator[].
+     */
+    const T *native() const
+    {
+#if FDB_BIG_ENDIAN_HOST
+        return 0;
+#else
+        return ((uintptr_t)mData % sizeof(T)) ? 0 : (const T *)mData;
 #endif
+    }
 
+    void serialize(CFdbSimpleSerializer &serializer) const
+    {
+        serializer << (fdb_struct_arr_len_t)mSize;
+        for (uint32_t i = 0; i < mSize; ++i)
+        {
+            serializer << (*this)[i];
+        }
+    }
+
+    void deserialize(CFdbSimpleDeserializer &deserializer)
+    {
+        mData = 0;
+        mSize = 0;
+        fdb_struct_arr_len_t size = 0;
+        deserializer >> size;
+        if (deserializer.error() || !size)
+        {
+            return;
+        }
+        mData = deserializer.retrieveView((int32_t)(size * sizeof(T)));
+        if (mData)
+        {
+            mSize = size;
+        }
+    }
+
+    std::ostringstream &format(std::ostringstream &stream) const
+    {
+        stream << "[";
+        toString(stream);
+        stream << "]";
+        return stream;
+    }
+
+protected:
+    void toString(std::ostringstream &stream) const
+    {
+        for (uint32_t i = 0; i < mSize; ++i)
+        {
+            stream << +(*this)[i] << ",";
+        }
+    }
+
+private:
+    const uint8_t *mData;
+    uint32_t mSize;
+};
+
+/*
+ * Lazy view of array of parcelables. Elements are variable in size so
+ * they are decoded one by one when iterating:
+ *     CFdbParcelableArrayView<CItemView>::CIterator it(array_view);
+ *     CItemView item;
+ *     while (it.next(item)) { ... }
+ * T should consist of view types as well so that iteration doesn't
+ * allocate memory.
+ */
+template <typename T>
+class CFdbParcelableArrayView : public IFdbParcelable
+{
+public:
+    class CIterator
+    {
+    public:
+        CIterator(const CFdbParcelableArrayView<T> &view)
+            : mDeserializer(view.mData, view.mDataSize)
+            , mLeft(view.mData ? view.mSize : 0)
+        {}
+        bool next(T &element)
+        {
+            if (!mLeft || mDeserializer.error())
+            {
+                return false;
+            }
+            --mLeft;
+            mDeserializer >> element;
+            return !mDeserializer.error();
+        }
+    private:
+        CFdbSimpleDeserializer mDeserializer;
+        uint32_t mLeft;
+    };
+
+    CFdbParcelableArrayView()
+        : mData(0)
+        , mDataSize(0)
+        , mSize(0)
+    {}
+
+    uint32_t size() const
+    {
+        return mSize;
+    }
+
+    bool empty() const
+    {
+        return !mSize;
+    }
+
+    void serialize(CFdbSimpleSerializer &serializer) const
+    {
+        serializer << (fdb_struct_arr_len_t)mSize;
+        if (mDataSize)
+        {
+            serializer.addRawData(mData, mDataSize);
+        }
+    }
+
+    void deserialize(CFdbSimpleDeserializer &deserializer)
+    {
+        mData = 0;
+        mDataSize = 0;
+        mSize = 0;
+        fdb_struct_arr_len_t size = 0;
+        deserializer >> size;
+        if (deserializer.error() || !size)
+        {
+            return;
+        }
+        // walk through elements to find the end of the array
+        const uint8_t *data = deserializer.pos();
+        int32_t start = deserializer.index();
+        T element;
+        for (fdb_struct_arr_len_t i = 0; i < size; ++i)
+        {
+            deserializer >> element;
+            if (deserializer.error())
+            {
+                return;
+            }
+        }
+        mData = data;
+        mDataSize = deserializer.index() - start;
+        mSize = size;
+    }
+
+    std::ostringstream &format(std::ostringstream &stream) const
+    {
+        stream << "[";
+        toString(stream);
+        stream << "]";
+        return stream;
+    }
+
+protected:
+    void toString(std::ostringstream &stream) const
+    {
+        CIterator it(*this);
+        T element;
+        while (it.next(element))
+        {
+            element.format(stream) << ",";
+        }
+    }
+
+private:
+    const uint8_t *mData;
+    int32_t mDataSize;
+    uint32_t mSize;
+};
+
+#endif
@@ -0,0 +1,533 @@
+/*
+ * Copyright (C) 2015   Jeremy Chen jeremy_cz@yahoo.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CFDBSUBSCRIBEINDEX_H__
+#define __CFDBSUBSCRIBEINDEX_H__
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <string.h>
+#include "common_defs.h"
+#include "CFdbMessage.h"
+#include "CFdbContentFilter.h"
+
+class CFdbSession;
+
+/*
+ * Subscription table of an object. Each subscription of (code, session,
+ * object, topic) is a target; targets are indexed by (code, topic) in
+ * contiguous lists so that broadcasting only walks the subscribers that
+ * match, and the index is updated incrementally upon subscribe and
+ * unsubscribe:
+ *
+ *  code -+- topic "a" -> [target, target, ...]
+ *        +- topic "b" -> [target, ...]
+ *        +- pattern tree -> [target, ...]
+ *        +- wildcard "" -> [target, ...]
+ *
+ * A target can also subscribe a topic pattern, where topic is split into
+ * segments by '/': a segment "*" matches any single segment, and "#" as
+ * the last segment matches any number (including zero) of remaining
+ * segments. For example "sensor/#" matches "sensor" and
+ * "sensor/temp/cabin", and "*" following "vehicle/door/" matches
+ * "vehicle/door/left". Patterns are kept in a tree with one level per
+ * segment, so matching a topic costs in proportion to its depth rather
+ * than the number of patterns.
+ *
+ * A subscriber (code, session, object) matching more than one of exact
+ * topic, pattern and wildcard gets a message only once, with exact topic
+ * taking precedence over pattern, and pattern over wildcard.
+ *
+ * A target might carry a content filter over payload. Targets having
+ * equal content filters share one evaluation per broadcast.
+ *
+ * A target might have a delivery policy other than FDB_DELIVER_FULL,
+ * which needs per event/topic state (CDelivery). Targets holding
+ * conflated broadcasts not yet sent are tracked for flush().
+ *
+ * Subscribers are also indexed by session and by object so that
+ * disconnecting a session or removing an object only touches the
+ * subscriptions it owns instead of scanning every code.
+ *
+ * Targets removed during broadcasting (e.g. a session is lost when
+ * sending) are only marked dead and purged when broadcasting completes
+ * so that the lists being walked remain valid.
+ */
+class CFdbSubscribeIndex
+{
+public:
+    struct CSubscriber;
+    struct CTarget;
+    struct CTopicNode;
+    struct CFilter;
+    struct CDelivery;
+    typedef std::vector<CTarget *> TargetList_t;
+
+    // a subscription of (code, session, object, topic)
+    struct CTarget
+    {
+        CSubscriber *mSubscriber;
+        const std::string *mTopic;
+        CFdbSubscribeType mType;
+        bool mDead;
+        bool mPendingPurge;
+        bool mPattern;
+        // the list holding the target and position in it
+        TargetList_t *mList;
+        uint32_t mPos;
+        // the node of pattern tree holding the list if mPattern is true
+        CTopicNode *mNode;
+        // content filter shared with other targets; 0 if not filtered
+        CFilter *mFilter;
+        // 0 if the policy is FDB_DELIVER_FULL and delta is not requested
+        CDelivery *mDelivery;
+
+        CFdbSession *session() const
+        {
+            return mSubscriber->mSession;
+        }
+        FdbObjectId_t objectId() const
+        {
+            return mSubscriber->mObjId;
+        }
+        const std::string &topic() const
+        {
+            return *mTopic;
+        }
+    };
+
+    // delivery state of an event/topic for a target
+    struct CDeliveryState
+    {
+        // time (ms) when the last broadcast is sent
+        uint64_t mLastSent;
+        // hash of payload of the last broadcast
+        uint64_t mHash;
+        bool mSent;
+        // mPayload is conflated and waiting for sending
+        bool mPending;
+        FdbMsgCode_t mCode;
+        // interned by CFdbSubscribeIndex; shared by all states of the topic
+        const std::string *mTopic;
+        std::vector<uint8_t> mPayload;
+        // version of cached event last sent, base of delta; 0 if unknown
+        uint64_t mVersion;
+        // version of mPayload
+        uint64_t mPendingVersion;
+
+        CDeliveryState()
+            : mLastSent(0)
+            , mHash(0)
+            , mSent(false)
+            , mPending(false)
+            , mCode(FDB_INVALID_ID)
+            , mTopic(0)
+            , mVersion(0)
+            , mPendingVersion(0)
+        {}
+    };
+
+    // code and interned topic of event: compared without touching the string
+    struct CStateKey
+    {
+        FdbMsgCode_t mCode;
+        const std::string *mTopic;
+
+        CStateKey(FdbMsgCode_t code, const std::string *topic)
+            : mCode(code)
+            , mTopic(topic)
+        {}
+        bool operator==(const CStateKey &other) const
+        {
+            return (mCode == other.mCode) && (mTopic == other.mTopic);
+        }
+    };
+    struct CStateKeyHash
+    {
+        size_t operator()(const CStateKey &key) const
+        {
+            return std::hash<const void *>()(key.mTopic) ^ ((size_t)key.mCode * 0x9e3779b9);
+        }
+    };
+    typedef std::unordered_map<CStateKey, CDeliveryState, CStateKeyHash> DeliveryStateTable_t;
+
+    struct CDelivery
+    {
+        CFdbDeliveryPolicy mPolicy;
+        uint32_t mInterval;
+        // cached event is sent as delta against the last one sent
+        bool mDelta;
+        // created by deliveryState(); dropped with the target
+        DeliveryStateTable_t mStates;
+    };
+
+    // all subscriptions of (code, session, object)
+    struct CSubscriber
+    {
+        FdbMsgCode_t mCode;
+        CFdbSession *mSession;
+        FdbObjectId_t mObjId;
+        uint32_t mStamp;
+        std::unordered_map<std::string, CTarget> mTargets;
+        std::unordered_map<std::string, CTarget> mPatterns;
+    };
+
+    CFdbSubscribeIndex();
+    ~CFdbSubscribeIndex();
+
+    /*
+     * if pattern is true, topic is a pattern with "*" and "#" segments;
+     * if content is not 0, only payload matching it is sent;
+     * if delta is true, cached event can be sent as delta.
+     */
+    void subscribe(FdbMsgCode_t code, CFdbSession *session, FdbObjectId_t obj_id,
+                   const char *topic, CFdbSubscribeType type, bool pattern = false,
+                   const CFdbContentFilter *content = 0,
+                   CFdbDeliveryPolicy policy = FDB_DELIVER_FULL, uint32_t interval = 0,
+                   bool delta = false);
+    // unsubscribe all topics and patterns of the object if topic is 0
+    void unsubscribe(FdbMsgCode_t code, CFdbSession *session, FdbObjectId_t obj_id,
+                     const char *topic, bool pattern = false);
+    void unsubscribe(CFdbSession *session);
+    void unsubscribe(FdbObjectId_t obj_id);
+
+    /*
+     * Call fn(CTarget &) for each target matching (code, topic) and
+     * accepting the payload; each subscriber is visited at most once.
+     * Content filters are not checked if payload is 0.
+     */
+    template <typename F>
+    void forEachMatch(FdbMsgCode_t code, const char *topic, const uint8_t *payload,
+                      int32_t size, F fn)
+    {
+        auto it_entry = mCodeTable.find(code);
+        if (it_entry == mCodeTable.end())
+        {
+            return;
+        }
+        auto &entry = it_entry->second;
+        CMatch match(newStamp(), payload, size);
+        mBusy++;
+        if (topic && (topic[0] != '\0'))
+        {
+            auto it_targets = entry.mTopicTable.find(topic);
+            if (it_targets != entry.mTopicTable.end())
+            {
+                visit(it_targets->second, match, fn);
+            }
+        }
+        if (!entry.mPatternTree.empty())
+        {
+            matchPattern(&entry.mPatternTree, topic ? topic : "", match, fn);
+        }
+        visit(entry.mWildcardList, match, fn);
+        mBusy--;
+        purge();
+    }
+
+    template <typename F>
+    void forEachMatch(FdbMsgCode_t code, const char *topic, F fn)
+    {
+        forEachMatch(code, topic, 0, 0, fn);
+    }
+
+    // call fn(code, CTarget &) for each target in the index
+    template <typename F>
+    void forEachTarget(F fn)
+    {
+        mBusy++;
+        for (auto it_entry = mCodeTable.begin(); it_entry != mCodeTable.end(); ++it_entry)
+        {
+            forEachTarget(it_entry->second, 0, it_entry->first, fn);
+        }
+        mBusy--;
+        purge();
+    }
+
+    // call fn(code, CTarget &) for each target of code (and session if not 0)
+    template <typename F>
+    void forEachTarget(FdbMsgCode_t code, CFdbSession *session, F fn)
+    {
+        auto it_entry = mCodeTable.find(code);
+        if (it_entry == mCodeTable.end())
+        {
+            return;
+        }
+        mBusy++;
+        forEachTarget(it_entry->second, session, code, fn);
+        mBusy--;
+        purge();
+    }
+
+    /*
+     * Find the target of (code, session, object) to which forEachMatch()
+     * would deliver the payload: the target subscribing the topic, or if
+     * none, the target subscribing a pattern matching the topic, and then
+     * the one subscribing wildcard. Targets whose content filter rejects
+     * the payload are passed over. Content filters are not checked if
+     * payload is 0.
+     */
+    CTarget *findTarget(FdbMsgCode_t code, CFdbSession *session, FdbObjectId_t obj_id,
+                        const char *topic, const uint8_t *payload = 0, int32_t size = 0);
+
+    /*
+     * Delivery state of event (code, topic) for the target, created if
+     * not yet. The target must have mDelivery. Topic is looked up in the
+     * pool of interned topics, so no string is built per broadcast; the
+     * state lives until the target is unsubscribed or its policy changes.
+     */
+    CDeliveryState &deliveryState(CTarget &target, FdbMsgCode_t code, const std::string &topic);
+
+    // the target has conflated broadcast to be sent by flush()
+    void schedule(CTarget &target)
+    {
+        mPendingTargets.insert(&target);
+    }
+
+    /*
+     * Call fn(CTarget &) for each target having conflated broadcast; fn
+     * returns true if something is still pending after that.
+     */
+    template <typename F>
+    void flush(F fn)
+    {
+        if (mPendingTargets.empty())
+        {
+            return;
+        }
+        std::vector<CTarget *> targets(mPendingTargets.begin(), mPendingTargets.end());
+        mBusy++;
+        for (auto it = targets.begin(); it != targets.end(); ++it)
+        {
+            auto target = *it;
+            if (target->mDead || !fn(*target))
+            {
+                mPendingTargets.erase(target);
+            }
+        }
+        mBusy--;
+        purge();
+    }
+
+    // check if topic matches pattern with "*" and "#" segments
+    static bool matchTopic(const char *pattern, const char *topic);
+
+    // content filter shared by targets
+    struct CFilter
+    {
+        CFdbContentFilter mContent;
+        const std::string *mKey;
+        uint32_t mRef;
+        // result for the payload being broadcasted at mStamp
+        uint32_t mStamp;
+        bool mMatched;
+    };
+
+    // node of pattern tree; one level per segment of pattern
+    struct CTopicNode
+    {
+        CTopicNode *mParent;
+        std::string mSegment;
+        std::unordered_map<std::string, CTopicNode *> mChildren;
+        // child of segment "*"
+        CTopicNode *mAnyChild;
+        // patterns ending at the node
+        TargetList_t mTargets;
+        // patterns ending with "#" at the node
+        TargetList_t mTailTargets;
+
+        CTopicNode(CTopicNode *parent = 0, const char *segment = "", uint32_t len = 0)
+            : mParent(parent)
+            , mSegment(segment, len)
+            , mAnyChild(0)
+        {}
+        ~CTopicNode();
+        bool empty() const
+        {
+            return mTargets.empty() && mTailTargets.empty() && mChildren.empty() && !mAnyChild;
+        }
+    private:
+        CTopicNode(const CTopicNode &);
+        CTopicNode &operator=(const CTopicNode &);
+    };
+
+private:
+    typedef std::unordered_map<FdbObjectId_t, CSubscriber> ObjectTable_t;
+    typedef std::unordered_map<CFdbSession *, ObjectTable_t> SessionTable_t;
+    struct CCodeEntry
+    {
+        std::unordered_map<std::string, TargetList_t> mTopicTable;
+        TargetList_t mWildcardList;
+        CTopicNode mPatternTree;
+        SessionTable_t mSessionTable;
+    };
+    typedef std::unordered_map<FdbMsgCode_t, CCodeEntry> CodeTable_t;
+    typedef std::unordered_set<CSubscriber *> SubscriberSet_t;
+
+    CodeTable_t mCodeTable;
+    // content filters keyed by CFdbContentFilter::toKey()
+    std::unordered_map<std::string, CFilter> mFilterTable;
+    std::unordered_set<CTarget *> mPendingTargets;
+    // topics of delivery states, with number of states referring to each
+    std::unordered_map<std::string, uint32_t> mTopicPool;
+    // reverse index: subscribers owned by a session/object across all codes
+    std::unordered_map<CFdbSession *, SubscriberSet_t> mSessionIndex;
+    std::unordered_map<FdbObjectId_t, SubscriberSet_t> mObjectIndex;
+    uint32_t mStamp;
+    int32_t mBusy;
+    std::vector<CTarget *> mGarbage;
+
+    uint32_t newStamp()
+    {
+        if (++mStamp == 0)
+        {
+            ++mStamp;
+        }
+        return mStamp;
+    }
+
+    struct CMatch
+    {
+        uint32_t mStamp;
+        const uint8_t *mPayload;
+        int32_t mSize;
+
+        CMatch(uint32_t stamp, const uint8_t *payload, int32_t size)
+            : mStamp(stamp)
+            , mPayload(payload)
+            , mSize(size)
+        {}
+    };
+
+    // evaluate the filter only once per broadcast
+    bool accept(CFilter *filter, const CMatch &match)
+    {
+        if (!filter || !match.mPayload)
+        {
+            return true;
+        }
+        if (filter->mStamp != match.mStamp)
+        {
+            filter->mStamp = match.mStamp;
+            filter->mMatched = filter->mContent.match(match.mPayload, match.mSize);
+        }
+        return filter->mMatched;
+    }
+
+    /*
+     * Whether the payload can be delivered to the target. Both
+     * forEachMatch() and findTarget() go through here, trying exact
+     * topic, then pattern and then wildcard, and take the first target
+     * of a subscriber accepting the payload.
+     */
+    bool deliverable(CTarget *target, const CMatch &match)
+    {
+        return !target->mDead && accept(target->mFilter, match);
+    }
+
+    template <typename F>
+    void visit(TargetList_t &targets, const CMatch &match, F &fn)
+    {
+        // list might grow during sending: always check size
+        for (uint32_t i = 0; i < targets.size(); ++i)
+        {
+            auto target = targets[i];
+            if ((target->mSubscriber->mStamp == match.mStamp) || !deliverable(target, match))
+            {
+                continue;
+            }
+            target->mSubscriber->mStamp = match.mStamp;
+            fn(*target);
+        }
+    }
+
+    // topic: the remaining segments to match
+    template <typename F>
+    void matchPattern(CTopicNode *node, const char *topic, const CMatch &match, F &fn)
+    {
+        visit(node->mTailTargets, match, fn);
+        if (!topic)
+        {
+            visit(node->mTargets, match, fn);
+            return;
+        }
+        auto end = strchr(topic, '/');
+        auto next = end ? end + 1 : 0;
+        if (!node->mChildren.empty())
+        {
+            auto it_child = node->mChildren.find(end ? std::string(topic, end - topic) : std::string(topic));
+            if (it_child != node->mChildren.end())
+            {
+                matchPattern(it_child->second, next, match, fn);
+            }
+        }
+        if (node->mAnyChild)
+        {
+            matchPattern(node->mAnyChild, next, match, fn);
+        }
+    }
+
+    template <typename F>
+    void forEachTarget(std::unordered_map<std::string, CTarget> &targets, FdbMsgCode_t code, F &fn)
+    {
+        for (auto it_target = targets.begin(); it_target != targets.end(); ++it_target)
+        {
+            if (!it_target->second.mDead)
+            {
+                fn(code, it_target->second);
+            }
+        }
+    }
+
+    template <typename F>
+    void forEachTarget(CCodeEntry &entry, CFdbSession *session, FdbMsgCode_t code, F &fn)
+    {
+        for (auto it_objects = entry.mSessionTable.begin();
+                it_objects != entry.mSessionTable.end(); ++it_objects)
+        {
+            if (session && (it_objects->first != session))
+            {
+                continue;
+            }
+            auto &objects = it_objects->second;
+            for (auto it_subscriber = objects.begin(); it_subscriber != objects.end(); ++it_subscriber)
+            {
+                forEachTarget(it_subscriber->second.mTargets, code, fn);
+                forEachTarget(it_subscriber->second.mPatterns, code, fn);
+            }
+        }
+    }
+
+    void removeTarget(CTarget *target);
+    void removeSubscriber(CSubscriber &subscriber);
+    void removeSubscribers(SubscriberSet_t &subscribers);
+    void indexSubscriber(CSubscriber *subscriber);
+    void unindexSubscriber(CSubscriber *subscriber);
+    void deleteTarget(CTarget *target);
+    TargetList_t &addPattern(CTopicNode *root, const char *pattern, CTopicNode *&node);
+    void prunePattern(CTopicNode *node);
+    void setFilter(CTarget &target, const CFdbContentFilter *content);
+    void setDelivery(CTarget &target, CFdbDeliveryPolicy policy, uint32_t interval, bool delta = false);
+    void clearStates(CDelivery &delivery);
+    void purge();
+
+    CFdbSubscribeIndex(const CFdbSubscribeIndex &);
+    CFdbSubscribeIndex &operator=(const CFdbSubscribeIndex &);
+};
+
+#endif
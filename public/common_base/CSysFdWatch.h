@@ -65,10 +65,7 @@ public:
     /*
      * query flag.
      */
-    void flags(int32_t flgs)
-    {
-        mFlags = flgs;
-    }
+    void flags(int32_t flgs);
 
     /*
      * Get file descriptor of the watch.
@@ -155,6 +152,7 @@ private:
     
     friend class CFdEventLoop;
     friend class CNotifyFdWatch;
+    friend class CTimerFdWatch;
 };
 
 #endif
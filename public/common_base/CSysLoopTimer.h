@@ -104,6 +104,10 @@ private:
     bool mRepeat;
     bool mEnable;
     uint64_t mExpiration;
+    // order of timers expiring at the same time
+    uint64_t mSequence;
+    // position in timer heap of event loop when enabled
+    uint32_t mHeapIndex;
     CBaseEventLoop *mEventLoop;
     friend class CBaseEventLoop;
     friend class CFdEventLoop;
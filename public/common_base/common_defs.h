@@ -98,6 +98,20 @@ inline To fdb_dynamic_cast_if_available(From from) {
 
 #define FDB_CFG_CONFIG_FILE_SUFFIX ".fdb"
 
+/*
+ * where shared memory of CFdbPropertyStore is created. If the path is
+ * not on tmpfs (e.g. Android), define FDB_CFG_PROPERTY_STORE_MEMFD: the
+ * memory is then a memfd and the path only holds its location.
+ */
+#if !defined(FDB_CFG_PROPERTY_STORE_PATH)
+#define FDB_CFG_PROPERTY_STORE_PATH "/dev/shm"
+#endif
+
+// who can read CFdbPropertyStore: owner only unless relaxed, e.g. to 0640
+#if !defined(FDB_CFG_PROPERTY_STORE_MODE)
+#define FDB_CFG_PROPERTY_STORE_MODE 0600
+#endif
+
 #if !defined(FDB_CFG_NR_SECURE_LEVEL)
 #define FDB_CFG_NR_SECURE_LEVEL 4
 #endif
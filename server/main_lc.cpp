@@ -114,8 +114,17 @@ private:
             }
             std::cout << "    " <<  client_info.peer_name() << "@"
                                 << client_info.peer_address()
-                                << ", security: " << client_info.security_level()
-                                << std::endl;
+                                << ", security: " << client_info.security_level();
+            if (client_info.slow_count())
+            {
+                std::cout << (client_info.slow() ? ", SLOW" : ", slow")
+                          << " x" << client_info.slow_count()
+                          << ", queued: " << client_info.queued_bytes()
+                          << " bytes/" << client_info.oldest_age() << " ms"
+                          << ", dropped: " << client_info.dropped()
+                          << ", conflated: " << client_info.conflated();
+            }
+            std::cout << std::endl;
         }
     }
 
@@ -107,12 +107,29 @@ private:
     void printEvents(NFdbBase::FdbMsgEventCache &event_tbl)
     {
         auto &event_list = event_tbl.cache();
-        printf("| %-10s | %-32s | %-10s |\n", "**EVENT**", "**TOPIC**", "**SIZE**");
+        printf("| %-10s | %-32s | %-10s | %-10s |\n", "**EVENT**", "**TOPIC**", "**SIZE**", "**AGE(ms)**");
         for (auto it = event_list.vpool().begin(); it != event_list.vpool().end(); ++it)
         {
             auto &event_info = *it;
-            printf("| %-10d | %-32s | %-10d |\n", event_info.event(), event_info.topic().c_str(), event_info.size());
+            printf("| %-10d | %-32s | %-10d | %-10u |\n", event_info.event(), event_info.topic().c_str(),
+                   event_info.size(), event_info.age());
         }
+        printf("\ncache: %u bytes", event_tbl.bytes());
+        if (event_tbl.max_bytes())
+        {
+            printf(" (max %u)", event_tbl.max_bytes());
+        }
+        if (event_tbl.ttl())
+        {
+            printf(", ttl %u ms", event_tbl.ttl());
+        }
+        printf(", evicted %u, expired %u\n", event_tbl.evicted(), event_tbl.expired());
+        printf("process: %llu bytes", (unsigned long long)event_tbl.process_bytes());
+        if (event_tbl.process_max_bytes())
+        {
+            printf(" (max %llu)", (unsigned long long)event_tbl.process_max_bytes());
+        }
+        printf("\n");
     }
 };
 
@@ -31,6 +31,8 @@ CSysLoopTimer::CSysLoopTimer(int32_t interval, bool rpt)
     , mRepeat(rpt)
     , mEnable(false)
     , mExpiration(0)
+    , mSequence(0)
+    , mHeapIndex(0)
     , mEventLoop(0)
 {
 }
@@ -43,7 +45,7 @@ void CSysLoopTimer::enable(bool enb, uint64_t time_start, int32_t init_value)
 {
     if (mEnable)
     {
-        fdb_remove_value_from_container(mEventLoop->mTimerWorkingList, this);
+        mEventLoop->eraseTimer(this);
         mEnable = false;
     }
 
@@ -66,15 +68,7 @@ void CSysLoopTimer::enable(bool enb, uint64_t time_start, int32_t init_value)
             LOG_E("CBaseEventLoop: Unable to enable timer since interval is invalid!\n");
             return;
         }
-        auto ti = mEventLoop->mTimerWorkingList.begin();
-        for (; ti != mEventLoop->mTimerWorkingList.end(); ++ti)
-        {
-            if ((*ti)->expiration() > mExpiration)
-            {
-                break;
-            }
-        }
-        mEventLoop->mTimerWorkingList.insert(ti, this);
+        mEventLoop->pushTimer(this);
         mEnable = true;
     }
 }
@@ -106,7 +100,8 @@ void CSysLoopTimer::config(EEnable enb, EEnable rpt, int32_t interval, int32_t i
 }
 
 CBaseEventLoop::CBaseEventLoop()
-    : mTimerRecursiveCnt(0)
+    : mTimerSequence(0)
+    , mTimerRecursiveCnt(0)
 {
 }
 
@@ -127,16 +122,12 @@ bool CBaseEventLoop::timerDestroyed(CSysLoopTimer *timer)
 
 void CBaseEventLoop::addTimer(CSysLoopTimer *timer, bool enb)
 {
-    for (auto ti = mTimerList.begin(); ti != mTimerList.end(); ++ti)
+    if (!mTimerList.insert(timer).second)
     {
-        if ((*ti) == timer)
-        {
-            return; // alredy added
-        }
+        return; // alredy added
     }
 
     timer->eventloop(this);
-    mTimerList.push_back(timer);
     timer->enable(enb);
 }
 
@@ -144,7 +135,7 @@ void CBaseEventLoop::removeTimer(CSysLoopTimer *timer)
 {
     addTimerToBlacklist(timer);
     timer->enable(false);
-    fdb_remove_value_from_container(mTimerList, timer);
+    mTimerList.erase(timer);
     timer->eventloop(0);
 }
 
@@ -163,14 +154,113 @@ void CBaseEventLoop::uninstallTimers()
     }
 }
 
+bool CBaseEventLoop::timerBefore(CSysLoopTimer *timer1, CSysLoopTimer *timer2)
+{
+    if (timer1->mExpiration != timer2->mExpiration)
+    {
+        return timer1->mExpiration < timer2->mExpiration;
+    }
+    // timers expiring at the same time fire in the order they are enabled
+    return timer1->mSequence < timer2->mSequence;
+}
+
+void CBaseEventLoop::placeTimer(uint32_t index, CSysLoopTimer *timer)
+{
+    mTimerHeap[index] = timer;
+    timer->mHeapIndex = index;
+}
+
+void CBaseEventLoop::siftUp(uint32_t index)
+{
+    auto timer = mTimerHeap[index];
+    while (index)
+    {
+        auto parent = (index - 1) / LOOP_TIMER_HEAP_ARITY;
+        if (!timerBefore(timer, mTimerHeap[parent]))
+        {
+            break;
+        }
+        placeTimer(index, mTimerHeap[parent]);
+        index = parent;
+    }
+    placeTimer(index, timer);
+}
+
+void CBaseEventLoop::siftDown(uint32_t index)
+{
+    auto timer = mTimerHeap[index];
+    auto size = (uint32_t)mTimerHeap.size();
+    while (true)
+    {
+        auto first = index * LOOP_TIMER_HEAP_ARITY + 1;
+        if (first >= size)
+        {
+            break;
+        }
+        auto last = std::min(first + LOOP_TIMER_HEAP_ARITY, size);
+        auto child = first;
+        for (auto i = first + 1; i < last; ++i)
+        {
+            if (timerBefore(mTimerHeap[i], mTimerHeap[child]))
+            {
+                child = i;
+            }
+        }
+        if (!timerBefore(mTimerHeap[child], timer))
+        {
+            break;
+        }
+        placeTimer(index, mTimerHeap[child]);
+        index = child;
+    }
+    placeTimer(index, timer);
+}
+
+void CBaseEventLoop::pushTimer(CSysLoopTimer *timer)
+{
+    timer->mSequence = mTimerSequence++;
+    mTimerHeap.push_back(timer);
+    siftUp((uint32_t)mTimerHeap.size() - 1);
+}
+
+void CBaseEventLoop::eraseTimer(CSysLoopTimer *timer)
+{
+    auto index = timer->mHeapIndex;
+    auto last = mTimerHeap.back();
+    mTimerHeap.pop_back();
+    if (last == timer)
+    {
+        return;
+    }
+    // move the last timer to the hole and restore heap order
+    placeTimer(index, last);
+    if (index && timerBefore(last, mTimerHeap[(index - 1) / LOOP_TIMER_HEAP_ARITY]))
+    {
+        siftUp(index);
+    }
+    else
+    {
+        siftDown(index);
+    }
+}
+
+bool CBaseEventLoop::getMostRecentExpiration(uint64_t &expiration)
+{
+    if (mTimerHeap.empty())
+    {
+        return false;
+    }
+    expiration = mTimerHeap.front()->expiration();
+    return true;
+}
+
 int32_t CBaseEventLoop::getMostRecentTime()
 {
     int32_t wait_time = -1; // wait forever
-    auto ti = mTimerWorkingList.begin();
-    if (ti != mTimerWorkingList.end())
+    uint64_t min_expire;
+    if (getMostRecentExpiration(min_expire))
     {
         uint64_t now_millis = sysdep_getsystemtime_milli();
-        uint64_t min_expire = (*ti)->expiration();
         if (min_expire > now_millis)
         {
             wait_time = (int)(min_expire - now_millis); // wait until timeout
@@ -206,47 +296,44 @@ void CBaseEventLoop::endTimerBlackList()
 void CBaseEventLoop::processTimers()
 {
     uint64_t now_millis = sysdep_getsystemtime_milli();
-    std::vector<CSysLoopTimer *> tos;
-    for (auto ti = mTimerWorkingList.begin(); ti != mTimerWorkingList.end(); ++ti)
+    if (mTimerHeap.empty() || (mTimerHeap.front()->expiration() > now_millis))
     {
-        if (now_millis >= (*ti)->expiration())
-        {
-            tos.push_back(*ti);
-        }
-        else
-        {
-            break;
-        }
+        return;
     }
-    if (!tos.empty())
+    // take the storage so that nested call from timer callback has its own
+    tLoopTimerList tos;
+    tos.swap(mExpiredTimers);
+    while (!mTimerHeap.empty() && (mTimerHeap.front()->expiration() <= now_millis))
     {
-        beginTimerBlackList();
-        for (auto ti = tos.begin(); ti != tos.end(); ++ti)
+        // re-enabled repeating timer expires after now
+        auto timer = mTimerHeap.front();
+        tos.push_back(timer);
+        timer->enable(timer->repeat(), now_millis);
+    }
+
+    beginTimerBlackList();
+    for (auto ti = tos.begin(); ti != tos.end(); ++ti)
+    {
+        if (timerDestroyed((*ti)))
         {
-            (*ti)->enable((*ti)->repeat(), now_millis);
+            continue;
         }
-
-        for (auto ti = tos.begin(); ti != tos.end(); ++ti)
+        try
         {
-            if (timerDestroyed((*ti)))
-            {
-                continue;
-            }
-            try
-            {
-                (*ti)->run();
-            }
-            catch (...)
+            (*ti)->run();
+        }
+        catch (...)
+        {
+            LOG_E("CFdEventLoop: Exception received at line %d of file %s!\n", __LINE__, __FILE__);
+            if (!timerDestroyed(*ti))
             {
-                LOG_E("CFdEventLoop: Exception received at line %d of file %s!\n", __LINE__, __FILE__);
-                if (!timerDestroyed(*ti))
-                {
-                    removeTimer(*ti);
-                }
+                removeTimer(*ti);
             }
         }
-        endTimerBlackList();
     }
+    endTimerBlackList();
+    tos.clear();
+    mExpiredTimers.swap(tos);
 }
 
 void CBaseEventLoop::lock()
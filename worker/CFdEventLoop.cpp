@@ -16,11 +16,18 @@
 
 #include <algorithm>
 #include <stdlib.h>
+#include <string.h>
 #include <utils/Log.h>
 #include <common_base/CFdEventLoop.h>
 #include <common_base/CSysFdWatch.h>
 #include <common_base/CBaseWorker.h>
 
+#if defined(__LINUX__) && !defined(CFG_NO_TIMERFD)
+#define FDB_LOOP_USE_TIMERFD
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
 CSysFdWatch::CSysFdWatch(int fd, int32_t flags)
     : mFd(fd)
     , mFlags(flags)
@@ -56,6 +63,15 @@ void CSysFdWatch::fatalError(bool enb)
     mFatalError = enb;
 }
 
+void CSysFdWatch::flags(int32_t flgs)
+{
+    if ((mFlags != flgs) && mEventLoop)
+    {
+        mEventLoop->rebuildPollFd();
+    }
+    mFlags = flgs;
+}
+
 class CNotifyFdWatch : public CSysFdWatch
 {
 public:
@@ -90,10 +106,43 @@ private:
     CBaseWorker *mWorker;
 };
 
+class CTimerFdWatch : public CSysFdWatch
+{
+public:
+    CTimerFdWatch(int fd)
+        : CSysFdWatch(fd, POLLIN | POLLERR | POLLHUP)
+    {}
+protected:
+    void onInput(bool &io_error)
+    {
+#ifdef FDB_LOOP_USE_TIMERFD
+        uint64_t expirations;
+        if (read(descriptor(), &expirations, sizeof(expirations)) < 0)
+        {
+            // EAGAIN: the timer was re-armed after it fired
+        }
+#endif
+        mEventLoop->mTimerArmed = false;
+        mEventLoop->processTimers();
+    }
+    void onError()
+    {
+        // the watch is disabled: timeout of poll() is used from now on
+        LOG_E("CFdEventLoop: timerfd error; use timeout of poll instead!\n");
+    }
+    void onHup()
+    {
+        onError();
+    }
+};
+
 CFdEventLoop::CFdEventLoop()
     : mWatchRecursiveCnt(0)
     , mNotifyWatch(0)
     , mRebuildPollFd(false)
+    , mTimerWatch(0)
+    , mArmedExpiration(0)
+    , mTimerArmed(false)
 {
 }
 
@@ -104,6 +153,10 @@ CFdEventLoop::~CFdEventLoop()
     {
         delete mNotifyWatch;
     }
+    if (mTimerWatch)
+    {
+        delete mTimerWatch;
+    }
 }
 
 bool CFdEventLoop::watchDestroyed(CSysFdWatch *watch)
@@ -187,6 +240,11 @@ void CFdEventLoop::buildInputFdArray(tWatchPollTbl &watches, tFdPollTbl &fds)
     }
     for (; wi != mWatchWorkingList.end(); ++wi)
     {
+        if (*wi == mTimerWatch)
+        {
+            // timers are not processed when dispatching input only
+            continue;
+        }
         int fd = (*wi)->descriptor();
         if (fd < 0)
         {
@@ -388,7 +446,8 @@ void CFdEventLoop::dispatch()
         return;
     }
 
-    int32_t wait_time = getMostRecentTime();
+    // timerfd wakes up poll() when a timer expires
+    int32_t wait_time = armTimerFd() ? -1 : getMostRecentTime();
     int ret = poll(mPollFds.data(), (int32_t)mPollFds.size(), wait_time);
     if (ret == 0) // timeout
     {
@@ -406,6 +465,47 @@ void CFdEventLoop::dispatch()
     }
 }
 
+bool CFdEventLoop::armTimerFd()
+{
+#ifdef FDB_LOOP_USE_TIMERFD
+    if (!mTimerWatch || !mTimerWatch->enable())
+    {
+        return false;
+    }
+    uint64_t expiration;
+    if (!getMostRecentExpiration(expiration))
+    {
+        // no timer: an armed timerfd at most wakes up poll() once for nothing
+        return true;
+    }
+    if (mTimerArmed && (mArmedExpiration == expiration))
+    {
+        return true;
+    }
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    /*
+     * Timers are in ms of CLOCK_MONOTONIC (see sysdep_getsystemtime_milli()):
+     * expire as soon as the ms clock reaches expiration of the timer, which
+     * is exactly what processTimers() checks. Expiration is never 0.
+     */
+    spec.it_value.tv_sec = (time_t)(expiration / 1000);
+    spec.it_value.tv_nsec = (long)(expiration % 1000) * 1000000;
+    if (timerfd_settime(mTimerWatch->descriptor(), TFD_TIMER_ABSTIME, &spec, 0) < 0)
+    {
+        LOG_E("CFdEventLoop: unable to arm timerfd!\n");
+        mTimerArmed = false;
+        return false;
+    }
+    mArmedExpiration = expiration;
+    mTimerArmed = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
 void CFdEventLoop::dispatchInput(int32_t timeout)
 {
     tWatchPollTbl watches;
@@ -527,5 +627,20 @@ bool CFdEventLoop::init(CBaseWorker *worker)
         mNotifyWatch->descriptor(efd);
         addWatch(mNotifyWatch, true);
     }
+#ifdef FDB_LOOP_USE_TIMERFD
+    if (!mTimerWatch)
+    {
+        int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (tfd < 0)
+        {
+            LOG_E("CFdEventLoop: unable to create timerfd; use timeout of poll instead!\n");
+        }
+        else
+        {
+            mTimerWatch = new CTimerFdWatch(tfd);
+            addWatch(mTimerWatch, true);
+        }
+    }
+#endif
     return true;
 }